@@ -0,0 +1,744 @@
+/***********************************************************************
+ * @file      		mqtt_client.c
+ * @version   		0.1
+ * @brief		persistent MQTT 3.1.1 publisher shared by the apps
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * @references
+ *
+ * http://docs.oasis-open.org/mqtt/mqtt/v3.1.1/os/mqtt-v3.1.1-os.html
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mqtt_client.h"
+
+/**************************** Defines  **********************************/
+// control packet types (fixed header byte 1)
+#define MQTT_CONNECT		(0x10)
+#define MQTT_CONNACK		(0x20)
+#define MQTT_PUBLISH		(0x30)
+#define MQTT_PUBACK		(0x40)
+#define MQTT_PINGREQ		(0xC0)
+#define MQTT_PINGRESP		(0xD0)
+#define MQTT_DISCONNECT		(0xE0)
+
+#define MQTT_PUBLISH_DUP	(0x08)
+#define MQTT_PUBLISH_QOS1	(0x02)
+#define MQTT_CLEAN_SESSION	(0x02)
+#define MQTT_PROTOCOL_LEVEL	(4)	// 3.1.1
+
+/**************************** Function Declarations *********************/
+static uint64_t now_ms(void);
+static size_t mqtt_encode_len(uint8_t *p, size_t len);
+static size_t mqtt_encode_publish(uint8_t *p, const char *topic, size_t tlen,
+				  const void *payload, size_t len, int qos,
+				  uint16_t id);
+static int mqtt_wait(int fd, short events, int timeout_ms);
+static int mqtt_write_all(struct mqtt_client *c, const uint8_t *buf,
+			  size_t len);
+static int mqtt_queue(struct mqtt_client *c, const uint8_t *pkt, size_t len);
+static int mqtt_connect(struct mqtt_client *c);
+static void mqtt_disconnect(struct mqtt_client *c);
+static int mqtt_read(struct mqtt_client *c);
+static void mqtt_ack(struct mqtt_client *c, uint16_t id);
+static int mqtt_wait_ack(struct mqtt_client *c, unsigned int max);
+static void mqtt_service(struct mqtt_client *c);
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Fill in the default settings
+ ****************************************/
+void mqtt_config_default(struct mqtt_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->host = MQTT_DEFAULT_HOST;
+	cfg->port = MQTT_DEFAULT_PORT;
+	cfg->client_id = NULL;
+	cfg->keepalive = MQTT_DEFAULT_KEEPALIVE;
+	cfg->inflight = MQTT_DEFAULT_INFLIGHT;
+	cfg->timeout_ms = 2000;
+	cfg->retry_min_ms = 500;
+	cfg->retry_max_ms = 30000;
+}
+
+/*****************************************
+ * @brief	Parse "host[:port]" in place
+ ****************************************/
+int mqtt_parse_broker(struct mqtt_config *cfg, char *arg)
+{
+	char *colon = strrchr(arg, ':');
+
+	if (colon)
+	{
+		char *end;
+		long port = strtol(colon + 1, &end, 10);
+
+		if (*end != '\0' || port <= 0 || port > 65535)
+			return -1;
+		*colon = '\0';
+		cfg->port = (uint16_t)port;
+	}
+	if (*arg == '\0')
+		return -1;
+	cfg->host = arg;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Set up the client and try the
+ *		first connection. An unreachable
+ *		broker is not an error, it is
+ *		retried from publish/poll.
+ ****************************************/
+int mqtt_client_init(struct mqtt_client *c, const struct mqtt_config *cfg)
+{
+	memset(c, 0, sizeof(*c));
+	c->cfg = *cfg;
+	c->fd = -1;
+	c->next_id = 1;
+
+	if (c->cfg.inflight == 0 || c->cfg.inflight > MQTT_MAX_INFLIGHT)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (c->cfg.retry_min_ms == 0)
+		c->cfg.retry_min_ms = 1;
+	if (c->cfg.retry_max_ms < c->cfg.retry_min_ms)
+		c->cfg.retry_max_ms = c->cfg.retry_min_ms;
+	c->backoff_ms = c->cfg.retry_min_ms;
+
+	if (cfg->client_id)
+		snprintf(c->client_id, sizeof(c->client_id), "%s",
+			 cfg->client_id);
+	else
+		snprintf(c->client_id, sizeof(c->client_id), "aesd-%d",
+			 (int)getpid());
+
+	mqtt_connect(c);
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Queue one PUBLISH. Nothing is
+ *		written until the output buffer
+ *		fills or mqtt_client_flush().
+ *
+ *		QoS 0 is dropped while offline.
+ *		QoS 1 is kept in the in-flight
+ *		window and resent on reconnect;
+ *		when the window is full we wait
+ *		up to timeout_ms for a PUBACK.
+ ****************************************/
+int mqtt_client_publish(struct mqtt_client *c, const char *topic,
+			const void *payload, size_t len, int qos)
+{
+	struct mqtt_inflight *slot;
+	uint8_t lenbuf[4];
+	size_t tlen = strlen(topic);
+	size_t rem = 2 + tlen + (qos ? 2 : 0) + len;
+	size_t total = 1 + mqtt_encode_len(lenbuf, rem) + rem;
+
+	if (qos < 0 || qos > 1 || tlen > 0xFFFF)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (total > (qos ? MQTT_MAX_PACKET : MQTT_OBUF_SIZE))
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	mqtt_service(c);
+
+	if (qos == 0)
+	{
+		if (c->fd < 0)
+		{
+			c->stats.dropped++;
+			errno = ENOTCONN;
+			return -1;
+		}
+		if (c->olen + total > sizeof(c->obuf) &&
+		    mqtt_client_flush(c) < 0)
+		{
+			c->stats.dropped++;
+			return -1;
+		}
+		c->olen += mqtt_encode_publish(c->obuf + c->olen, topic, tlen,
+					       payload, len, 0, 0);
+		c->stats.published++;
+		return 0;
+	}
+
+	if (c->count >= c->cfg.inflight &&
+	    mqtt_wait_ack(c, c->cfg.inflight - 1) < 0)
+	{
+		c->stats.dropped++;
+		errno = EAGAIN;
+		return -1;
+	}
+
+	slot = &c->slot[(c->head + c->count) % MQTT_MAX_INFLIGHT];
+	slot->id = c->next_id++;
+	if (c->next_id == 0)
+		c->next_id = 1;
+	slot->len = mqtt_encode_publish(slot->pkt, topic, tlen, payload, len,
+					1, slot->id);
+	slot->sent = 0;
+	c->count++;
+
+	if (c->fd >= 0 && mqtt_queue(c, slot->pkt, slot->len) == 0)
+	{
+		slot->sent = 1;
+		c->stats.published++;
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Write out everything queued
+ ****************************************/
+int mqtt_client_flush(struct mqtt_client *c)
+{
+	if (c->olen == 0)
+		return c->fd < 0 ? -1 : 0;
+	if (c->fd < 0)
+	{
+		c->olen = 0;
+		return -1;
+	}
+	if (mqtt_write_all(c, c->obuf, c->olen) < 0)
+	{
+		mqtt_disconnect(c);
+		return -1;
+	}
+	c->olen = 0;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Handle acks, keepalive and
+ *		reconnects. Waits up to
+ *		timeout_ms for broker traffic.
+ ****************************************/
+int mqtt_client_poll(struct mqtt_client *c, int timeout_ms)
+{
+	mqtt_service(c);
+	if (c->fd < 0)
+		return -1;
+
+	mqtt_client_flush(c);
+	if (c->fd >= 0 && timeout_ms > 0 &&
+	    mqtt_wait(c->fd, POLLIN, timeout_ms) > 0)
+		mqtt_read(c);
+
+	return c->fd < 0 ? -1 : 0;
+}
+
+/*****************************************
+ * @brief	Broker connection state
+ ****************************************/
+int mqtt_client_connected(const struct mqtt_client *c)
+{
+	return c->fd >= 0;
+}
+
+/*****************************************
+ * @brief	Print publish counters
+ ****************************************/
+void mqtt_client_print_stats(const struct mqtt_client *c, const char *name)
+{
+	printf("%s: published %llu, acked %llu, dropped %llu, resent %llu, "
+	       "connects %llu, writes %llu, in-flight %u\n",
+	       name,
+	       (unsigned long long)c->stats.published,
+	       (unsigned long long)c->stats.acked,
+	       (unsigned long long)c->stats.dropped,
+	       (unsigned long long)c->stats.resent,
+	       (unsigned long long)c->stats.connects,
+	       (unsigned long long)c->stats.writes,
+	       c->count);
+}
+
+/*****************************************
+ * @brief	Flush, wait up to timeout_ms
+ *		for every outstanding PUBACK
+ *		and close
+ ****************************************/
+void mqtt_client_close(struct mqtt_client *c)
+{
+	static const uint8_t disconnect[] = { MQTT_DISCONNECT, 0x00 };
+
+	if (c->fd >= 0)
+	{
+		mqtt_client_flush(c);
+		if (c->count)
+			mqtt_wait_ack(c, 0);
+	}
+	if (c->fd >= 0)
+	{
+		mqtt_write_all(c, disconnect, sizeof(disconnect));
+		close(c->fd);
+		c->fd = -1;
+	}
+}
+
+/*****************************************
+ * @brief	Monotonic time in mS
+ ****************************************/
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*****************************************
+ * @brief	MQTT variable length integer
+ ****************************************/
+static size_t mqtt_encode_len(uint8_t *p, size_t len)
+{
+	size_t n = 0;
+
+	do
+	{
+		uint8_t byte = len % 128;
+
+		len /= 128;
+		if (len > 0)
+			byte |= 0x80;
+		p[n++] = byte;
+	} while (len > 0 && n < 4);
+
+	return n;
+}
+
+/*****************************************
+ * @brief	Encode a PUBLISH packet,
+ *		returns the encoded length
+ ****************************************/
+static size_t mqtt_encode_publish(uint8_t *p, const char *topic, size_t tlen,
+				  const void *payload, size_t len, int qos,
+				  uint16_t id)
+{
+	size_t rem = 2 + tlen + (qos ? 2 : 0) + len;
+	size_t n = 0;
+
+	p[n++] = MQTT_PUBLISH | (qos ? MQTT_PUBLISH_QOS1 : 0);
+	n += mqtt_encode_len(p + n, rem);
+	p[n++] = tlen >> 8;
+	p[n++] = tlen & 0xFF;
+	memcpy(p + n, topic, tlen);
+	n += tlen;
+	if (qos)
+	{
+		p[n++] = id >> 8;
+		p[n++] = id & 0xFF;
+	}
+	memcpy(p + n, payload, len);
+
+	return n + len;
+}
+
+/*****************************************
+ * @brief	poll() one fd, retrying on
+ *		EINTR with the time left
+ ****************************************/
+static int mqtt_wait(int fd, short events, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = fd, .events = events };
+	uint64_t deadline = now_ms() + timeout_ms;
+	int ret;
+
+	while (1)
+	{
+		ret = poll(&pfd, 1, timeout_ms);
+		if (ret >= 0 || errno != EINTR)
+			return ret;
+
+		uint64_t now = now_ms();
+		if (now >= deadline)
+			return 0;
+		timeout_ms = deadline - now;
+	}
+}
+
+/*****************************************
+ * @brief	send() a whole buffer
+ ****************************************/
+static int mqtt_write_all(struct mqtt_client *c, const uint8_t *buf,
+			  size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0)
+	{
+		ret = send(c->fd, buf, len, MSG_NOSIGNAL);
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		c->stats.writes++;
+		buf += ret;
+		len -= ret;
+	}
+	c->last_tx_ms = now_ms();
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Append a packet to the output
+ *		buffer, flushing when full
+ ****************************************/
+static int mqtt_queue(struct mqtt_client *c, const uint8_t *pkt, size_t len)
+{
+	if (c->olen + len > sizeof(c->obuf) && mqtt_client_flush(c) < 0)
+		return -1;
+	memcpy(c->obuf + c->olen, pkt, len);
+	c->olen += len;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	TCP connect, CONNECT/CONNACK
+ *		handshake and resend of the
+ *		unacknowledged QoS 1 messages
+ ****************************************/
+static int mqtt_connect(struct mqtt_client *c)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+	struct addrinfo *res, *ai;
+	char port[8];
+	uint8_t pkt[32 + MQTT_CLIENT_ID_LEN];
+	size_t idlen = strlen(c->client_id);
+	size_t n = 0;
+	uint64_t deadline;
+	int one = 1;
+	int fd = -1;
+
+	snprintf(port, sizeof(port), "%u", c->cfg.port);
+	if (getaddrinfo(c->cfg.host, port, &hints, &res) != 0)
+		goto fail;
+
+	for (ai = res; ai; ai = ai->ai_next)
+	{
+		int err = 0;
+		socklen_t errlen = sizeof(err);
+
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC |
+			    SOCK_NONBLOCK, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		if (errno == EINPROGRESS &&
+		    mqtt_wait(fd, POLLOUT, c->cfg.timeout_ms) > 0 &&
+		    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == 0 &&
+		    err == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		goto fail;
+
+	// blocking from here on, acks are read with MSG_DONTWAIT
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	pkt[n++] = MQTT_CONNECT;
+	n += mqtt_encode_len(pkt + n, 10 + 2 + idlen);
+	pkt[n++] = 0x00;
+	pkt[n++] = 0x04;
+	memcpy(pkt + n, "MQTT", 4);
+	n += 4;
+	pkt[n++] = MQTT_PROTOCOL_LEVEL;
+	pkt[n++] = MQTT_CLEAN_SESSION;
+	pkt[n++] = c->cfg.keepalive >> 8;
+	pkt[n++] = c->cfg.keepalive & 0xFF;
+	pkt[n++] = idlen >> 8;
+	pkt[n++] = idlen & 0xFF;
+	memcpy(pkt + n, c->client_id, idlen);
+	n += idlen;
+
+	c->fd = fd;
+	c->ilen = 0;
+	c->olen = 0;
+	if (mqtt_write_all(c, pkt, n) < 0)
+		goto fail_close;
+
+	// CONNACK: 0x20 0x02 <session present> <return code>
+	deadline = now_ms() + c->cfg.timeout_ms;
+	while (c->ilen < 4)
+	{
+		uint64_t now = now_ms();
+		ssize_t ret;
+
+		if (now >= deadline ||
+		    mqtt_wait(fd, POLLIN, deadline - now) <= 0)
+			goto fail_close;
+		ret = recv(fd, c->ibuf + c->ilen, 4 - c->ilen, MSG_DONTWAIT);
+		if (ret == 0 || (ret < 0 && errno != EINTR && errno != EAGAIN))
+			goto fail_close;
+		if (ret > 0)
+			c->ilen += ret;
+	}
+	if (c->ibuf[0] != MQTT_CONNACK || c->ibuf[1] != 0x02 ||
+	    c->ibuf[3] != 0x00)
+	{
+		fprintf(stderr, "mqtt: broker refused connection (%u)\n",
+			c->ibuf[3]);
+		goto fail_close;
+	}
+	c->ilen = 0;
+	c->ping_ms = 0;
+	c->backoff_ms = c->cfg.retry_min_ms;
+	c->stats.connects++;
+
+	for (unsigned int i = 0; i < c->count; i++)
+	{
+		struct mqtt_inflight *slot =
+			&c->slot[(c->head + i) % MQTT_MAX_INFLIGHT];
+
+		if (slot->id == 0)
+			continue;
+		if (slot->sent)
+		{
+			slot->pkt[0] |= MQTT_PUBLISH_DUP;
+			c->stats.resent++;
+		}
+		else
+		{
+			c->stats.published++;
+		}
+		slot->sent = 1;
+		if (mqtt_queue(c, slot->pkt, slot->len) < 0)
+			return -1;
+	}
+
+	return mqtt_client_flush(c);
+
+fail_close:
+	c->fd = -1;
+	close(fd);
+fail:
+	c->retry_ms = now_ms() + c->backoff_ms;
+	c->backoff_ms = c->backoff_ms * 2 > c->cfg.retry_max_ms ?
+			c->cfg.retry_max_ms : c->backoff_ms * 2;
+	return -1;
+}
+
+/*****************************************
+ * @brief	Drop a broken connection and
+ *		schedule the next attempt
+ ****************************************/
+static void mqtt_disconnect(struct mqtt_client *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+	c->olen = 0;
+	c->ilen = 0;
+	c->ping_ms = 0;
+	c->retry_ms = now_ms() + c->backoff_ms;
+	c->backoff_ms = c->backoff_ms * 2 > c->cfg.retry_max_ms ?
+			c->cfg.retry_max_ms : c->backoff_ms * 2;
+}
+
+/*****************************************
+ * @brief	Read whatever the broker sent
+ *		and process complete packets
+ ****************************************/
+static int mqtt_read(struct mqtt_client *c)
+{
+	ssize_t ret;
+
+	ret = recv(c->fd, c->ibuf + c->ilen, sizeof(c->ibuf) - c->ilen,
+		   MSG_DONTWAIT);
+	if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EINTR))
+	{
+		mqtt_disconnect(c);
+		return -1;
+	}
+	if (ret > 0)
+		c->ilen += ret;
+
+	while (c->ilen >= 2)
+	{
+		size_t rem = 0, hdr = 1, total;
+		unsigned int shift = 0;
+
+		// decode the remaining length
+		while (1)
+		{
+			if (hdr >= c->ilen)
+				return 0;
+			rem |= (size_t)(c->ibuf[hdr] & 0x7F) << shift;
+			shift += 7;
+			if (!(c->ibuf[hdr++] & 0x80))
+				break;
+			if (hdr > 4)
+			{
+				mqtt_disconnect(c);
+				return -1;
+			}
+		}
+		total = hdr + rem;
+		if (total > sizeof(c->ibuf))
+		{
+			mqtt_disconnect(c);
+			return -1;
+		}
+		if (c->ilen < total)
+			return 0;
+
+		switch (c->ibuf[0] & 0xF0)
+		{
+		case MQTT_PUBACK:
+			if (rem >= 2)
+				mqtt_ack(c, (c->ibuf[hdr] << 8) |
+					    c->ibuf[hdr + 1]);
+			break;
+		case MQTT_PINGRESP:
+			c->ping_ms = 0;
+			break;
+		default:
+			break;
+		}
+
+		c->ilen -= total;
+		memmove(c->ibuf, c->ibuf + total, c->ilen);
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Retire an in-flight message
+ ****************************************/
+static void mqtt_ack(struct mqtt_client *c, uint16_t id)
+{
+	for (unsigned int i = 0; i < c->count; i++)
+	{
+		struct mqtt_inflight *slot =
+			&c->slot[(c->head + i) % MQTT_MAX_INFLIGHT];
+
+		if (slot->id == id)
+		{
+			slot->id = 0;
+			c->stats.acked++;
+			break;
+		}
+	}
+	// PUBACKs normally arrive in order, so this pops them one by one
+	while (c->count && c->slot[c->head].id == 0)
+	{
+		c->head = (c->head + 1) % MQTT_MAX_INFLIGHT;
+		c->count--;
+	}
+}
+
+/*****************************************
+ * @brief	Block until at most max QoS 1
+ *		messages await a PUBACK, the
+ *		window has room at inflight - 1
+ *		and is drained at 0. A broker
+ *		that stays silent for timeout_ms
+ *		is treated as gone.
+ ****************************************/
+static int mqtt_wait_ack(struct mqtt_client *c, unsigned int max)
+{
+	uint64_t deadline = now_ms() + c->cfg.timeout_ms;
+
+	if (c->fd < 0 || mqtt_client_flush(c) < 0)
+		return -1;
+
+	while (c->count > max)
+	{
+		uint64_t now = now_ms();
+
+		if (now >= deadline ||
+		    mqtt_wait(c->fd, POLLIN, deadline - now) <= 0)
+		{
+			mqtt_disconnect(c);
+			return -1;
+		}
+		if (mqtt_read(c) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Reconnect when due, collect
+ *		acks and keep the session alive.
+ *		Costs no syscall when idle.
+ ****************************************/
+static void mqtt_service(struct mqtt_client *c)
+{
+	static const uint8_t pingreq[] = { MQTT_PINGREQ, 0x00 };
+	uint64_t now = now_ms();
+
+	if (c->fd < 0)
+	{
+		if (now >= c->retry_ms)
+			mqtt_connect(c);
+		return;
+	}
+
+	if ((c->count || c->ping_ms) && mqtt_read(c) < 0)
+		return;
+
+	if (c->cfg.keepalive == 0)
+		return;
+	if (c->ping_ms)
+	{
+		if (now - c->ping_ms > c->cfg.keepalive * 1000ULL)
+			mqtt_disconnect(c);
+	}
+	else if (now - c->last_tx_ms >= c->cfg.keepalive * 500ULL)
+	{
+		if (mqtt_queue(c, pingreq, sizeof(pingreq)) == 0 &&
+		    mqtt_client_flush(c) == 0)
+			c->ping_ms = now;
+	}
+}
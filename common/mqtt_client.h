@@ -0,0 +1,103 @@
+/***********************************************************************
+ * @file      		mqtt_client.h
+ * @version   		0.1
+ * @brief		persistent MQTT 3.1.1 publisher shared by the apps
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * One TCP connection to the broker is opened once and reused for every
+ * reading. QoS 0 messages are written straight to an output buffer,
+ * QoS 1 messages are also kept in a bounded in-flight window until the
+ * broker acknowledges them, so they can be resent after a reconnect.
+ *
+ * A client instance is not thread safe, it must be owned by one thread.
+ *
+ * @references
+ *
+ * http://docs.oasis-open.org/mqtt/mqtt/v3.1.1/os/mqtt-v3.1.1-os.html
+ *
+ ************************************************************************/
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/**************************** Defines  **********************************/
+#define MQTT_DEFAULT_HOST	"localhost"
+#define MQTT_DEFAULT_PORT	(1883)
+#define MQTT_DEFAULT_KEEPALIVE	(30)	// seconds
+#define MQTT_DEFAULT_INFLIGHT	(8)	// QoS 1 messages awaiting PUBACK
+#define MQTT_MAX_INFLIGHT	(32)	// upper bound of the QoS 1 window
+#define MQTT_MAX_PACKET		(256)	// largest QoS 1 PUBLISH kept for resend
+#define MQTT_OBUF_SIZE		(4096)	// publishes coalesced per write()
+#define MQTT_IBUF_SIZE		(256)	// we never subscribe, acks are tiny
+#define MQTT_CLIENT_ID_LEN	(24)
+
+/**************************** Data Types ********************************/
+struct mqtt_config {
+	const char *host;		// broker host name or address
+	uint16_t port;			// broker TCP port
+	const char *client_id;		// NULL: derived from the pid
+	uint16_t keepalive;		// seconds, 0 disables PINGREQ
+	unsigned int inflight;		// QoS 1 window, 1..MQTT_MAX_INFLIGHT
+	unsigned int timeout_ms;	// connect / CONNACK / PUBACK wait
+	unsigned int retry_min_ms;	// first reconnect back-off
+	unsigned int retry_max_ms;	// back-off ceiling
+};
+
+struct mqtt_stats {
+	uint64_t published;		// PUBLISH packets handed to the socket
+	uint64_t acked;			// PUBACKs received for QoS 1
+	uint64_t dropped;		// messages refused while offline/full
+	uint64_t resent;		// QoS 1 retransmissions after reconnect
+	uint64_t connects;		// successful CONNECT/CONNACK handshakes
+	uint64_t writes;		// write syscalls issued to the socket
+};
+
+struct mqtt_inflight {
+	uint16_t id;			// packet identifier, 0 once acked
+	uint16_t len;			// encoded PUBLISH length
+	uint8_t sent;			// written at least once (DUP on resend)
+	uint8_t pkt[MQTT_MAX_PACKET];	// encoded PUBLISH for resending
+};
+
+struct mqtt_client {
+	struct mqtt_config cfg;
+	char client_id[MQTT_CLIENT_ID_LEN];
+	int fd;				// -1 while disconnected
+	uint16_t next_id;
+	uint64_t last_tx_ms;		// last byte written, for keepalive
+	uint64_t ping_ms;		// PINGREQ outstanding since, 0 if none
+	uint64_t retry_ms;		// next reconnect attempt
+	unsigned int backoff_ms;
+	unsigned int head;		// oldest in-flight slot
+	unsigned int count;		// in-flight slots in use
+	struct mqtt_inflight slot[MQTT_MAX_INFLIGHT];
+	size_t olen;
+	uint8_t obuf[MQTT_OBUF_SIZE];
+	size_t ilen;
+	uint8_t ibuf[MQTT_IBUF_SIZE];
+	struct mqtt_stats stats;
+};
+
+/**************************** Function Declarations *********************/
+void mqtt_config_default(struct mqtt_config *cfg);
+int mqtt_parse_broker(struct mqtt_config *cfg, char *arg);
+
+int mqtt_client_init(struct mqtt_client *c, const struct mqtt_config *cfg);
+int mqtt_client_publish(struct mqtt_client *c, const char *topic,
+			const void *payload, size_t len, int qos);
+int mqtt_client_flush(struct mqtt_client *c);
+int mqtt_client_poll(struct mqtt_client *c, int timeout_ms);
+int mqtt_client_connected(const struct mqtt_client *c);
+void mqtt_client_print_stats(const struct mqtt_client *c, const char *name);
+void mqtt_client_close(struct mqtt_client *c);
+
+#endif /* MQTT_CLIENT_H */
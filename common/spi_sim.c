@@ -0,0 +1,434 @@
+/***********************************************************************
+ * @file      		spi_sim.c
+ * @version   		0.1
+ * @brief		simulated MCP3008 on a pulse sensor, spi transport
+ *			backend
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * While CS is asserted the ADC waits for a start bit, shifts in SGL/DIFF
+ * and D2..D0, samples on the next clock, drives a null bit and then
+ * B9..B0 MSB first followed by B1..B9 LSB first. Releasing CS (end of
+ * message, or cs_change between transfers) starts a new frame.
+ *
+ * @references
+ *
+ * https://ww1.microchip.com/downloads/en/DeviceDoc/21295d.pdf
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/spi/spidev.h>
+
+#include "spi_sim.h"
+
+/**************************** Defines  **********************************/
+#define SIM_CHANNELS		(8)
+#define SIM_ADC_MAX		(1023)
+#define SIM_MIN_IBI_MS		(250.0)
+#define SIM_DEFAULT_SPEED	(500000)
+
+// clocks after the start bit
+#define SIM_POS_SAMPLE		(5)	// after D0, sample and hold ends
+#define SIM_POS_NULL		(6)	// null bit
+#define SIM_POS_MSB		(7)	// B9, B0 at 16
+#define SIM_POS_LSB_END		(25)	// B1..B9 again, LSB first
+
+/**************************** Data Types ********************************/
+struct sim_config {
+	double bpm;
+	double hrv_ms;
+	int base;
+	int amp;
+	int noise;
+	double drop;
+	unsigned int latency_us;
+	int wire;
+	uint64_t seed;
+};
+
+struct sim_channel {
+	double beat_ms;			// start of the current beat
+	double ibi_ms;			// length of the current beat
+	int dropped;			// current beat is missing
+};
+
+struct spi_sim {
+	struct sim_config cfg;
+	uint32_t mode;
+	uint8_t bits;
+	uint8_t lsb;
+	uint32_t speed;
+	uint64_t rng;
+	uint64_t t0_ns;			// open time, waveform time 0
+	// frame state while CS is asserted
+	int pos;			// clocks since the start bit, -1 idle
+	uint8_t cmd;			// SGL/DIFF, D2, D1, D0
+	uint16_t value;			// conversion result being shifted out
+	struct sim_channel ch[SIM_CHANNELS];
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	CLOCK_MONOTONIC in nS
+ ****************************************/
+static uint64_t sim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*****************************************
+ * @brief	xorshift64*, uniform in [0,1)
+ ****************************************/
+static double sim_uniform(struct spi_sim *s)
+{
+	s->rng ^= s->rng >> 12;
+	s->rng ^= s->rng << 25;
+	s->rng ^= s->rng >> 27;
+	return ((s->rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*****************************************
+ * @brief	Length of the next beat
+ ****************************************/
+static double sim_next_ibi(struct spi_sim *s)
+{
+	double ibi = 60000.0 / s->cfg.bpm;
+
+	if (s->cfg.hrv_ms > 0)
+	{
+		// sum of 4 uniforms: close enough to normal, unit variance
+		double g = 0;
+
+		for (int i = 0; i < 4; i++)
+			g += sim_uniform(s);
+		ibi += (g - 2.0) * sqrt(3.0) * s->cfg.hrv_ms;
+	}
+
+	return ibi < SIM_MIN_IBI_MS ? SIM_MIN_IBI_MS : ibi;
+}
+
+/*****************************************
+ * @brief	Sensor output of a channel at
+ *		t_ms, in ADC counts
+ ****************************************/
+static int sim_wave(struct spi_sim *s, int c, double t_ms)
+{
+	struct sim_channel *ch = &s->ch[c];
+	double ph, f = 0;
+	int v;
+
+	while (t_ms >= ch->beat_ms + ch->ibi_ms)
+	{
+		ch->beat_ms += ch->ibi_ms;
+		ch->ibi_ms = sim_next_ibi(s);
+		ch->dropped = s->cfg.drop > 0 && sim_uniform(s) < s->cfg.drop;
+	}
+
+	// systolic peak followed by the smaller diastolic wave
+	ph = (t_ms - ch->beat_ms) / ch->ibi_ms;
+	if (!ch->dropped)
+		f = exp(-((ph - 0.15) / 0.06) * ((ph - 0.15) / 0.06)) +
+		    0.35 * exp(-((ph - 0.45) / 0.09) * ((ph - 0.45) / 0.09));
+
+	v = s->cfg.base + (int)(s->cfg.amp * f);
+	if (s->cfg.noise)
+		v += (int)((2.0 * sim_uniform(s) - 1.0) * s->cfg.noise);
+
+	return v < 0 ? 0 : v > SIM_ADC_MAX ? SIM_ADC_MAX : v;
+}
+
+/*****************************************
+ * @brief	One SCLK: take the MOSI bit,
+ *		return the MISO bit
+ ****************************************/
+static int sim_clock(struct spi_sim *s, int mosi, uint64_t t_ns)
+{
+	if (s->pos < 0)
+	{
+		// leading zeros before the start bit are ignored
+		if (mosi)
+		{
+			s->pos = 0;
+			s->cmd = 0;
+		}
+		return 0;
+	}
+
+	s->pos++;
+	if (s->pos < SIM_POS_SAMPLE)
+	{
+		s->cmd = (s->cmd << 1) | mosi;
+		return 0;
+	}
+	if (s->pos == SIM_POS_SAMPLE)
+	{
+		double t_ms = (t_ns - s->t0_ns) / 1e6;
+		int c = s->cmd & (SIM_CHANNELS - 1);
+
+		if (s->cmd & 0x08)
+		{
+			s->value = sim_wave(s, c, t_ms);
+		}
+		else
+		{
+			// differential: IN+ is c, IN- its pair, clipped at 0
+			int d = sim_wave(s, c, t_ms) - sim_wave(s, c ^ 1, t_ms);
+
+			s->value = d > 0 ? d : 0;
+		}
+		return 0;
+	}
+	if (s->pos <= SIM_POS_NULL)
+		return 0;
+	if (s->pos < SIM_POS_MSB + 10)
+		return (s->value >> (SIM_POS_MSB + 9 - s->pos)) & 1;
+	if (s->pos <= SIM_POS_LSB_END)
+		return (s->value >> (s->pos - (SIM_POS_MSB + 9))) & 1;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	SPI_IOC_MESSAGE(n)
+ ****************************************/
+static int sim_message(struct spi_sim *s, struct spi_ioc_transfer *tr,
+		       unsigned int n)
+{
+	uint64_t start = sim_now_ns();
+	uint64_t t_ns = 0;		// clock time into the message
+	int total = 0;
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		const uint8_t *tx = (const uint8_t *)(uintptr_t)tr[i].tx_buf;
+		uint8_t *rx = (uint8_t *)(uintptr_t)tr[i].rx_buf;
+		uint32_t hz = tr[i].speed_hz ? tr[i].speed_hz : s->speed;
+		uint64_t bit_ns = 1000000000ULL / (hz ? hz : SIM_DEFAULT_SPEED);
+		int release;
+
+		for (uint32_t b = 0; b < tr[i].len; b++)
+		{
+			uint8_t out = 0;
+			uint8_t in = tx ? tx[b] : 0;
+
+			for (int bit = 7; bit >= 0; bit--)
+			{
+				out |= sim_clock(s, (in >> bit) & 1, start + t_ns) << bit;
+				t_ns += bit_ns;
+			}
+			if (rx)
+				rx[b] = out;
+		}
+		total += tr[i].len;
+		t_ns += tr[i].delay_usecs * 1000ULL;
+
+		// cs_change releases CS between transfers, but keeps it
+		// asserted after the last one
+		release = (i + 1 < n) ? tr[i].cs_change : !tr[i].cs_change;
+		if (release)
+			s->pos = -1;
+	}
+
+	if (s->cfg.wire || s->cfg.latency_us)
+	{
+		uint64_t end = start + (s->cfg.wire ? t_ns : 0) +
+			       s->cfg.latency_us * 1000ULL;
+		struct timespec ts = {
+			.tv_sec = end / 1000000000ULL,
+			.tv_nsec = end % 1000000000ULL,
+		};
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+	}
+
+	return total;
+}
+
+/*****************************************
+ * @brief	spidev ioctls
+ ****************************************/
+static int sim_ioctl(void *priv, unsigned long req, void *arg)
+{
+	struct spi_sim *s = priv;
+
+	if (_IOC_TYPE(req) == SPI_IOC_MAGIC && _IOC_NR(req) == 0 &&
+	    _IOC_DIR(req) == _IOC_WRITE)
+	{
+		unsigned int size = _IOC_SIZE(req);
+
+		if (size == 0 || size % sizeof(struct spi_ioc_transfer))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		return sim_message(s, arg, size / sizeof(struct spi_ioc_transfer));
+	}
+
+	switch (req) {
+	case SPI_IOC_WR_MODE:
+		s->mode = (s->mode & ~0xFFU) | *(uint8_t *)arg;
+		return 0;
+	case SPI_IOC_RD_MODE:
+		*(uint8_t *)arg = s->mode;
+		return 0;
+	case SPI_IOC_WR_MODE32:
+		s->mode = *(uint32_t *)arg;
+		return 0;
+	case SPI_IOC_RD_MODE32:
+		*(uint32_t *)arg = s->mode;
+		return 0;
+	case SPI_IOC_WR_LSB_FIRST:
+		s->lsb = *(uint8_t *)arg;
+		return 0;
+	case SPI_IOC_RD_LSB_FIRST:
+		*(uint8_t *)arg = s->lsb;
+		return 0;
+	case SPI_IOC_WR_BITS_PER_WORD:
+		s->bits = *(uint8_t *)arg;
+		return 0;
+	case SPI_IOC_RD_BITS_PER_WORD:
+		*(uint8_t *)arg = s->bits;
+		return 0;
+	case SPI_IOC_WR_MAX_SPEED_HZ:
+		s->speed = *(uint32_t *)arg;
+		return 0;
+	case SPI_IOC_RD_MAX_SPEED_HZ:
+		*(uint32_t *)arg = s->speed;
+		return 0;
+	default:
+		errno = ENOTTY;
+		return -1;
+	}
+}
+
+/*****************************************
+ * @brief	Parse "key=value,..." settings
+ ****************************************/
+static int sim_parse(struct sim_config *cfg, const char *args)
+{
+	char *copy = strdup(args);
+	char *tok, *save;
+	int ret = 0;
+
+	if (copy == NULL)
+		return -1;
+
+	for (tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+	{
+		char *val = strchr(tok, '=');
+		char *end;
+		double v;
+
+		if (val == NULL)
+		{
+			ret = -1;
+			break;
+		}
+		*val++ = '\0';
+		v = strtod(val, &end);
+		if (*end != '\0' || v < 0)
+		{
+			ret = -1;
+			break;
+		}
+
+		if (strcmp(tok, "bpm") == 0 && v > 0)
+			cfg->bpm = v;
+		else if (strcmp(tok, "hrv") == 0)
+			cfg->hrv_ms = v;
+		else if (strcmp(tok, "base") == 0)
+			cfg->base = v;
+		else if (strcmp(tok, "amp") == 0)
+			cfg->amp = v;
+		else if (strcmp(tok, "noise") == 0)
+			cfg->noise = v;
+		else if (strcmp(tok, "drop") == 0 && v <= 1)
+			cfg->drop = v;
+		else if (strcmp(tok, "latency") == 0)
+			cfg->latency_us = v;
+		else if (strcmp(tok, "wire") == 0)
+			cfg->wire = v != 0;
+		else if (strcmp(tok, "seed") == 0)
+			cfg->seed = v;
+		else
+		{
+			ret = -1;
+			break;
+		}
+	}
+
+	free(copy);
+	if (ret < 0)
+		errno = EINVAL;
+	return ret;
+}
+
+/*****************************************
+ * @brief	Create a simulated device
+ ****************************************/
+static void *sim_open(const char *args)
+{
+	struct spi_sim *s = calloc(1, sizeof(*s));
+
+	if (s == NULL)
+		return NULL;
+
+	s->cfg.bpm = 72;
+	s->cfg.base = 450;
+	s->cfg.amp = 350;
+	s->cfg.wire = 1;
+	s->cfg.seed = 1;
+	if (sim_parse(&s->cfg, args) < 0)
+	{
+		free(s);
+		return NULL;
+	}
+
+	s->bits = 8;
+	s->speed = SIM_DEFAULT_SPEED;
+	s->rng = s->cfg.seed ? s->cfg.seed : 1;
+	s->pos = -1;
+	s->t0_ns = sim_now_ns();
+	for (int c = 0; c < SIM_CHANNELS; c++)
+	{
+		s->ch[c].ibi_ms = 60000.0 / s->cfg.bpm;
+		s->ch[c].beat_ms = s->ch[c].ibi_ms * c / SIM_CHANNELS;
+	}
+
+	return s;
+}
+
+/*****************************************
+ * @brief	Release a simulated device
+ ****************************************/
+static void sim_close(void *priv)
+{
+	free(priv);
+}
+
+/**************************** Global Variables **************************/
+const struct spi_transport_ops spi_sim_ops = {
+	.prefix = "sim",
+	.open = sim_open,
+	.ioctl = sim_ioctl,
+	.close = sim_close,
+};
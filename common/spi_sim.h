@@ -0,0 +1,40 @@
+/***********************************************************************
+ * @file      		spi_sim.h
+ * @version   		0.1
+ * @brief		simulated MCP3008 on a pulse sensor, spi transport
+ *			backend
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Opened as "sim" or "sim:key=value,...". The device decodes MCP3008
+ * command frames bit by bit, exactly as the chip clocks them, and
+ * answers with a synthetic photoplethysmogram sampled at the moment
+ * the conversion happens. Every input carries the same waveform,
+ * phase shifted by 1/8 of a beat per channel.
+ *
+ *   bpm=72       mean heart rate
+ *   hrv=0        beat to beat interval spread (standard deviation, mS)
+ *   base=450     ADC counts between beats
+ *   amp=350      systolic peak height above base, counts
+ *   noise=0      uniform noise, +/- counts
+ *   drop=0       probability a beat is missing (sensor dropout)
+ *   latency=0    extra uS per SPI_IOC_MESSAGE
+ *   wire=1       0: do not sleep for the modelled clock time
+ *   seed=1       noise, HRV and dropout random seed
+ *
+ ************************************************************************/
+#ifndef SPI_SIM_H
+#define SPI_SIM_H
+
+/**************************** Header Files ******************************/
+#include "spi_transport.h"
+
+/**************************** Global Variables **************************/
+extern const struct spi_transport_ops spi_sim_ops;
+
+#endif /* SPI_SIM_H */
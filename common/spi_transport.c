@@ -0,0 +1,157 @@
+/***********************************************************************
+ * @file      		spi_transport.c
+ * @version   		0.1
+ * @brief		pluggable SPI transport, spidev or simulated devices
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * @references
+ *
+ * https://www.kernel.org/doc/html/latest/spi/spidev.html
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "spi_transport.h"
+#include "spi_sim.h"
+
+/**************************** Data Types ********************************/
+struct spi_handle {
+	int fd;				// reserved descriptor, -1 if slot is free
+	const struct spi_transport_ops *ops;
+	void *priv;
+};
+
+/**************************** Global Variables **************************/
+static const struct spi_transport_ops *const backends[] = {
+	&spi_sim_ops,
+};
+
+// fd publishes a slot, stored last on open and first on close
+static struct spi_handle handles[SPI_TRANSPORT_MAX_OPEN] = {
+	[0 ... SPI_TRANSPORT_MAX_OPEN - 1] = { .fd = -1 },
+};
+static pthread_mutex_t handles_lock = PTHREAD_MUTEX_INITIALIZER;	// writers only
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Backend slot owning fd, NULL
+ *		for kernel spidev descriptors,
+ *		lock free so threads on
+ *		different devices never meet
+ ****************************************/
+static struct spi_handle *spi_lookup(int fd)
+{
+	if (fd < 0)
+		return NULL;
+	for (int i = 0; i < SPI_TRANSPORT_MAX_OPEN; i++)
+		if (__atomic_load_n(&handles[i].fd, __ATOMIC_ACQUIRE) == fd)
+			return &handles[i];
+
+	return NULL;
+}
+
+/*****************************************
+ * @brief	Open a spidev node or a
+ *		backend device, returns an fd
+ ****************************************/
+int spi_open(const char *device)
+{
+	for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+	{
+		const struct spi_transport_ops *ops = backends[b];
+		size_t len = strlen(ops->prefix);
+		struct spi_handle *h = NULL;
+		void *priv;
+		int fd;
+
+		if (strncmp(device, ops->prefix, len) != 0 ||
+		    (device[len] != '\0' && device[len] != ':'))
+			continue;
+
+		// a real descriptor keeps the number unique and close() safe
+		fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+		priv = ops->open(device[len] ? device + len + 1 : "");
+		if (priv == NULL)
+		{
+			close(fd);
+			return -1;
+		}
+
+		pthread_mutex_lock(&handles_lock);
+		for (int i = 0; i < SPI_TRANSPORT_MAX_OPEN; i++)
+		{
+			if (handles[i].fd < 0)
+			{
+				h = &handles[i];
+				h->ops = ops;
+				h->priv = priv;
+				__atomic_store_n(&h->fd, fd, __ATOMIC_RELEASE);
+				break;
+			}
+		}
+		pthread_mutex_unlock(&handles_lock);
+
+		if (h == NULL)
+		{
+			ops->close(priv);
+			close(fd);
+			errno = EMFILE;
+			return -1;
+		}
+		return fd;
+	}
+
+	return open(device, O_RDWR);
+}
+
+/*****************************************
+ * @brief	spidev ioctl on either kind
+ *		of descriptor
+ ****************************************/
+int spi_ioctl(int fd, unsigned long req, void *arg)
+{
+	struct spi_handle *h = spi_lookup(fd);
+
+	if (h == NULL)
+		return ioctl(fd, req, arg);
+	return h->ops->ioctl(h->priv, req, arg);
+}
+
+/*****************************************
+ * @brief	Close either kind of descriptor
+ ****************************************/
+int spi_close(int fd)
+{
+	struct spi_handle *h = spi_lookup(fd);
+
+	if (h != NULL)
+	{
+		const struct spi_transport_ops *ops = h->ops;
+		void *priv = h->priv;
+
+		// unpublish first, the slot may be taken again right after
+		pthread_mutex_lock(&handles_lock);
+		__atomic_store_n(&h->fd, -1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&handles_lock);
+		ops->close(priv);
+	}
+
+	return close(fd);
+}
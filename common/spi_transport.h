@@ -0,0 +1,42 @@
+/***********************************************************************
+ * @file      		spi_transport.h
+ * @version   		0.1
+ * @brief		pluggable SPI transport, spidev or simulated devices
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Drop-in replacements for open/ioctl/close on a spidev node. A device
+ * name that starts with a registered backend prefix followed by ':' or
+ * nothing (e.g. "sim" or "sim:bpm=80,noise=20") opens that backend
+ * instead of a device node; anything else is passed to the kernel.
+ *
+ * Backends get a real descriptor reserved for them, so the returned
+ * value behaves like any fd, and they implement the spidev ioctls
+ * (SPI_IOC_MESSAGE and the mode/bits/speed setters and getters).
+ *
+ ************************************************************************/
+#ifndef SPI_TRANSPORT_H
+#define SPI_TRANSPORT_H
+
+/**************************** Defines  **********************************/
+#define SPI_TRANSPORT_MAX_OPEN	(16)	// backend devices open at once
+
+/**************************** Data Types ********************************/
+struct spi_transport_ops {
+	const char *prefix;		// device name prefix selecting the backend
+	void *(*open)(const char *args);	// text after "prefix:", or ""
+	int (*ioctl)(void *priv, unsigned long req, void *arg);
+	void (*close)(void *priv);
+};
+
+/**************************** Function Declarations *********************/
+int spi_open(const char *device);
+int spi_ioctl(int fd, unsigned long req, void *arg);
+int spi_close(int fd);
+
+#endif /* SPI_TRANSPORT_H */
@@ -0,0 +1,923 @@
+/***********************************************************************
+ * @file      		ts_store.c
+ * @version   		0.1
+ * @brief		append-only memory mapped time-series store
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * @references
+ *
+ * https://man7.org/linux/man-pages/man2/mmap.2.html
+ * https://man7.org/linux/man-pages/man2/msync.2.html
+ * https://man7.org/linux/man-pages/man3/posix_fallocate.3.html
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ts_store.h"
+
+/**************************** Defines  **********************************/
+#define TS_NAME_LEN		(8 + sizeof(TS_SUFFIX))
+#define TS_PATH_LEN		(256)
+#define TS_RECORDS(mb, size)	((uint32_t)(((mb) * (1 << 20) - TS_HEADER_SIZE) / (size)))
+
+_Static_assert(sizeof(struct ts_record) == 16, "record layout");
+_Static_assert(sizeof(struct ts_rollup) == 32, "rollup layout");
+_Static_assert(sizeof(struct ts_segment_header) == TS_HEADER_SIZE, "header layout");
+
+/**************************** Global Variables **************************/
+const char *const ts_level_name[TS_LEVELS] = { "", "1s", "1m", "1h" };
+const uint64_t ts_level_us[TS_LEVELS] = {
+	0, TS_SECOND_US, 60 * TS_SECOND_US, 3600 * TS_SECOND_US
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Defaults, no directory set
+ ****************************************/
+void ts_store_config_default(struct ts_store_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->segment_records = TS_RECORDS(TS_SEGMENT_MB, sizeof(struct ts_record));
+	cfg->keep = TS_KEEP_SEGMENTS;
+	cfg->flush_ms = TS_FLUSH_MS;
+	cfg->rollups = 1;
+	cfg->rollup_records = TS_RECORDS(TS_ROLLUP_MB, sizeof(struct ts_rollup));
+	cfg->rollup_keep = TS_ROLLUP_KEEP;
+}
+
+/*****************************************
+ * @brief	Parse dir[:key=value,...],
+ *		spec is split in place and
+ *		cfg->dir points into it
+ ****************************************/
+int ts_store_parse(struct ts_store_config *cfg, char *spec)
+{
+	char *args = strchr(spec, ':');
+	char *tok, *save;
+
+	if (args)
+		*args++ = '\0';
+	if (*spec == '\0')
+		goto invalid;
+	cfg->dir = spec;
+
+	for (tok = args ? strtok_r(args, ",", &save) : NULL; tok;
+	     tok = strtok_r(NULL, ",", &save))
+	{
+		char *val = strchr(tok, '=');
+		char *end;
+		double v;
+
+		if (val == NULL)
+			goto invalid;
+		*val++ = '\0';
+		v = strtod(val, &end);
+		if (*end != '\0' || v < 0)
+			goto invalid;
+
+		if (strcmp(tok, "seg") == 0 && v > 0 && v <= 1024)
+			cfg->segment_records = TS_RECORDS(v, sizeof(struct ts_record));
+		else if (strcmp(tok, "keep") == 0)
+			cfg->keep = v;
+		else if (strcmp(tok, "flush") == 0)
+			cfg->flush_ms = v;
+		else if (strcmp(tok, "sync") == 0)
+			cfg->sync = v != 0;
+		else if (strcmp(tok, "roll") == 0)
+			cfg->rollups = v != 0;
+		else if (strcmp(tok, "rseg") == 0 && v > 0 && v <= 1024)
+			cfg->rollup_records = TS_RECORDS(v, sizeof(struct ts_rollup));
+		else if (strcmp(tok, "rkeep") == 0)
+			cfg->rollup_keep = v;
+		else
+			goto invalid;
+	}
+	if (cfg->segment_records == 0 || cfg->rollup_records == 0)
+		goto invalid;
+
+	return 0;
+
+invalid:
+	errno = EINVAL;
+	return -1;
+}
+
+/*****************************************
+ * @brief	Sequence number of a segment
+ *		file name, -1 if it is not one
+ ****************************************/
+static int ts_name_seq(const char *name, uint64_t *seq)
+{
+	char *end;
+
+	if (strlen(name) != TS_NAME_LEN - 1 || name[0] == '-' || name[0] == '+')
+		return -1;
+	*seq = strtoull(name, &end, 16);
+	if (end != name + 8 || strcmp(end, TS_SUFFIX) != 0)
+		return -1;
+
+	return 0;
+}
+
+static int ts_seq_compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*****************************************
+ * @brief	Segments of an open directory
+ *		stream, oldest first, closes it
+ ****************************************/
+static int ts_list(DIR *d, uint64_t **seqs, size_t *count)
+{
+	struct dirent *de;
+	uint64_t *list = NULL, *grow, seq;
+	size_t n = 0, size = 0;
+
+	*seqs = NULL;
+	*count = 0;
+	if (d == NULL)
+		return -1;
+
+	while ((de = readdir(d)) != NULL)
+	{
+		if (ts_name_seq(de->d_name, &seq) < 0)
+			continue;
+		if (n == size)
+		{
+			size = size ? size * 2 : 64;
+			grow = realloc(list, size * sizeof(*list));
+			if (grow == NULL)
+			{
+				free(list);
+				closedir(d);
+				return -1;
+			}
+			list = grow;
+		}
+		list[n++] = seq;
+	}
+	closedir(d);
+
+	if (n)
+		qsort(list, n, sizeof(*list), ts_seq_compare);
+	*seqs = list;
+	*count = n;
+	return 0;
+}
+
+/*****************************************
+ * @brief	Segments in dir, oldest first,
+ *		*seqs is malloc'd, NULL if none
+ ****************************************/
+int ts_store_list(const char *dir, uint64_t **seqs, size_t *count)
+{
+	return ts_list(opendir(dir), seqs, count);
+}
+
+/*****************************************
+ * @brief	Same for a directory fd, which
+ *		stays open
+ ****************************************/
+static int ts_list_fd(int dir_fd, uint64_t **seqs, size_t *count)
+{
+	int fd = dup(dir_fd);
+	DIR *d;
+
+	if (fd < 0)
+		return -1;
+	d = fdopendir(fd);
+	if (d == NULL)
+	{
+		close(fd);
+		return -1;
+	}
+	// the dup shares the position with dir_fd
+	rewinddir(d);
+	return ts_list(d, seqs, count);
+}
+
+/*****************************************
+ * @brief	Record i and its time, both
+ *		record types start with it
+ ****************************************/
+static inline void *ts_at(const struct ts_log *l, uint32_t i)
+{
+	return (char *)l->data + (size_t)i * l->record_size;
+}
+
+static inline uint64_t ts_time(const void *rec)
+{
+	return __atomic_load_n((const uint64_t *)rec, __ATOMIC_ACQUIRE);
+}
+
+/*****************************************
+ * @brief	Records past count that made
+ *		it to the file, a live writer's
+ *		or a crashed one's
+ ****************************************/
+static uint32_t ts_scan_end(const void *data, uint32_t record_size,
+			    uint32_t count, uint32_t capacity)
+{
+	while (count < capacity &&
+	       ts_time((const char *)data + (size_t)count * record_size) != 0)
+		count++;
+
+	return count;
+}
+
+/*****************************************
+ * @brief	Map an open segment, checks
+ *		its header against the file
+ ****************************************/
+static void *ts_map(int fd, int prot, size_t *size)
+{
+	const struct ts_segment_header *hdr;
+	struct stat st;
+	void *map;
+
+	if (fstat(fd, &st) < 0)
+		return NULL;
+	if ((size_t)st.st_size < TS_HEADER_SIZE)
+		goto invalid;
+
+	map = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	hdr = map;
+	if (memcmp(hdr->magic, TS_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != TS_VERSION ||
+	    (hdr->record_size != sizeof(struct ts_record) &&
+	     hdr->record_size != sizeof(struct ts_rollup)) ||
+	    hdr->count > hdr->capacity ||
+	    TS_HEADER_SIZE + (size_t)hdr->capacity * hdr->record_size >
+	    (size_t)st.st_size)
+	{
+		munmap(map, st.st_size);
+		goto invalid;
+	}
+
+	*size = st.st_size;
+	return map;
+
+invalid:
+	errno = EBADMSG;
+	return NULL;
+}
+
+/*****************************************
+ * @brief	Make the next segment current,
+ *		allocated in full so appends
+ *		never extend the file
+ ****************************************/
+static int ts_log_create(struct ts_store *s, struct ts_log *l, uint64_t seq)
+{
+	char name[TS_NAME_LEN];
+	size_t size = TS_HEADER_SIZE + (size_t)l->segment_records * l->record_size;
+	void *map;
+	int ret;
+
+	snprintf(name, sizeof(name), "%08llx" TS_SUFFIX, (unsigned long long)seq);
+	l->fd = openat(l->dir_fd, name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (l->fd < 0)
+		return -1;
+
+	// unwritten extents read back as zero without writing the zeros
+	ret = posix_fallocate(l->fd, 0, size);
+	if (ret == EOPNOTSUPP || ret == EINVAL)
+		ret = ftruncate(l->fd, size) < 0 ? errno : 0;
+	if (ret)
+	{
+		errno = ret;
+		goto fail;
+	}
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, l->fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	l->hdr = map;
+	l->data = (char *)map + TS_HEADER_SIZE;
+	l->map_size = size;
+	l->count = 0;
+	l->synced = 0;
+	l->hdr->version = TS_VERSION;
+	l->hdr->record_size = l->record_size;
+	l->hdr->seq = seq;
+	l->hdr->capacity = l->segment_records;
+	// the magic last, a reader ignores the file until then
+	memcpy(l->hdr->magic, TS_MAGIC, sizeof(l->hdr->magic));
+	s->stats.segments++;
+	return 0;
+
+fail:
+	ret = errno;
+	close(l->fd);
+	l->fd = -1;
+	unlinkat(l->dir_fd, name, 0);
+	errno = ret;
+	return -1;
+}
+
+/*****************************************
+ * @brief	Continue an unsealed segment
+ *		left by an earlier run
+ ****************************************/
+static int ts_log_resume(struct ts_log *l, uint64_t seq)
+{
+	char name[TS_NAME_LEN];
+	struct ts_segment_header *hdr;
+
+	snprintf(name, sizeof(name), "%08llx" TS_SUFFIX, (unsigned long long)seq);
+	l->fd = openat(l->dir_fd, name, O_RDWR | O_CLOEXEC);
+	if (l->fd < 0)
+		return -1;
+	hdr = ts_map(l->fd, PROT_READ | PROT_WRITE, &l->map_size);
+	if (hdr == NULL || hdr->sealed || hdr->record_size != l->record_size)
+	{
+		if (hdr)
+			munmap(hdr, l->map_size);
+		close(l->fd);
+		l->fd = -1;
+		return -1;
+	}
+
+	l->hdr = hdr;
+	l->data = (char *)hdr + TS_HEADER_SIZE;
+	l->count = ts_scan_end(l->data, l->record_size, hdr->count, hdr->capacity);
+	l->synced = hdr->count;
+	return 0;
+}
+
+/*****************************************
+ * @brief	Delete the oldest segments
+ *		beyond the retention cap
+ ****************************************/
+static void ts_log_retain(struct ts_store *s, struct ts_log *l)
+{
+	char name[TS_NAME_LEN];
+	uint64_t *seqs;
+	size_t n;
+
+	if (l->keep == 0 || ts_list_fd(l->dir_fd, &seqs, &n) < 0)
+		return;
+
+	for (size_t i = 0; i + l->keep < n; i++)
+	{
+		if (seqs[i] == l->hdr->seq)
+			continue;
+		snprintf(name, sizeof(name), "%08llx" TS_SUFFIX,
+			 (unsigned long long)seqs[i]);
+		if (unlinkat(l->dir_fd, name, 0) == 0)
+			s->stats.removed++;
+	}
+	free(seqs);
+}
+
+/*****************************************
+ * @brief	Open one level's directory
+ *		and its newest segment
+ ****************************************/
+static int ts_log_open(struct ts_store *s, unsigned int level)
+{
+	struct ts_log *l = &s->log[level];
+	uint64_t *seqs, next = 0;
+	size_t n;
+	int ret;
+
+	if (level == TS_LEVEL_RAW)
+	{
+		if (mkdir(s->cfg.dir, 0755) < 0 && errno != EEXIST)
+			return -1;
+		l->dir_fd = open(s->cfg.dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		l->record_size = sizeof(struct ts_record);
+		l->segment_records = s->cfg.segment_records;
+		l->keep = s->cfg.keep;
+	}
+	else
+	{
+		int dir_fd = s->log[TS_LEVEL_RAW].dir_fd;
+
+		if (mkdirat(dir_fd, ts_level_name[level], 0755) < 0 && errno != EEXIST)
+			return -1;
+		l->dir_fd = openat(dir_fd, ts_level_name[level],
+				   O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		l->record_size = sizeof(struct ts_rollup);
+		l->segment_records = s->cfg.rollup_records;
+		l->keep = s->cfg.rollup_keep;
+	}
+	if (l->dir_fd < 0 || ts_list_fd(l->dir_fd, &seqs, &n) < 0)
+		return -1;
+
+	// pick up where the newest segment ended, else start a new one
+	if (n)
+		next = seqs[n - 1] + 1;
+	ret = n ? ts_log_resume(l, seqs[n - 1]) : -1;
+	free(seqs);
+	if (ret < 0 && ts_log_create(s, l, next) < 0)
+		return -1;
+
+	ts_log_retain(s, l);
+	return 0;
+}
+
+/*****************************************
+ * @brief	Publish the records written
+ *		so far in the header, with
+ *		sync also wait for the disk
+ ****************************************/
+static int ts_log_flush(struct ts_log *l, int sync)
+{
+	struct ts_segment_header *h = l->hdr;
+	long page = sysconf(_SC_PAGESIZE);
+	size_t from, to;
+
+	if (l->count)
+	{
+		h->first_us = ts_time(ts_at(l, 0));
+		h->last_us = ts_time(ts_at(l, l->count - 1));
+	}
+	__atomic_store_n(&h->count, l->count, __ATOMIC_RELEASE);
+
+	if (!sync)
+		return 0;
+
+	// only the pages written since the last sync, and the header
+	from = (TS_HEADER_SIZE + (size_t)l->synced * l->record_size) &
+	       ~(size_t)(page - 1);
+	to = TS_HEADER_SIZE + (size_t)l->count * l->record_size;
+	l->synced = l->count;
+	if (to > from && msync((char *)h + from, to - from, MS_SYNC) < 0)
+		return -1;
+	if (from && msync(h, page, MS_SYNC) < 0)
+		return -1;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Unmap a level's segment
+ ****************************************/
+static void ts_log_close(struct ts_log *l)
+{
+	if (l->hdr)
+		munmap(l->hdr, l->map_size);
+	if (l->fd >= 0)
+		close(l->fd);
+	if (l->dir_fd >= 0)
+		close(l->dir_fd);
+	l->hdr = NULL;
+	l->fd = -1;
+	l->dir_fd = -1;
+}
+
+/*****************************************
+ * @brief	Seal a level's full segment
+ *		and move on to the next one,
+ *		after a failed create only
+ *		retry it
+ ****************************************/
+int ts_store_rotate(struct ts_store *s, unsigned int level)
+{
+	struct ts_log *l = &s->log[level];
+	int ret = 0;
+
+	if (l->hdr)
+	{
+		l->next_seq = l->hdr->seq + 1;
+		l->hdr->sealed = 1;
+		ret = ts_log_flush(l, s->cfg.sync);
+		munmap(l->hdr, l->map_size);
+		close(l->fd);
+		l->hdr = NULL;
+		l->data = NULL;
+		l->fd = -1;
+	}
+
+	// ENOSPC, EMFILE: hdr stays NULL and the next append tries again
+	if (ts_log_create(s, l, l->next_seq) < 0)
+		return -1;
+	ts_log_retain(s, l);
+
+	return ret;
+}
+
+/*****************************************
+ * @brief	Open buckets of a series and
+ *		kind, NULL once TS_TRACKS are
+ *		in use
+ ****************************************/
+struct ts_track *ts_store_track(struct ts_store *s, uint16_t series, uint16_t kind)
+{
+	struct ts_track *t;
+
+	for (unsigned int i = 0; i < s->tracks; i++)
+	{
+		if (s->track[i].series == series && s->track[i].kind == kind)
+		{
+			s->last_track = i;
+			return &s->track[i];
+		}
+	}
+	if (s->tracks == TS_TRACKS)
+		return NULL;
+
+	t = &s->track[s->tracks];
+	memset(t, 0, sizeof(*t));
+	t->series = series;
+	t->kind = kind;
+	s->last_track = s->tracks++;
+	return t;
+}
+
+/*****************************************
+ * @brief	Write the open bucket of a
+ *		level and fold it into the
+ *		next coarser one
+ ****************************************/
+static int ts_store_roll(struct ts_store *s, struct ts_track *t, unsigned int level)
+{
+	struct ts_rollup *b = &t->open[level];
+	struct ts_log *l = &s->log[level];
+	struct ts_rollup *r;
+	int ret = 0;
+
+	if (b->count == 0)
+		return 0;
+
+	if ((l->hdr == NULL || l->count == l->hdr->capacity) &&
+	    ts_store_rotate(s, level) < 0)
+	{
+		ret = -1;
+	}
+	else
+	{
+		r = ts_at(l, l->count++);
+		r->series = t->series;
+		r->kind = t->kind;
+		r->count = b->count;
+		r->min = b->min;
+		r->max = b->max;
+		r->sum = b->sum;
+		__atomic_store_n(&r->start_us, b->start_us, __ATOMIC_RELEASE);
+		s->stats.rollups++;
+	}
+
+	if (level + 1 < TS_LEVELS)
+		ret |= ts_store_fold(s, t, level + 1, b);
+	memset(b, 0, sizeof(*b));
+	return ret;
+}
+
+/*****************************************
+ * @brief	Add src to the open bucket of
+ *		a level, first writing that
+ *		bucket if src starts another
+ ****************************************/
+int ts_store_fold(struct ts_store *s, struct ts_track *t, unsigned int level,
+		  const struct ts_rollup *src)
+{
+	struct ts_rollup *b = &t->open[level];
+	uint64_t res = ts_level_us[level];
+	int ret = 0;
+
+	// an earlier time than the bucket also starts a new one
+	if (b->count && src->start_us - b->start_us >= res)
+		ret = ts_store_roll(s, t, level);
+	if (b->count == 0)
+		b->start_us = src->start_us - src->start_us % res;
+	ts_rollup_merge(b, src);
+
+	return ret;
+}
+
+// how many finer records a level already holds of a series and kind
+struct ts_done {
+	uint16_t series;
+	uint16_t kind;
+	uint64_t count;
+};
+
+/*****************************************
+ * @brief	Add up, per series and kind,
+ *		the buckets starting at from_us
+ *		or later, newest first. Returns
+ *		1 once no older record can
+ *		start that late
+ ****************************************/
+static int ts_recover_count(const struct ts_rollup *roll, uint32_t count,
+			    uint64_t from_us, uint64_t slack,
+			    struct ts_done *done, unsigned int *n)
+{
+	unsigned int j;
+
+	for (uint32_t i = count; i-- > 0; )
+	{
+		const struct ts_rollup *r = &roll[i];
+
+		// a bucket is written at most slack after its start
+		if (r->start_us + slack < from_us)
+			return 1;
+		if (r->start_us < from_us)
+			continue;
+		for (j = 0; j < *n; j++)
+			if (done[j].series == r->series && done[j].kind == r->kind)
+				break;
+		if (j == *n)
+		{
+			if (*n == TS_TRACKS)
+				continue;
+			done[j].series = r->series;
+			done[j].kind = r->kind;
+			done[j].count = 0;
+			(*n)++;
+		}
+		done[j].count += r->count;
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Rebuild the open buckets of a
+ *		level from the finer records
+ *		its written buckets lack.
+ *
+ *		A level receives the finer
+ *		records of a series in the
+ *		order they were written and
+ *		writes its buckets in order, so
+ *		what it holds is a prefix of
+ *		them. Counting the samples in
+ *		its buckets from a bucket
+ *		boundary on tells how many of
+ *		the finer records from there
+ *		to skip, whichever run wrote
+ *		them and however many partial
+ *		buckets a period has.
+ ****************************************/
+static int ts_store_recover(struct ts_store *s, unsigned int level)
+{
+	const struct ts_log *dst = &s->log[level], *src = &s->log[level - 1];
+	uint64_t res = ts_level_us[level];
+	uint64_t slack = res + TS_ROLLUP_GRACE_US + s->cfg.flush_ms * 1000ULL;
+	struct ts_done done[TS_TRACKS];
+	unsigned int n = 0, j;
+	uint64_t first, last, from;
+	struct ts_rollup one;
+	struct ts_track *t;
+	uint32_t i;
+	int ret = 0;
+
+	if (src->count == 0)
+		return 0;
+
+	// a bucket still open at the crash started after a flush closed
+	// everything older, the finer records before from are all rolled
+	first = ts_time(ts_at(src, 0));
+	last = ts_time(ts_at(src, src->count - 1));
+	from = last > slack ? last - slack : 0;
+	from -= from % res;
+	// a bucket before the first boundary in this segment may also hold
+	// records of the previous one, count from there on
+	if (from < first && src->hdr->seq > 0)
+		from = first + (res - first % res) % res;
+
+	// the newest segment may hold none of those buckets yet, after a
+	// crash right behind a rotate, the rest are in the one before
+	if (!ts_recover_count(dst->data, dst->count, from, slack, done, &n) &&
+	    dst->hdr->seq > 0)
+	{
+		char dir[TS_PATH_LEN];
+		struct ts_segment prev;
+
+		snprintf(dir, sizeof(dir), "%s/%s", s->cfg.dir, ts_level_name[level]);
+		if (ts_segment_open(&prev, dir, dst->hdr->seq - 1) == 0)
+		{
+			if (prev.roll)
+				ts_recover_count(prev.roll, prev.count, from, slack,
+						 done, &n);
+			ts_segment_close(&prev);
+		}
+	}
+
+	// back to the first finer record that can be from or later
+	for (i = src->count; i > 0 && ts_time(ts_at(src, i - 1)) + slack >= from; i--)
+		;
+
+	for (; i < src->count; i++)
+	{
+		if (level == TS_LEVEL_1S)
+		{
+			const struct ts_record *r = ts_at(src, i);
+
+			one.start_us = r->time_us;
+			one.series = r->series;
+			one.kind = r->kind;
+			one.count = 1;
+			one.min = one.max = r->value;
+			one.sum = r->value;
+		}
+		else
+		{
+			one = *(const struct ts_rollup *)ts_at(src, i);
+		}
+		if (one.start_us < from)
+			continue;
+
+		// already in the level's buckets
+		for (j = 0; j < n; j++)
+			if (done[j].series == one.series && done[j].kind == one.kind)
+				break;
+		if (j < n && done[j].count >= one.count)
+		{
+			done[j].count -= one.count;
+			continue;
+		}
+		t = ts_store_track(s, one.series, one.kind);
+		if (t)
+			ret |= ts_store_fold(s, t, level, &one);
+	}
+
+	return ret;
+}
+
+/*****************************************
+ * @brief	Open cfg->dir for appending,
+ *		creating it if needed
+ ****************************************/
+int ts_store_open(struct ts_store *s, const struct ts_store_config *cfg)
+{
+	unsigned int levels = cfg->rollups ? TS_LEVELS : TS_LEVEL_RAW + 1;
+	int ret;
+
+	memset(s, 0, sizeof(*s));
+	s->cfg = *cfg;
+	for (unsigned int l = 0; l < TS_LEVELS; l++)
+	{
+		s->log[l].fd = -1;
+		s->log[l].dir_fd = -1;
+	}
+
+	for (unsigned int l = 0; l < levels; l++)
+		if (ts_log_open(s, l) < 0)
+			goto fail;
+
+	// coarsest first, what is rebuilt below rolls up into it
+	for (unsigned int l = levels - 1; l > TS_LEVEL_RAW; l--)
+		if (ts_store_recover(s, l) < 0)
+			goto fail;
+
+	return 0;
+
+fail:
+	ret = errno;
+	for (unsigned int l = 0; l < TS_LEVELS; l++)
+		ts_log_close(&s->log[l]);
+	errno = ret;
+	return -1;
+}
+
+/*****************************************
+ * @brief	Write buckets whose period is
+ *		over, then publish what every
+ *		level has in its header
+ ****************************************/
+int ts_store_flush(struct ts_store *s)
+{
+	struct ts_log *raw = &s->log[TS_LEVEL_RAW];
+	uint64_t now = raw->count ? ts_time(ts_at(raw, raw->count - 1)) : 0;
+	int ret = 0;
+
+	if (s->cfg.rollups)
+	{
+		for (unsigned int i = 0; i < s->tracks; i++)
+		{
+			for (unsigned int l = TS_LEVEL_1S; l < TS_LEVELS; l++)
+			{
+				struct ts_rollup *b = &s->track[i].open[l];
+
+				if (b->count &&
+				    now >= b->start_us + ts_level_us[l] + TS_ROLLUP_GRACE_US)
+					ret |= ts_store_roll(s, &s->track[i], l);
+			}
+		}
+	}
+
+	for (unsigned int l = 0; l < TS_LEVELS; l++)
+		if (s->log[l].hdr && ts_log_flush(&s->log[l], s->cfg.sync) < 0)
+			ret = -1;
+	s->next_flush_us = now + s->cfg.flush_ms * 1000ULL;
+	s->stats.flushes++;
+
+	return ret;
+}
+
+/*****************************************
+ * @brief	Write the open buckets, flush
+ *		and unmap, the segments stay
+ *		open for the next run
+ ****************************************/
+void ts_store_close(struct ts_store *s)
+{
+	if (s->cfg.rollups)
+		for (unsigned int i = 0; i < s->tracks; i++)
+			for (unsigned int l = TS_LEVEL_1S; l < TS_LEVELS; l++)
+				ts_store_roll(s, &s->track[i], l);
+
+	for (unsigned int l = 0; l < TS_LEVELS; l++)
+	{
+		if (s->log[l].hdr)
+			ts_log_flush(&s->log[l], s->cfg.sync);
+		ts_log_close(&s->log[l]);
+	}
+}
+
+/*****************************************
+ * @brief	Print the store counters
+ ****************************************/
+void ts_store_print_stats(const struct ts_store *s, const char *name)
+{
+	printf("%s: %llu records, %llu rollups, %llu segments, %llu flushes, "
+	       "%llu removed, %llu not rolled up\n",
+	       name,
+	       (unsigned long long)s->stats.records,
+	       (unsigned long long)s->stats.rollups,
+	       (unsigned long long)s->stats.segments,
+	       (unsigned long long)s->stats.flushes,
+	       (unsigned long long)s->stats.removed,
+	       (unsigned long long)s->stats.untracked);
+}
+
+/*****************************************
+ * @brief	Map segment seq of dir for
+ *		reading, records in place
+ ****************************************/
+int ts_segment_open(struct ts_segment *seg, const char *dir, uint64_t seq)
+{
+	char path[TS_PATH_LEN];
+	const struct ts_segment_header *hdr;
+	const void *data;
+	int ret;
+
+	memset(seg, 0, sizeof(*seg));
+	snprintf(path, sizeof(path), "%s/%08llx" TS_SUFFIX, dir,
+		 (unsigned long long)seq);
+	seg->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (seg->fd < 0)
+		return -1;
+	hdr = ts_map(seg->fd, PROT_READ, &seg->map_size);
+	if (hdr == NULL)
+	{
+		ret = errno;
+		close(seg->fd);
+		seg->fd = -1;
+		errno = ret;
+		return -1;
+	}
+
+	seg->hdr = hdr;
+	data = (const char *)hdr + TS_HEADER_SIZE;
+	if (hdr->record_size == sizeof(struct ts_record))
+		seg->rec = data;
+	else
+		seg->roll = data;
+	seg->count = hdr->sealed ? hdr->count :
+		     ts_scan_end(data, hdr->record_size, hdr->count, hdr->capacity);
+	return 0;
+}
+
+/*****************************************
+ * @brief	Unmap a segment
+ ****************************************/
+void ts_segment_close(struct ts_segment *seg)
+{
+	if (seg->hdr)
+		munmap((void *)seg->hdr, seg->map_size);
+	if (seg->fd >= 0)
+		close(seg->fd);
+	seg->hdr = NULL;
+	seg->fd = -1;
+}
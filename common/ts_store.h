@@ -0,0 +1,284 @@
+/***********************************************************************
+ * @file      		ts_store.h
+ * @version   		0.1
+ * @brief		append-only memory mapped time-series store
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * A store is a directory of segment files, NNNNNNNN.tss, each a 64 byte
+ * header followed by fixed size 16 byte records. Segments are allocated
+ * at full size up front and written through a shared mapping, so an
+ * append is a store to memory. The kernel writes the pages back in
+ * order, each one about once. The header's record count only moves on
+ * a flush, which happens every flush_ms of sample time, optionally with
+ * msync(MS_SYNC) for durability. After a crash the writer finds the
+ * real end by looking for the first unwritten (zero time) record. When
+ * a segment is full it is sealed and the next one is started. Only the
+ * newest keep segments are kept.
+ *
+ * Every record is also folded into a min/max/sum/count rollup of its
+ * series and kind for the current second. A closed second is written
+ * to the 1s/ subdirectory and folded into the current minute, a closed
+ * minute goes to 1m/ and into the current hour, and hours go to 1h/.
+ * These are segments just like the raw ones, with 32 byte records and
+ * their own size and retention, so they outlive the raw samples. A
+ * bucket closes when a later record of its series and kind starts the
+ * next one, or at a flush once its period has been over for a second.
+ * Buckets still open are written at close, and rebuilt from the finer
+ * level after a crash. Either can leave two records for one bucket,
+ * readers merge them.
+ *
+ * Readers map segments read-only and use the records in place, there
+ * is nothing to parse. A store has one writer, readers may come and go
+ * while it runs.
+ *
+ *   dir[:key=value,...]
+ *   seg=16       segment size, MiB
+ *   keep=16      segments kept, 0 keeps everything
+ *   flush=1000   mS of sample time between header updates
+ *   sync=0       1: msync(MS_SYNC) on every flush
+ *   roll=1       0: no rollups
+ *   rseg=4       rollup segment size, MiB
+ *   rkeep=64     rollup segments kept per resolution, 0 keeps everything
+ *
+ ************************************************************************/
+#ifndef TS_STORE_H
+#define TS_STORE_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/**************************** Defines  **********************************/
+#define TS_MAGIC		"TSSEG01"
+#define TS_VERSION		(1)
+#define TS_HEADER_SIZE		(64)
+#define TS_SEGMENT_MB		(16)	// about 35 min of one 500 Hz channel
+#define TS_KEEP_SEGMENTS	(16)
+#define TS_FLUSH_MS		(1000)
+#define TS_SUFFIX		".tss"
+#define TS_ROLLUP_MB		(4)	// 1s: about 6 hours of 6 series
+#define TS_ROLLUP_KEEP		(64)
+#define TS_ROLLUP_GRACE_US	(1000000ULL)	// lateness before a flush closes a bucket
+#define TS_TRACKS		(64)	// series x kind pairs rolled up
+#define TS_SECOND_US		(1000000ULL)
+
+// record kinds, what value holds
+enum ts_kind {
+	TS_KIND_PULSE_SAMPLE = 1,	// raw 10-bit ADC counts, series = channel
+	TS_KIND_PULSE_IBI = 2,		// inter-beat interval, mS
+	TS_KIND_PULSE_BPM = 3,		// BPM after the beat
+	TS_KIND_PULSE_LOST = 4,		// signal lost, value 0
+	TS_KIND_TEMP = 16,		// celsius, series = bus << 8 | address
+};
+
+// resolutions, the raw records and three rollups
+enum ts_level {
+	TS_LEVEL_RAW,
+	TS_LEVEL_1S,
+	TS_LEVEL_1M,
+	TS_LEVEL_1H,
+	TS_LEVELS
+};
+
+/**************************** Data Types ********************************/
+struct ts_record {
+	uint64_t time_us;		// CLOCK_REALTIME, 0 marks unwritten space
+	uint16_t series;		// channel or sensor, per kind
+	uint16_t kind;			// enum ts_kind
+	float value;
+};
+
+// one bucket, series and kind where a ts_record has them
+struct ts_rollup {
+	uint64_t start_us;		// multiple of the resolution
+	uint16_t series;
+	uint16_t kind;
+	uint32_t count;
+	float min;
+	float max;
+	double sum;
+};
+
+struct ts_segment_header {
+	char magic[8];			// TS_MAGIC
+	uint32_t version;
+	uint32_t record_size;		// ts_record or ts_rollup
+	uint64_t seq;			// file name number
+	uint64_t first_us;		// time of the first record
+	uint64_t last_us;		// time of the last flushed record
+	uint32_t capacity;		// records the file has room for
+	uint32_t count;			// records flushed
+	uint32_t sealed;		// full, no more appends
+	uint8_t reserved[TS_HEADER_SIZE - 52];
+};
+
+struct ts_store_config {
+	const char *dir;
+	uint32_t segment_records;
+	unsigned int keep;		// segments, 0: no limit
+	unsigned int flush_ms;
+	int sync;
+	int rollups;
+	uint32_t rollup_records;
+	unsigned int rollup_keep;
+};
+
+struct ts_store_stats {
+	uint64_t records;		// appended
+	uint64_t rollups;		// buckets written
+	uint64_t untracked;		// records past TS_TRACKS, not rolled up
+	uint64_t flushes;
+	uint64_t segments;		// started
+	uint64_t removed;		// deleted by retention
+};
+
+// the current segment of one level
+struct ts_log {
+	int dir_fd;
+	int fd;
+	size_t map_size;
+	struct ts_segment_header *hdr;
+	void *data;
+	uint32_t record_size;
+	uint32_t segment_records;	// for new segments
+	unsigned int keep;
+	uint32_t count;			// records written to the segment
+	uint32_t synced;		// records covered by the last msync
+	uint64_t next_seq;		// of the segment a failed rotate owes
+};
+
+// open buckets of one series and kind
+struct ts_track {
+	uint16_t series;
+	uint16_t kind;
+	struct ts_rollup open[TS_LEVELS];	// [TS_LEVEL_RAW] unused
+};
+
+struct ts_store {
+	struct ts_store_config cfg;
+	struct ts_log log[TS_LEVELS];
+	struct ts_track track[TS_TRACKS];
+	unsigned int tracks;
+	unsigned int last_track;	// where the previous record went
+	uint64_t next_flush_us;
+	struct ts_store_stats stats;
+};
+
+// a segment mapped read-only
+struct ts_segment {
+	int fd;
+	size_t map_size;
+	const struct ts_segment_header *hdr;
+	const struct ts_record *rec;	// raw segment, else NULL
+	const struct ts_rollup *roll;	// rollup segment, else NULL
+	uint32_t count;			// readable records
+};
+
+/**************************** Global Variables **************************/
+extern const char *const ts_level_name[TS_LEVELS];	// subdirectory, "" for raw
+extern const uint64_t ts_level_us[TS_LEVELS];		// bucket length, 0 for raw
+
+/**************************** Function Declarations *********************/
+void ts_store_config_default(struct ts_store_config *cfg);
+int ts_store_parse(struct ts_store_config *cfg, char *spec);
+int ts_store_open(struct ts_store *s, const struct ts_store_config *cfg);
+int ts_store_rotate(struct ts_store *s, unsigned int level);
+struct ts_track *ts_store_track(struct ts_store *s, uint16_t series, uint16_t kind);
+int ts_store_fold(struct ts_store *s, struct ts_track *t, unsigned int level,
+		  const struct ts_rollup *src);
+int ts_store_flush(struct ts_store *s);
+void ts_store_close(struct ts_store *s);
+void ts_store_print_stats(const struct ts_store *s, const char *name);
+
+int ts_store_list(const char *dir, uint64_t **seqs, size_t *count);
+int ts_segment_open(struct ts_segment *seg, const char *dir, uint64_t seq);
+void ts_segment_close(struct ts_segment *seg);
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Add the values of src to dst
+ ****************************************/
+static inline void ts_rollup_merge(struct ts_rollup *dst,
+				   const struct ts_rollup *src)
+{
+	if (dst->count == 0 || src->min < dst->min)
+		dst->min = src->min;
+	if (dst->count == 0 || src->max > dst->max)
+		dst->max = src->max;
+	dst->sum += src->sum;
+	dst->count += src->count;
+}
+
+/*****************************************
+ * @brief	Append one record, time_us
+ *		also drives the flush policy
+ ****************************************/
+static inline int ts_store_append(struct ts_store *s, uint64_t time_us,
+				  uint16_t series, uint16_t kind, float value)
+{
+	struct ts_log *l = &s->log[TS_LEVEL_RAW];
+	struct ts_track *t = &s->track[s->last_track];
+	struct ts_rollup one;
+	struct ts_record *r;
+	int ret = 0;
+
+	// no segment after a failed rotate, the disk may have room again
+	if ((l->hdr == NULL || l->count == l->hdr->capacity) &&
+	    ts_store_rotate(s, TS_LEVEL_RAW) < 0)
+		return -1;
+	r = (struct ts_record *)l->data + l->count++;
+	r->series = series;
+	r->kind = kind;
+	r->value = value;
+	// time goes last, a non-zero time marks the record as written
+	time_us = time_us ? time_us : 1;
+	__atomic_store_n(&r->time_us, time_us, __ATOMIC_RELEASE);
+	s->stats.records++;
+
+	if (s->cfg.rollups)
+	{
+		if (s->last_track >= s->tracks || t->series != series || t->kind != kind)
+			t = ts_store_track(s, series, kind);
+		if (t == NULL)
+		{
+			s->stats.untracked++;
+		}
+		else
+		{
+			struct ts_rollup *b = &t->open[TS_LEVEL_1S];
+
+			// the same second, the common case, stays inline
+			if (b->count && time_us - b->start_us < TS_SECOND_US)
+			{
+				if (value < b->min)
+					b->min = value;
+				if (value > b->max)
+					b->max = value;
+				b->sum += value;
+				b->count++;
+			}
+			else
+			{
+				one.start_us = time_us;
+				one.count = 1;
+				one.min = one.max = value;
+				one.sum = value;
+				ret = ts_store_fold(s, t, TS_LEVEL_1S, &one);
+			}
+		}
+	}
+
+	if (time_us >= s->next_flush_us)
+		ret |= ts_store_flush(s);
+
+	return ret;
+}
+
+#endif /* TS_STORE_H */
@@ -0,0 +1,513 @@
+/***********************************************************************
+ * @file      		beat_detector.c
+ * @version   		0.1
+ * @brief		reentrant pulse sensor beat detector
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * The algorithm is the one getPulse() ran on globals, unchanged. Only
+ * the 10 entry IBI history differs in form: it is kept as a circular
+ * buffer with a running sum instead of being shifted and re-added on
+ * every beat, which yields the same BPM.
+ *
+ * @references
+ *
+ * https://github.com/WorldFamousElectronics/Raspberry_Pi/blob/master/
+ * PulseSensor_C_Pi/Pulse_Sensor_Timer/PulseSensor_timer.c
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <string.h>
+#include <errno.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "beat_detector.h"
+
+/**************************** Defines  **********************************/
+#define BEAT_MID_RANGE		(512)	// 1/2 the input range of 0..1023
+#define BEAT_IBI_DEFAULT	(600)	// 600ms per beat = 100 BPM
+#define BEAT_AMP_DEFAULT	(100)	// 1/10 of the input range
+#define BEAT_MIN_IBI		(250)	// avoid high frequency noise
+#define BEAT_LOST_MS		(2500)	// give up after 2.5 s without a beat
+
+/**************************** Data Types ********************************/
+typedef size_t (*beat_scan_t)(struct beat_detector *d, const int32_t *signal,
+			      const uint32_t *time_ms, size_t i, size_t n);
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Put back the start-up state,
+ *		keeping threshSetting
+ ****************************************/
+static void beat_detector_restart(struct beat_detector *d, uint32_t time_ms)
+{
+	d->thresh = d->threshSetting;
+	d->P = BEAT_MID_RANGE;
+	d->T = BEAT_MID_RANGE;
+	d->lastBeatTime = time_ms;
+	// looking for the first beat, not yet for the second in a row
+	d->firstBeat = 1;
+	d->secondBeat = 0;
+	d->BPM = 0;
+	d->IBI = BEAT_IBI_DEFAULT;
+	d->Pulse = 0;
+	d->amp = BEAT_AMP_DEFAULT;
+}
+
+/*****************************************
+ * @brief	Set up a detector, thresh_setting
+ *		seeds and resets the threshold
+ ****************************************/
+void beat_detector_init(struct beat_detector *d, int32_t thresh_setting)
+{
+	memset(d, 0, sizeof(*d));
+	d->threshSetting = thresh_setting;
+	beat_detector_restart(d, 0);
+}
+
+/*****************************************
+ * @brief	Forget all history, sample
+ *		time starts over at 0
+ ****************************************/
+void beat_detector_reset(struct beat_detector *d)
+{
+	beat_detector_init(d, d->threshSetting);
+}
+
+/*****************************************
+ * @brief	Peak/trough tracking and beat
+ *		detection for one sample taken
+ *		at time_ms, returns BEAT_EVENT_*
+ ****************************************/
+int beat_detector_step(struct beat_detector *d, int32_t signal,
+		       uint32_t time_ms)
+{
+	int events = BEAT_EVENT_NONE;
+
+	// monitor the time since the last beat to avoid noise
+	int32_t N = (int32_t)(time_ms - d->lastBeatTime);
+
+	//  find the peak and trough of the pulse wave
+	// avoid dichrotic noise by waiting 3/5 of last IBI
+	if (signal < d->thresh && N > (d->IBI / 5) * 3)
+	{
+		// T is the trough, keep track of lowest point in pulse wave
+		if (signal < d->T)
+			d->T = signal;
+	}
+	// thresh condition helps avoid noise
+	if (signal > d->thresh && signal > d->P)
+	{
+		// P is the peak
+		d->P = signal;
+	}
+
+	//  NOW IT'S TIME TO LOOK FOR THE HEART BEAT
+	// signal surges up in value every time there is a pulse
+	if (N > BEAT_MIN_IBI &&
+	    signal > d->thresh && d->Pulse == 0 && N > (d->IBI / 5) * 3)
+	{
+		// set the Pulse flag when we think there is a pulse
+		d->Pulse = 1;
+		// measure time between beats in mS
+		d->IBI = N;
+		// keep track of time for next pulse
+		d->lastBeatTime = time_ms;
+
+		// second beat: seed the history to get a realistic BPM at startup
+		if (d->secondBeat)
+		{
+			d->secondBeat = 0;
+			for (int i = 0; i < BEAT_RATE_LEN; i++)
+				d->rate[i] = d->IBI;
+			d->rateSum = BEAT_RATE_LEN * d->IBI;
+		}
+
+		// first beat: IBI value is unreliable so discard it
+		if (d->firstBeat)
+		{
+			d->firstBeat = 0;
+			d->secondBeat = 1;
+			return events;
+		}
+
+		// replace the oldest of the last 10 IBI values
+		d->rateSum += d->IBI - d->rate[d->rateIdx];
+		d->rate[d->rateIdx] = d->IBI;
+		if (++d->rateIdx == BEAT_RATE_LEN)
+			d->rateIdx = 0;
+		// how many beats can fit into a minute? that's BPM!
+		d->BPM = 60000 / (d->rateSum / BEAT_RATE_LEN);
+		events |= BEAT_EVENT_BEAT;
+	}
+
+	// when the values are going down, the beat is over
+	if (signal < d->thresh && d->Pulse == 1)
+	{
+		d->Pulse = 0;
+		// set thresh at 50% of the amplitude and start over from there
+		d->amp = d->P - d->T;
+		d->thresh = d->amp / 2 + d->T;
+		d->P = d->thresh;
+		d->T = d->thresh;
+	}
+
+	// if 2.5 seconds go by without a beat
+	if (N > BEAT_LOST_MS)
+	{
+		beat_detector_restart(d, time_ms);
+		events |= BEAT_EVENT_LOST;
+	}
+
+	return events;
+}
+
+/*****************************************
+ * @brief	Scalar scan: fold the peak and
+ *		trough tracking of samples that
+ *		cannot change the detector state
+ *		into d, stop at the first one
+ *		that can, return its index or n
+ ****************************************/
+static size_t beat_scan_scalar(struct beat_detector *d, const int32_t *signal,
+			       const uint32_t *time_ms, size_t i, size_t n)
+{
+	const int32_t thresh = d->thresh;
+	const int32_t refractory = (d->IBI / 5) * 3;
+	const int32_t beat_after = refractory > BEAT_MIN_IBI ? refractory : BEAT_MIN_IBI;
+	int32_t P = d->P, T = d->T;
+
+	for (; i < n; i++)
+	{
+		int32_t s = signal[i];
+		int32_t N = (int32_t)(time_ms[i] - d->lastBeatTime);
+
+		if (N > BEAT_LOST_MS)
+			break;
+		if (d->Pulse ? s < thresh : (s > thresh && N > beat_after))
+			break;
+		if (s < thresh && N > refractory && s < T)
+			T = s;
+		if (s > thresh && s > P)
+			P = s;
+	}
+
+	d->P = P;
+	d->T = T;
+	return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*****************************************
+ * @brief	SSE4.1 scan, 4 samples a step
+ ****************************************/
+__attribute__((target("sse4.1")))
+static size_t beat_scan_sse41(struct beat_detector *d, const int32_t *signal,
+			      const uint32_t *time_ms, size_t i, size_t n)
+{
+	const int32_t refractory = (d->IBI / 5) * 3;
+	const __m128i thresh = _mm_set1_epi32(d->thresh);
+	const __m128i last = _mm_set1_epi32(d->lastBeatTime);
+	const __m128i refr = _mm_set1_epi32(refractory);
+	const __m128i beat_after = _mm_set1_epi32(refractory > BEAT_MIN_IBI ?
+						  refractory : BEAT_MIN_IBI);
+	const __m128i lost_after = _mm_set1_epi32(BEAT_LOST_MS);
+	const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i P = _mm_set1_epi32(INT32_MIN);
+	__m128i T = _mm_set1_epi32(INT32_MAX);
+	int stop = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i *)(signal + i));
+		__m128i N = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(time_ms + i)),
+					  last);
+		__m128i above = _mm_cmpgt_epi32(s, thresh);
+		__m128i below = _mm_cmpgt_epi32(thresh, s);
+		__m128i trough = _mm_and_si128(below, _mm_cmpgt_epi32(N, refr));
+		__m128i event = d->Pulse ? below :
+				_mm_and_si128(above, _mm_cmpgt_epi32(N, beat_after));
+		int mask;
+
+		event = _mm_or_si128(event, _mm_cmpgt_epi32(N, lost_after));
+		mask = _mm_movemask_ps(_mm_castsi128_ps(event));
+		if (mask)
+		{
+			// only the lanes before the event are tracked here
+			__m128i before = _mm_cmpgt_epi32(_mm_set1_epi32(__builtin_ctz(mask)),
+							 lane);
+
+			above = _mm_and_si128(above, before);
+			trough = _mm_and_si128(trough, before);
+		}
+		P = _mm_max_epi32(P, _mm_blendv_epi8(_mm_set1_epi32(INT32_MIN), s, above));
+		T = _mm_min_epi32(T, _mm_blendv_epi8(_mm_set1_epi32(INT32_MAX), s, trough));
+		if (mask)
+		{
+			i += __builtin_ctz(mask);
+			stop = 1;
+			break;
+		}
+	}
+
+	P = _mm_max_epi32(P, _mm_shuffle_epi32(P, _MM_SHUFFLE(1, 0, 3, 2)));
+	P = _mm_max_epi32(P, _mm_shuffle_epi32(P, _MM_SHUFFLE(2, 3, 0, 1)));
+	T = _mm_min_epi32(T, _mm_shuffle_epi32(T, _MM_SHUFFLE(1, 0, 3, 2)));
+	T = _mm_min_epi32(T, _mm_shuffle_epi32(T, _MM_SHUFFLE(2, 3, 0, 1)));
+	if (_mm_cvtsi128_si32(P) > d->P)
+		d->P = _mm_cvtsi128_si32(P);
+	if (_mm_cvtsi128_si32(T) < d->T)
+		d->T = _mm_cvtsi128_si32(T);
+
+	return stop ? i : beat_scan_scalar(d, signal, time_ms, i, n);
+}
+
+/*****************************************
+ * @brief	AVX2 scan, 8 samples a step
+ ****************************************/
+__attribute__((target("avx2")))
+static size_t beat_scan_avx2(struct beat_detector *d, const int32_t *signal,
+			     const uint32_t *time_ms, size_t i, size_t n)
+{
+	const int32_t refractory = (d->IBI / 5) * 3;
+	const __m256i thresh = _mm256_set1_epi32(d->thresh);
+	const __m256i last = _mm256_set1_epi32(d->lastBeatTime);
+	const __m256i refr = _mm256_set1_epi32(refractory);
+	const __m256i beat_after = _mm256_set1_epi32(refractory > BEAT_MIN_IBI ?
+						     refractory : BEAT_MIN_IBI);
+	const __m256i lost_after = _mm256_set1_epi32(BEAT_LOST_MS);
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i P = _mm256_set1_epi32(INT32_MIN);
+	__m256i T = _mm256_set1_epi32(INT32_MAX);
+	__m128i p, t;
+	int stop = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i *)(signal + i));
+		__m256i N = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(time_ms + i)),
+					     last);
+		__m256i above = _mm256_cmpgt_epi32(s, thresh);
+		__m256i below = _mm256_cmpgt_epi32(thresh, s);
+		__m256i trough = _mm256_and_si256(below, _mm256_cmpgt_epi32(N, refr));
+		__m256i event = d->Pulse ? below :
+				_mm256_and_si256(above, _mm256_cmpgt_epi32(N, beat_after));
+		int mask;
+
+		event = _mm256_or_si256(event, _mm256_cmpgt_epi32(N, lost_after));
+		mask = _mm256_movemask_ps(_mm256_castsi256_ps(event));
+		if (mask)
+		{
+			// only the lanes before the event are tracked here
+			__m256i before = _mm256_cmpgt_epi32(_mm256_set1_epi32(__builtin_ctz(mask)),
+							    lane);
+
+			above = _mm256_and_si256(above, before);
+			trough = _mm256_and_si256(trough, before);
+		}
+		P = _mm256_max_epi32(P, _mm256_blendv_epi8(_mm256_set1_epi32(INT32_MIN), s, above));
+		T = _mm256_min_epi32(T, _mm256_blendv_epi8(_mm256_set1_epi32(INT32_MAX), s, trough));
+		if (mask)
+		{
+			i += __builtin_ctz(mask);
+			stop = 1;
+			break;
+		}
+	}
+
+	p = _mm_max_epi32(_mm256_castsi256_si128(P), _mm256_extracti128_si256(P, 1));
+	p = _mm_max_epi32(p, _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 3, 2)));
+	p = _mm_max_epi32(p, _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 3, 0, 1)));
+	t = _mm_min_epi32(_mm256_castsi256_si128(T), _mm256_extracti128_si256(T, 1));
+	t = _mm_min_epi32(t, _mm_shuffle_epi32(t, _MM_SHUFFLE(1, 0, 3, 2)));
+	t = _mm_min_epi32(t, _mm_shuffle_epi32(t, _MM_SHUFFLE(2, 3, 0, 1)));
+	if (_mm_cvtsi128_si32(p) > d->P)
+		d->P = _mm_cvtsi128_si32(p);
+	if (_mm_cvtsi128_si32(t) < d->T)
+		d->T = _mm_cvtsi128_si32(t);
+
+	return stop ? i : beat_scan_scalar(d, signal, time_ms, i, n);
+}
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+/*****************************************
+ * @brief	NEON scan, 4 samples a step
+ ****************************************/
+static size_t beat_scan_neon(struct beat_detector *d, const int32_t *signal,
+			     const uint32_t *time_ms, size_t i, size_t n)
+{
+	const int32_t refractory = (d->IBI / 5) * 3;
+	const int32x4_t thresh = vdupq_n_s32(d->thresh);
+	const uint32x4_t last = vdupq_n_u32(d->lastBeatTime);
+	const int32x4_t refr = vdupq_n_s32(refractory);
+	const int32x4_t beat_after = vdupq_n_s32(refractory > BEAT_MIN_IBI ?
+						 refractory : BEAT_MIN_IBI);
+	const int32x4_t lost_after = vdupq_n_s32(BEAT_LOST_MS);
+	const int32x4_t lane = { 0, 1, 2, 3 };
+	int32x4_t P = vdupq_n_s32(INT32_MIN);
+	int32x4_t T = vdupq_n_s32(INT32_MAX);
+	int stop = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		int32x4_t s = vld1q_s32(signal + i);
+		int32x4_t N = vreinterpretq_s32_u32(vsubq_u32(vld1q_u32(time_ms + i), last));
+		uint32x4_t above = vcgtq_s32(s, thresh);
+		uint32x4_t below = vcltq_s32(s, thresh);
+		uint32x4_t trough = vandq_u32(below, vcgtq_s32(N, refr));
+		uint32x4_t event = d->Pulse ? below :
+				   vandq_u32(above, vcgtq_s32(N, beat_after));
+
+		event = vorrq_u32(event, vcgtq_s32(N, lost_after));
+		if (vmaxvq_u32(event))
+		{
+			int first = 0;
+
+			while (vgetq_lane_u32(event, 0) == 0)
+			{
+				event = vextq_u32(event, event, 1);
+				first++;
+			}
+			// only the lanes before the event are tracked here
+			uint32x4_t before = vcltq_s32(lane, vdupq_n_s32(first));
+
+			above = vandq_u32(above, before);
+			trough = vandq_u32(trough, before);
+			i += first;
+			stop = 1;
+		}
+		P = vmaxq_s32(P, vbslq_s32(above, s, vdupq_n_s32(INT32_MIN)));
+		T = vminq_s32(T, vbslq_s32(trough, s, vdupq_n_s32(INT32_MAX)));
+		if (stop)
+			break;
+	}
+
+	if (vmaxvq_s32(P) > d->P)
+		d->P = vmaxvq_s32(P);
+	if (vminvq_s32(T) < d->T)
+		d->T = vminvq_s32(T);
+
+	return stop ? i : beat_scan_scalar(d, signal, time_ms, i, n);
+}
+#endif
+
+/**************************** Global Variables **************************/
+static const struct beat_kernel {
+	const char *name;
+	beat_scan_t scan;
+} beat_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+	{ "avx2", beat_scan_avx2 },
+	{ "sse4.1", beat_scan_sse41 },
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+	{ "neon", beat_scan_neon },
+#endif
+	{ "scalar", beat_scan_scalar },
+};
+
+static const struct beat_kernel *beat_kernel = &beat_kernels[0];
+
+/*****************************************
+ * @brief	Whether this CPU can run k
+ ****************************************/
+static int beat_kernel_supported(const struct beat_kernel *k)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	// the constructor may run before libgcc's own fills in the cpu model
+	__builtin_cpu_init();
+	if (k->scan == beat_scan_avx2)
+		return __builtin_cpu_supports("avx2");
+	if (k->scan == beat_scan_sse41)
+		return __builtin_cpu_supports("sse4.1");
+#endif
+	return 1;
+}
+
+/*****************************************
+ * @brief	Pick the widest kernel this
+ *		CPU supports, before main()
+ ****************************************/
+__attribute__((constructor))
+static void beat_kernel_init(void)
+{
+	beat_detector_set_kernel(NULL);
+}
+
+/*****************************************
+ * @brief	Select a block kernel by name,
+ *		NULL or "auto" for the fastest
+ ****************************************/
+int beat_detector_set_kernel(const char *name)
+{
+	int automatic = name == NULL || strcmp(name, "auto") == 0;
+
+	for (size_t k = 0; k < sizeof(beat_kernels) / sizeof(beat_kernels[0]); k++)
+	{
+		if (!automatic && strcmp(name, beat_kernels[k].name) != 0)
+			continue;
+		if (!beat_kernel_supported(&beat_kernels[k]))
+			continue;
+		beat_kernel = &beat_kernels[k];
+		return 0;
+	}
+
+	errno = ENOTSUP;
+	return -1;
+}
+
+/*****************************************
+ * @brief	Name of the kernel in use
+ ****************************************/
+const char *beat_detector_kernel(void)
+{
+	return beat_kernel->name;
+}
+
+/*****************************************
+ * @brief	Run n samples through the
+ *		detector, events must have room
+ *		for n entries, returns how many
+ *		were filled in
+ ****************************************/
+size_t beat_detector_step_block(struct beat_detector *d,
+				const int32_t *signal, const uint32_t *time_ms,
+				size_t n, struct beat_event *events)
+{
+	beat_scan_t scan = beat_kernel->scan;
+	size_t count = 0;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		int flags;
+
+		// vector scan up to the next sample that can change state,
+		// which then goes through the reference step
+		i = scan(d, signal, time_ms, i, n);
+		if (i == n)
+			break;
+		flags = beat_detector_step(d, signal[i], time_ms[i]);
+		if (flags == BEAT_EVENT_NONE)
+			continue;
+		events[count].index = i;
+		events[count].time_ms = time_ms[i];
+		events[count].IBI = d->IBI;
+		events[count].BPM = d->BPM;
+		events[count].flags = flags;
+		count++;
+	}
+
+	return count;
+}
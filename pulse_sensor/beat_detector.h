@@ -0,0 +1,80 @@
+/***********************************************************************
+ * @file      		beat_detector.h
+ * @version   		0.1
+ * @brief		reentrant pulse sensor beat detector
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Peak/trough tracking and beat finding from the PulseSensor timer
+ * example, with all of its state in one struct so any number of
+ * detectors can run side by side. A detector has no notion of where
+ * samples come from: feed it raw 10-bit ADC values together with the
+ * sample time in mS, live or recorded, one at a time or in blocks.
+ *
+ * @references
+ *
+ * https://github.com/WorldFamousElectronics/Raspberry_Pi/blob/master/
+ * PulseSensor_C_Pi/Pulse_Sensor_Timer/PulseSensor_timer.c
+ *
+ ************************************************************************/
+#ifndef BEAT_DETECTOR_H
+#define BEAT_DETECTOR_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/**************************** Defines  **********************************/
+#define BEAT_THRESH_DEFAULT	(550)	// a little above mid range
+#define BEAT_RATE_LEN		(10)	// IBIs averaged into BPM
+
+// step results, may be combined
+#define BEAT_EVENT_NONE		(0)
+#define BEAT_EVENT_BEAT		(1 << 0)	// new IBI and BPM
+#define BEAT_EVENT_LOST		(1 << 1)	// 2.5 s without a beat, reset
+
+/**************************** Data Types ********************************/
+struct beat_detector {
+	// read or written on every sample
+	int32_t thresh;			// beat threshold
+	int32_t P;			// peak of the current wave
+	int32_t T;			// trough of the current wave
+	int32_t IBI;			// last inter-beat interval in mS
+	uint32_t lastBeatTime;		// sample time of the last beat in mS
+	int32_t BPM;			// 0 until two beats have been seen
+	int32_t amp;			// amplitude of the last wave
+	int32_t threshSetting;		// seed and reset value of thresh
+	uint8_t Pulse;			// inside a beat
+	uint8_t firstBeat;		// waiting for the first beat
+	uint8_t secondBeat;		// waiting for the second beat
+	uint8_t rateIdx;		// oldest entry of rate[]
+	// touched once per beat
+	int32_t rateSum;		// sum of rate[]
+	int32_t rate[BEAT_RATE_LEN];	// last IBIs
+};
+
+struct beat_event {
+	uint32_t index;			// sample index within the block
+	uint32_t time_ms;		// sample time
+	int32_t IBI;
+	int32_t BPM;
+	int flags;			// BEAT_EVENT_*
+};
+
+/**************************** Function Declarations *********************/
+void beat_detector_init(struct beat_detector *d, int32_t thresh_setting);
+void beat_detector_reset(struct beat_detector *d);
+int beat_detector_step(struct beat_detector *d, int32_t signal,
+		       uint32_t time_ms);
+size_t beat_detector_step_block(struct beat_detector *d,
+				const int32_t *signal, const uint32_t *time_ms,
+				size_t n, struct beat_event *events);
+int beat_detector_set_kernel(const char *name);
+const char *beat_detector_kernel(void);
+
+#endif /* BEAT_DETECTOR_H */
@@ -0,0 +1,244 @@
+/***********************************************************************
+ * @file      		hrv.c
+ * @version   		0.1
+ * @brief		incremental heart rate variability statistics
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * @references
+ *
+ * Task Force of the European Society of Cardiology and the North
+ * American Society of Pacing and Electrophysiology, "Heart rate
+ * variability: standards of measurement, physiological interpretation
+ * and clinical use", Circulation 93(5), 1996.
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "hrv.h"
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Allocate the window, returns
+ *		-1 with errno set on failure
+ ****************************************/
+int hrv_init(struct hrv *h, uint32_t window)
+{
+	memset(h, 0, sizeof(*h));
+	if (window < 2 || window > HRV_WINDOW_MAX)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	h->window = window;
+	h->ibi = calloc(window, sizeof(*h->ibi));
+	h->diff = calloc(window - 1, sizeof(*h->diff));
+	h->hist = calloc(HRV_IBI_MAX + 1, sizeof(*h->hist));
+	if (h->ibi == NULL || h->diff == NULL || h->hist == NULL)
+	{
+		hrv_free(h);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Release the window
+ ****************************************/
+void hrv_free(struct hrv *h)
+{
+	free(h->ibi);
+	free(h->diff);
+	free(h->hist);
+	h->ibi = NULL;
+	h->diff = NULL;
+	h->hist = NULL;
+}
+
+/*****************************************
+ * @brief	Empty the window
+ ****************************************/
+void hrv_reset(struct hrv *h)
+{
+	memset(h->hist, 0, (HRV_IBI_MAX + 1) * sizeof(*h->hist));
+	h->count = h->head = 0;
+	h->diffCount = h->diffHead = 0;
+	h->nn50 = 0;
+	h->last = 0;
+	h->median = 0;
+	h->below = 0;
+	h->sum = h->sumSq = h->diffSq = 0;
+	h->total = 0;
+}
+
+/*****************************************
+ * @brief	Walk the median cursor until
+ *		it holds the lower median again
+ ****************************************/
+static void hrv_median_fix(struct hrv *h)
+{
+	uint32_t k = (h->count - 1) / 2;	// rank of the lower median
+
+	while (h->below > k)
+	{
+		do
+			h->median--;
+		while (h->hist[h->median] == 0);
+		h->below -= h->hist[h->median];
+	}
+	while (h->below + h->hist[h->median] <= k)
+	{
+		h->below += h->hist[h->median];
+		do
+			h->median++;
+		while (h->hist[h->median] == 0);
+	}
+}
+
+/*****************************************
+ * @brief	Add the IBI of a new beat,
+ *		evicting the oldest
+ ****************************************/
+void hrv_add(struct hrv *h, int32_t ibi)
+{
+	uint16_t v = ibi < 1 ? 1 : ibi > HRV_IBI_MAX ? HRV_IBI_MAX : ibi;
+	uint32_t tail;
+
+	// successive difference, only between beats in one unbroken run
+	if (h->last)
+	{
+		uint16_t d = v > h->last ? v - h->last : h->last - v;
+
+		if (h->diffCount == h->window - 1)
+		{
+			uint16_t old = h->diff[h->diffHead];
+
+			h->diffSq -= (uint32_t)old * old;
+			h->nn50 -= old > HRV_NN50_MS;
+			h->diff[h->diffHead] = d;
+			if (++h->diffHead == h->window - 1)
+				h->diffHead = 0;
+		}
+		else
+		{
+			tail = h->diffHead + h->diffCount;
+			if (tail >= h->window - 1)
+				tail -= h->window - 1;
+			h->diff[tail] = d;
+			h->diffCount++;
+		}
+		h->diffSq += (uint32_t)d * d;
+		h->nn50 += d > HRV_NN50_MS;
+	}
+	h->last = v;
+	h->total++;
+
+	if (h->count == 0)
+	{
+		h->median = v;
+		h->below = 0;
+	}
+
+	// replace the oldest IBI once the window is full
+	if (h->count == h->window)
+	{
+		uint16_t old = h->ibi[h->head];
+
+		h->sum -= old;
+		h->sumSq -= (uint32_t)old * old;
+		h->hist[old]--;
+		if (old < h->median)
+			h->below--;
+		h->ibi[h->head] = v;
+		if (++h->head == h->window)
+			h->head = 0;
+	}
+	else
+	{
+		tail = h->head + h->count;
+		if (tail >= h->window)
+			tail -= h->window;
+		h->ibi[tail] = v;
+		h->count++;
+	}
+	h->sum += v;
+	h->sumSq += (uint32_t)v * v;
+	h->hist[v]++;
+	if (v < h->median)
+		h->below++;
+
+	hrv_median_fix(h);
+}
+
+/*****************************************
+ * @brief	The signal was lost, the next
+ *		IBI starts a new run of beats
+ ****************************************/
+void hrv_break(struct hrv *h)
+{
+	h->last = 0;
+}
+
+/*****************************************
+ * @brief	Current figures, returns 0 or
+ *		-1 before two IBIs are in
+ ****************************************/
+int hrv_get(const struct hrv *h, struct hrv_stats *s)
+{
+	uint64_t n = h->count;
+	uint32_t upper = h->median;
+
+	memset(s, 0, sizeof(*s));
+	if (n < 2)
+		return -1;
+
+	s->beats = n;
+	s->mean = (double)h->sum / n;
+	// n * sum(x^2) - sum(x)^2 is exact in 64 bits for any window
+	s->sdnn = sqrt((double)(n * h->sumSq - h->sum * h->sum) / (n * (n - 1)));
+	if (h->diffCount)
+	{
+		s->rmssd = sqrt((double)h->diffSq / h->diffCount);
+		s->pnn50 = 100.0 * h->nn50 / h->diffCount;
+	}
+
+	// even count: average the two middle values
+	if ((n & 1) == 0 && h->below + h->hist[upper] <= n / 2)
+	{
+		do
+			upper++;
+		while (h->hist[upper] == 0);
+	}
+	s->median = (n & 1) ? h->median : (h->median + upper) / 2.0;
+	s->medianBPM = (int32_t)(60000.0 / s->median + 0.5);
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	The MQTT payload of a set of
+ *		figures, returns its length
+ ****************************************/
+int hrv_format(const struct hrv_stats *s, char *buf, size_t len)
+{
+	int n = snprintf(buf, len,
+			 "IBI:%.0f,SDNN:%.1f,RMSSD:%.1f,pNN50:%.1f,medianBPM:%d,beats:%u",
+			 s->mean, s->sdnn, s->rmssd, s->pnn50, s->medianBPM, s->beats);
+
+	return n < (int)len ? n : (int)len - 1;
+}
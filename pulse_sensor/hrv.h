@@ -0,0 +1,76 @@
+/***********************************************************************
+ * @file      		hrv.h
+ * @version   		0.1
+ * @brief		incremental heart rate variability statistics
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Fed one inter-beat interval per detected beat, keeps the time domain
+ * HRV measures over the last window beats: mean IBI, SDNN, RMSSD, pNN50
+ * and the median IBI, from which a BPM that ignores single missed or
+ * extra beats is derived. Every update adds the new IBI and evicts the
+ * oldest from running integer sums, so the cost per beat does not grow
+ * with the window and long runs do not drift. The median is tracked on
+ * a per mS histogram of the window, its cursor only moves as far as the
+ * median itself does.
+ *
+ ************************************************************************/
+#ifndef HRV_H
+#define HRV_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/**************************** Defines  **********************************/
+#define HRV_WINDOW_DEFAULT	(60)	// beats, about a minute at rest
+#define HRV_WINDOW_MAX		(4096)
+#define HRV_IBI_MAX		(3000)	// mS, longer IBIs are clamped
+#define HRV_NN50_MS		(50)	// pNN50 difference limit
+#define HRV_MSG_LEN		(128)	// hrv_format() payload buffer
+
+/**************************** Data Types ********************************/
+struct hrv {
+	uint32_t window;		// IBIs kept
+	uint32_t count;			// IBIs in the window
+	uint32_t head;			// oldest IBI
+	uint32_t diffCount;		// successive differences in the window
+	uint32_t diffHead;		// oldest difference
+	uint32_t nn50;			// differences over HRV_NN50_MS
+	uint16_t last;			// previous IBI, 0 after a break
+	uint16_t median;		// lower median IBI
+	uint32_t below;			// IBIs shorter than median
+	uint64_t sum;			// of the IBIs
+	uint64_t sumSq;			// of the squared IBIs
+	uint64_t diffSq;		// of the squared differences
+	uint64_t total;			// IBIs ever added
+	uint16_t *ibi;			// window IBIs, circular
+	uint16_t *diff;			// window |differences|, circular
+	uint16_t *hist;			// window IBIs per mS value
+};
+
+struct hrv_stats {
+	uint32_t beats;			// IBIs the figures are taken over
+	double mean;			// mean IBI, mS
+	double sdnn;			// standard deviation of IBIs, mS
+	double rmssd;			// root mean square successive difference, mS
+	double pnn50;			// % of successive differences over 50 mS
+	double median;			// median IBI, mS
+	int32_t medianBPM;		// 60000 / median IBI
+};
+
+/**************************** Function Declarations *********************/
+int hrv_init(struct hrv *h, uint32_t window);
+void hrv_free(struct hrv *h);
+void hrv_reset(struct hrv *h);
+void hrv_add(struct hrv *h, int32_t ibi);
+void hrv_break(struct hrv *h);
+int hrv_get(const struct hrv *h, struct hrv_stats *s);
+int hrv_format(const struct hrv_stats *s, char *buf, size_t len);
+
+#endif /* HRV_H */
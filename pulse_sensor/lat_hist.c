@@ -0,0 +1,121 @@
+/***********************************************************************
+ * @file      		lat_hist.c
+ * @version   		0.1
+ * @brief		log-bucketed latency histograms
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lat_hist.h"
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Largest value that lands in
+ *		bucket b
+ ****************************************/
+static uint32_t lat_hist_upper(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < LAT_HIST_SUB)
+		return b;
+	shift = (b >> LAT_HIST_SUB_BITS) - 1;
+	return (uint32_t)((((uint64_t)LAT_HIST_SUB + (b & (LAT_HIST_SUB - 1)) + 1)
+			   << shift) - 1);
+}
+
+/*****************************************
+ * @brief	Clear a histogram
+ ****************************************/
+void lat_hist_init(struct lat_hist *h, const char *name)
+{
+	memset(h, 0, sizeof(*h));
+	h->name = name;
+}
+
+/*****************************************
+ * @brief	Copy the counters, safe while
+ *		the writer keeps recording
+ ****************************************/
+void lat_hist_snapshot(struct lat_hist *h, struct lat_hist_snap *s)
+{
+	s->n = 0;
+	for (unsigned int b = 0; b < LAT_HIST_BUCKETS; b++)
+	{
+		s->count[b] = atomic_load_explicit(&h->count[b], memory_order_relaxed);
+		s->n += s->count[b];
+	}
+	s->sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+	s->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+/*****************************************
+ * @brief	Values recorded between two
+ *		snapshots, max is bucket exact
+ ****************************************/
+void lat_hist_delta(struct lat_hist_snap *d, const struct lat_hist_snap *now,
+		    const struct lat_hist_snap *prev)
+{
+	d->n = 0;
+	d->max = 0;
+	for (unsigned int b = 0; b < LAT_HIST_BUCKETS; b++)
+	{
+		d->count[b] = now->count[b] - prev->count[b];
+		d->n += d->count[b];
+		if (d->count[b])
+			d->max = lat_hist_upper(b);
+	}
+	d->sum = now->sum - prev->sum;
+	if (d->max > now->max)
+		d->max = now->max;
+}
+
+/*****************************************
+ * @brief	Value at or below which a
+ *		fraction p of the samples fall
+ ****************************************/
+uint32_t lat_hist_percentile(const struct lat_hist_snap *s, double p)
+{
+	uint64_t rank, seen = 0;
+
+	if (s->n == 0)
+		return 0;
+	// nearest rank: the smallest value covering ceil(p * n) samples
+	rank = (uint64_t)(p * s->n);
+	if (rank < p * s->n || rank < 1)
+		rank++;
+	for (unsigned int b = 0; b < LAT_HIST_BUCKETS; b++)
+	{
+		seen += s->count[b];
+		if (seen >= rank)
+			return lat_hist_upper(b) < s->max ? lat_hist_upper(b) : s->max;
+	}
+
+	return s->max;
+}
+
+/*****************************************
+ * @brief	One line summary
+ ****************************************/
+void lat_hist_print(const char *name, const struct lat_hist_snap *s)
+{
+	printf("%-9s n %-8llu mean %6.1f p50 %6u p99 %6u p99.9 %6u max %6u uS\n",
+	       name, (unsigned long long)s->n,
+	       s->n ? (double)s->sum / s->n : 0.0,
+	       lat_hist_percentile(s, 0.50),
+	       lat_hist_percentile(s, 0.99),
+	       lat_hist_percentile(s, 0.999),
+	       s->max);
+}
@@ -0,0 +1,89 @@
+/***********************************************************************
+ * @file      		lat_hist.h
+ * @version   		0.1
+ * @brief		log-bucketed latency histograms
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Each power of two range of uS values is split into 16 linear buckets,
+ * so a reported percentile is never more than 6.25% above the true
+ * value, and values below 16 uS are exact. Recording is a handful of
+ * instructions and no locked operations: one thread records, any other
+ * thread may take snapshots for reporting at the same time.
+ *
+ ************************************************************************/
+#ifndef LAT_HIST_H
+#define LAT_HIST_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**************************** Defines  **********************************/
+#define LAT_HIST_SUB_BITS	(4)	// 16 buckets per power of two
+#define LAT_HIST_SUB		(1U << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS	((32 - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB)
+
+/**************************** Data Types ********************************/
+struct lat_hist {
+	const char *name;
+	_Atomic uint64_t count[LAT_HIST_BUCKETS];
+	_Atomic uint64_t sum;		// for the mean
+	_Atomic uint32_t max;
+};
+
+// point in time copy, also used for interval deltas
+struct lat_hist_snap {
+	uint64_t count[LAT_HIST_BUCKETS];
+	uint64_t n;
+	uint64_t sum;
+	uint32_t max;
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Bucket holding value us
+ ****************************************/
+static inline unsigned int lat_hist_bucket(uint32_t us)
+{
+	unsigned int shift;
+
+	if (us < LAT_HIST_SUB)
+		return us;
+	shift = 31 - __builtin_clz(us) - LAT_HIST_SUB_BITS;
+	return ((shift + 1) << LAT_HIST_SUB_BITS) +
+	       ((us >> shift) & (LAT_HIST_SUB - 1));
+}
+
+/*****************************************
+ * @brief	Record one value, single
+ *		writer per histogram
+ ****************************************/
+static inline void lat_hist_record(struct lat_hist *h, uint32_t us)
+{
+	_Atomic uint64_t *c = &h->count[lat_hist_bucket(us)];
+
+	atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1,
+			      memory_order_relaxed);
+	atomic_store_explicit(&h->sum,
+			      atomic_load_explicit(&h->sum, memory_order_relaxed) + us,
+			      memory_order_relaxed);
+	if (us > atomic_load_explicit(&h->max, memory_order_relaxed))
+		atomic_store_explicit(&h->max, us, memory_order_relaxed);
+}
+
+/**************************** Function Declarations *********************/
+void lat_hist_init(struct lat_hist *h, const char *name);
+void lat_hist_snapshot(struct lat_hist *h, struct lat_hist_snap *s);
+void lat_hist_delta(struct lat_hist_snap *d, const struct lat_hist_snap *now,
+		    const struct lat_hist_snap *prev);
+uint32_t lat_hist_percentile(const struct lat_hist_snap *s, double p);
+void lat_hist_print(const char *name, const struct lat_hist_snap *s);
+
+#endif /* LAT_HIST_H */
@@ -0,0 +1,116 @@
+/***********************************************************************
+ * @file      		mcp3008.c
+ * @version   		0.1
+ * @brief		MCP3008 conversions chained into one SPI message
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#include "spi_transport.h"
+#include "mcp3008.h"
+
+/**************************** Defines  **********************************/
+#define ADC_CHANNEL_0 			(0xC0)
+#define ADC_CHANNEL(ch) 		(ADC_CHANNEL_0 | ((ch) << 3))
+// 10-bit result from the receive bytes of one conversion: start bit in
+// bit 7 of tx[0] puts the null bit at rx[0] bit 1, B9 in rx[0] bit 0,
+// B8..B1 in rx[1] and B0 in rx[2] bit 7
+#define ADC_DECODE(rx) 			( (((rx)[0] & 0x01) << 9) | ((rx)[1] << 1) | ((rx)[2] >> 7) )
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Prepare the chained transfers:
+ *		scans of every selected channel,
+ *		spread over one tick unless
+ *		gap_us >= 0 sets the pause
+ ****************************************/
+int mcp3008_burst_setup(struct mcp3008_burst *b, const int *channels,
+			unsigned int num_channels, unsigned int scans,
+			unsigned int period_us, int gap_us, uint32_t speed,
+			uint8_t bits, uint16_t delay)
+{
+	unsigned int scan_us, gap, n = 0;
+
+	if (scans == 0 || num_channels == 0 ||
+	    scans * num_channels > MCP3008_MAX_XFERS)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// wire time of one 3 byte conversion and of one channel scan
+	b->xfer_us = speed ? (MCP3008_XFER_LEN * 8 * 1000000U) / speed : 0;
+	scan_us = b->xfer_us * num_channels;
+
+	if (gap_us >= 0)
+		gap = gap_us;
+	else
+		gap = (period_us / scans > scan_us) ? period_us / scans - scan_us : 0;
+	b->step_us = scan_us + gap;
+	b->count = scans * num_channels;
+
+	memset(b->tr, 0, sizeof(b->tr));
+	for (unsigned int i = 0; i < scans; i++)
+	{
+		for (unsigned int c = 0; c < num_channels; c++, n++)
+		{
+			int last = (i + 1 == scans) && (c + 1 == num_channels);
+
+			b->tx[n][0] = ADC_CHANNEL(channels[c]);
+			b->tx[n][1] = 0x00;
+			b->tx[n][2] = 0x00;	// dummy data
+
+			b->tr[n].tx_buf = (unsigned long)b->tx[n];
+			b->tr[n].rx_buf = (unsigned long)b->rx[n];
+			b->tr[n].len = MCP3008_XFER_LEN;
+			b->tr[n].speed_hz = speed;
+			b->tr[n].bits_per_word = bits;
+			// release CS between conversions so the ADC starts a new one,
+			// on the last transfer cs_change would keep CS asserted instead
+			b->tr[n].cs_change = !last;
+			// pause after a complete scan of all channels
+			if (last)
+				b->tr[n].delay_usecs = delay;
+			else if (c + 1 == num_channels)
+				b->tr[n].delay_usecs = gap;
+		}
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Run the burst, one ioctl, and
+ *		decode every conversion. On a
+ *		failed ioctl values are all -1.
+ ****************************************/
+int mcp3008_read_burst(int fd, struct mcp3008_burst *b, int32_t *values)
+{
+	int ret = spi_ioctl(fd, SPI_IOC_MESSAGE(b->count), b->tr);
+
+	if (ret < 1)
+	{
+		for (unsigned int i = 0; i < b->count; i++)
+			values[i] = -1;
+		return -1;
+	}
+
+	// unpack all conversions in one pass
+	for (unsigned int i = 0; i < b->count; i++)
+		values[i] = ADC_DECODE(b->rx[i]);
+
+	return b->count;
+}
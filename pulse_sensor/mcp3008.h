@@ -0,0 +1,52 @@
+/***********************************************************************
+ * @file      		mcp3008.h
+ * @version   		0.1
+ * @brief		MCP3008 conversions chained into one SPI message
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * A burst is scans x channels conversions in a single SPI_IOC_MESSAGE,
+ * CS released between them so the ADC starts a new one each time, and
+ * a delay after every complete scan so the scans spread over a tick.
+ *
+ * @references
+ *
+ * https://ww1.microchip.com/downloads/en/DeviceDoc/21295d.pdf
+ *
+ ************************************************************************/
+#ifndef MCP3008_H
+#define MCP3008_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <linux/types.h>
+#include <linux/spi/spidev.h>
+
+/**************************** Defines  **********************************/
+#define MCP3008_CHANNELS	(8)	// single-ended inputs
+#define MCP3008_XFER_LEN	(3)	// bytes per conversion
+#define MCP3008_MAX_XFERS	(64)	// conversions per SPI_IOC_MESSAGE
+
+/**************************** Data Types ********************************/
+struct mcp3008_burst {
+	unsigned int count;		// conversions in the message
+	unsigned int step_us;		// time between channel scans
+	unsigned int xfer_us;		// wire time of one conversion
+	struct spi_ioc_transfer tr[MCP3008_MAX_XFERS];
+	uint8_t tx[MCP3008_MAX_XFERS][MCP3008_XFER_LEN];
+	uint8_t rx[MCP3008_MAX_XFERS][MCP3008_XFER_LEN];
+};
+
+/**************************** Function Declarations *********************/
+int mcp3008_burst_setup(struct mcp3008_burst *b, const int *channels,
+			unsigned int num_channels, unsigned int scans,
+			unsigned int period_us, int gap_us, uint32_t speed,
+			uint8_t bits, uint16_t delay);
+int mcp3008_read_burst(int fd, struct mcp3008_burst *b, int32_t *values);
+
+#endif /* MCP3008_H */
@@ -29,24 +29,52 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <time.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
+#include "mqtt_client.h"
+#include "spi_transport.h"
+#include "sampler.h"
+#include "sample_ring.h"
+#include "beat_detector.h"
+#include "replay.h"
+#include "hrv.h"
+#include "mcp3008.h"
+#include "ts_store.h"
+#include "lat_hist.h"
+
 /**************************** Defines  **********************************/
 #define ARRAY_SIZE(a) 			(sizeof(a) / sizeof((a)[0]))
-#define ADC_CHANNEL_0 			(0xC0)
+#define ADC_NUM_CHANNELS 		MCP3008_CHANNELS
+#define MAX_XFERS 			MCP3008_MAX_XFERS
 
 //For BPM conversion
-#define OPT_R (10)        	// min uS allowed lag btw alarm and callback
-#define OPT_U (2000)      	// sample time uS between alarms
+#define OPT_U (2000)      	// default time uS between timer ticks
 #define TIME_OUT (30000000)    // uS time allowed without callback response
 #define SEC_TO_US(sec) ((sec)*1000000) // Convert seconds to microseconds
 #define NS_TO_US(ns)    ((ns)/1000) // Convert nanoseconds to microseconds
+#define US_TO_MS(us)    ((us)/1000) // Convert microseconds to milliseconds
+
+//For the sampler -> detector hand-off
+#define RING_SIZE (1024)		// default ring slots, 2 s at 500 Hz
+#define DRAIN_BATCH (64)		// samples taken from the ring per pass
+
+//For the latency histograms
+#define STATS_INTERVAL (10)		// default seconds between reports
+
+//For MQTT publishing
+#define MQTT_TOPIC	"sensor/pulse"	// default topic for BPM readings
+#define MQTT_MSG_LEN	(32)		// "BPM:%d" payload buffer
+#define MQTT_TOPIC_LEN	(64)		// per channel "<topic>/<ch>"
+#define MQTT_HRV_TOPIC	"/hrv"		// HRV sub-topic of each BPM topic
 
 
 /**************************** Global Variables **************************/
@@ -57,28 +85,60 @@ static uint32_t speed = 250000;
 static uint16_t delay = 0;
 int execute_test = 0;
 int spi_fd;
+static const char *replay_path;		// -f: recording to replay offline
+
+// MQTT publisher, one broker connection for the whole run
+static struct mqtt_config mqtt_cfg;
+static struct mqtt_client mqtt;
+static const char *mqtt_topic = MQTT_TOPIC;
+static int mqtt_qos = 0;
+
+// timerfd sampling thread
+static struct sampler sampler;
+static unsigned int sample_period_us = OPT_U;
+static int sampler_prio = 0;
+
+// burst acquisition, burst_count scans of every channel per tick in one ioctl
+static unsigned int burst_count = 1;
+static int burst_gap_us = -1;		// -1: spread evenly over the tick
+static struct mcp3008_burst burst;
+static uint64_t spiErrors;		// failed burst reads
 
 // VARIABLES USED TO DETERMINE SAMPLE JITTER & TIME OUT
 volatile unsigned int eventCounter, thisTime, lastTime, elapsedTime, jitter;
-volatile int sampleFlag = 0;
-volatile int sumJitter, firstTime, secondTime, duration;
-unsigned int timeOutStart, dataRequestStart, m;
-
-// VARIABLES USED TO DETERMINE BPM
-volatile int Signal;
-volatile unsigned int sampleCounter;
-volatile int threshSetting,lastBeatTime;
-volatile int thresh = 550;
-volatile int P = 512;        		// set P default
-volatile int T = 512;              	// set T default
-volatile int firstBeat = 1;        	// set these to avoid noise
-volatile int secondBeat = 0;      	// when we get the heartbeat back
-volatile int QS = 0;
-volatile int rate[10];
-volatile int BPM = 0;
-volatile int IBI = 600;    		// 600ms per beat = 100 Beats Per Minute
-volatile int Pulse = 0;
-volatile int amp = 100;            	// beat amplitude 1/10 of input range.
+static int sample_efd = -1;		// sampler -> consumer wakeups
+static unsigned int ring_size = RING_SIZE;
+static uint64_t sampleStartUs;		// micros() when sampling started
+volatile int firstTime, secondTime, duration;
+volatile int64_t sumJitter;
+
+// latency histograms, recorded by the sampling thread
+enum { LAT_INTERVAL, LAT_JITTER, LAT_HANDLER, LAT_IOCTL, LAT_COUNT };
+static struct lat_hist lat[LAT_COUNT];
+static unsigned int stats_interval_s = STATS_INTERVAL;
+static volatile sig_atomic_t stopRequested;
+unsigned int dataRequestStart, m;
+
+static uint64_t sampleTimeUs;		// sampling clock, uS since start
+
+// VARIABLES USED TO DETERMINE BPM, one set per scanned ADC channel.
+// Only the consumer thread touches them, samples arrive through ring.
+struct pulse_channel {
+	struct sample_ring ring;	// this channel's sample stream
+	int channel;			// MCP3008 input 0..7
+	char topic[MQTT_TOPIC_LEN];
+	char hrvTopic[MQTT_TOPIC_LEN + sizeof(MQTT_HRV_TOPIC)];
+	struct beat_detector det;
+	struct hrv hrv;			// IBI statistics of this channel
+};
+static struct pulse_channel channels[ADC_NUM_CHANNELS] = { { .channel = 0 } };
+static unsigned int num_channels = 1;
+static unsigned int hrv_window = HRV_WINDOW_DEFAULT;
+
+// local history of samples and beats, -S
+static struct ts_store_config store_cfg;
+static struct ts_store store;
+static uint64_t realtimeOffsetUs;	// CLOCK_REALTIME - micros()
 
 /**************************** Function Declarations *********************/
 /* Application functions */
@@ -88,56 +148,75 @@ static void parse_opts(int argc, char *argv[]);
 
 /* SPI Functions */
 static void spi_transfer_test(int fd);
-static int pulse_read(int fd);
+static void pulse_burst_setup(unsigned int count, unsigned int period_us);
+static int pulse_read_burst(int fd, int32_t *values);
+static void parse_channels(char *list, const char *prog);
 
 /* BPM Functions */
 void get_bpm();
 uint64_t micros();
 void initPulseSensorVariables(void);
-void startTimer(int latency, unsigned int micros);
-void getPulse(int sig_num);
+static void initChannel(struct pulse_channel *pc);
+void startSampler(unsigned int period_us);
+void getPulse(void *arg, uint64_t expirations);
+static double cpuSeconds(clockid_t clk);
+static uint64_t wallMicros(void);
+static void storeBlock(const struct pulse_channel *pc,
+		       const struct pulse_sample *batch, uint32_t n,
+		       const struct beat_event *events, size_t count);
+static void replay(const char *path);
+static void printLatency(const char *title, int interval);
+static void stopHandler(int sig);
 
 /**************************** main function *****************************/
 int main(int argc, char *argv[])
 {
 	int ret = 0;
 	
+	mqtt_config_default(&mqtt_cfg);
+	mqtt_cfg.client_id = "pulse_app";
 	parse_opts(argc, argv);
 
-	spi_fd = open(device, O_RDWR);
+	if(replay_path)
+	{
+		replay(replay_path);
+		return 0;
+	}
+
+	spi_fd = spi_open(device);
 	if (spi_fd < 0)
 		pabort("can't open device");
 
 	/*
 	 * spi mode
 	 */
-	ret = ioctl(spi_fd, SPI_IOC_WR_MODE, &mode);
+	ret = spi_ioctl(spi_fd, SPI_IOC_WR_MODE, &mode);
 	if (ret == -1)
 		pabort("can't set spi mode");
 
-	ret = ioctl(spi_fd, SPI_IOC_RD_MODE, &mode);
+	ret = spi_ioctl(spi_fd, SPI_IOC_RD_MODE, &mode);
 	if (ret == -1)
 		pabort("can't get spi mode");
 
 	/*
 	 * bits per word
 	 */
-	ret = ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
+	ret = spi_ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
 	if (ret == -1)
 		pabort("can't set bits per word");
 
-	ret = ioctl(spi_fd, SPI_IOC_RD_BITS_PER_WORD, &bits);
+	ret = spi_ioctl(spi_fd, SPI_IOC_RD_BITS_PER_WORD, &bits);
 	if (ret == -1)
 		pabort("can't get bits per word");
 
 	/*
 	 * max speed hz
 	 */
-	ret = ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+	ret = spi_ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
 	if (ret == -1)
 		pabort("can't set max speed hz");
 
-	ret = ioctl(spi_fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed);
+	ret = spi_ioctl(spi_fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed);
 	if (ret == -1)
 		pabort("can't get max speed hz");
 
@@ -155,7 +234,7 @@ int main(int argc, char *argv[])
 	get_bpm();
 	
 exit:
-	close(spi_fd);
+	spi_close(spi_fd);
 	
 	printf("\n\n*** End App ***\n\n");
 
@@ -180,7 +259,8 @@ static void pabort(const char *s)
 static void print_usage(const char *prog)
 {
 	printf("Usage: %s [-DsbdlHOLC3]\n", prog);
-	puts("  -D --device   device to use (default /dev/spidev1.1)\n"
+	puts("  -D --device   device to use (default /dev/spidev0.0), \"sim[:opts]\"\n"
+	     "                for a simulated MCP3008 and pulse, see spi_sim.h\n"
 	     "  -s --speed    max speed (Hz)\n"
 	     "  -d --delay    delay (usec)\n"
 	     "  -b --bpw      bits per word \n"
@@ -190,7 +270,25 @@ static void print_usage(const char *prog)
 	     "  -L --lsb      least significant bit first\n"
 	     "  -C --cs-high  chip select active high\n"
 	     "  -3 --3wire    SI/SO signals shared\n"
-	     "  -t --test     execute spi transfer test\n");
+	     "  -t --test     execute spi transfer test\n"
+	     "  -m --mqtt     MQTT broker host[:port] (default localhost:1883)\n"
+	     "  -T --topic    MQTT topic (default " MQTT_TOPIC ")\n"
+	     "  -q --qos      MQTT QoS level 0 or 1 (default 0)\n"
+	     "  -p --period   sampling tick period (usec, default 2000)\n"
+	     "  -k --burst    scans of all channels per tick, one ioctl (default 1)\n"
+	     "  -g --gap      usec between burst scans (default: spread over tick)\n"
+	     "  -c --channels ADC channels to scan, e.g. 0,3,5 (default 0)\n"
+	     "  -r --rt-prio  SCHED_FIFO priority of the sampling thread\n"
+	     "  -B --ring     sample ring slots, power of two (default 1024)\n"
+	     "  -f --replay   run a recording (.csv or raw 16-bit) through the\n"
+	     "                detector instead of sampling, -p sets its spacing\n"
+	     "  -i --stats    seconds between latency reports, 0 only at exit\n"
+	     "                (default 10)\n"
+	     "  -K --kernel   beat detector block kernel: auto, avx2, sse4.1,\n"
+	     "                neon or scalar (default auto)\n"
+	     "  -w --hrv      beats in the HRV window (default 60)\n"
+	     "  -S --store    keep samples and beats in a time-series store,\n"
+	     "                dir[:seg=MB,keep=N,flush=ms,...], see ts_store.h\n");
 	exit(1);
 }
 
@@ -199,6 +297,7 @@ static void print_usage(const char *prog)
  ****************************************/
 static void parse_opts(int argc, char *argv[])
 {
+	ts_store_config_default(&store_cfg);
 	while (1) {
 		static const struct option lopts[] = {
 			{ "device",  1, 0, 'D' },
@@ -214,11 +313,25 @@ static void parse_opts(int argc, char *argv[])
 			{ "no-cs",   0, 0, 'N' },
 			{ "ready",   0, 0, 'R' },
 			{ "test",   0, 0, 't' },
+			{ "mqtt",    1, 0, 'm' },
+			{ "topic",   1, 0, 'T' },
+			{ "qos",     1, 0, 'q' },
+			{ "period",  1, 0, 'p' },
+			{ "rt-prio", 1, 0, 'r' },
+			{ "ring",    1, 0, 'B' },
+			{ "burst",   1, 0, 'k' },
+			{ "gap",     1, 0, 'g' },
+			{ "channels", 1, 0, 'c' },
+			{ "replay",  1, 0, 'f' },
+			{ "stats",   1, 0, 'i' },
+			{ "kernel",  1, 0, 'K' },
+			{ "hrv",     1, 0, 'w' },
+			{ "store",   1, 0, 'S' },
 			{ NULL, 0, 0, 0 },
 		};
 		int c;
 
-		c = getopt_long(argc, argv, "D:s:d:b:lHOLC3NRt", lopts, NULL);
+		c = getopt_long(argc, argv, "D:s:d:b:lHOLC3NRtm:T:q:p:r:B:k:g:c:f:i:K:w:S:", lopts, NULL);
 
 		if (c == -1)
 			break;
@@ -263,11 +376,99 @@ static void parse_opts(int argc, char *argv[])
 		case 't':
 			execute_test = 1;
 			break;
+		case 'm':
+			if (mqtt_parse_broker(&mqtt_cfg, optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'T':
+			mqtt_topic = optarg;
+			break;
+		case 'q':
+			mqtt_qos = atoi(optarg);
+			if (mqtt_qos < 0 || mqtt_qos > 1)
+				print_usage(argv[0]);
+			break;
+		case 'p':
+			sample_period_us = atoi(optarg);
+			if (sample_period_us < 100)
+				print_usage(argv[0]);
+			break;
+		case 'r':
+			sampler_prio = atoi(optarg);
+			break;
+		case 'B':
+			ring_size = atoi(optarg);
+			break;
+		case 'k':
+			burst_count = atoi(optarg);
+			if (burst_count < 1 || burst_count > MAX_XFERS)
+				print_usage(argv[0]);
+			break;
+		case 'g':
+			burst_gap_us = atoi(optarg);
+			if (burst_gap_us < 0)
+				print_usage(argv[0]);
+			break;
+		case 'c':
+			parse_channels(optarg, argv[0]);
+			break;
+		case 'f':
+			replay_path = optarg;
+			break;
+		case 'i':
+			stats_interval_s = atoi(optarg);
+			break;
+		case 'w':
+			hrv_window = atoi(optarg);
+			if (hrv_window < 2 || hrv_window > HRV_WINDOW_MAX)
+				print_usage(argv[0]);
+			break;
+		case 'S':
+			if (ts_store_parse(&store_cfg, optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'K':
+			if (beat_detector_set_kernel(optarg) < 0)
+			{
+				printf("detector kernel %s not available\n", optarg);
+				print_usage(argv[0]);
+			}
+			break;
 		default:
 			print_usage(argv[0]);
 			break;
 		}
 	}
+	
+	// every scan of every channel is one transfer of the message
+	if (burst_count * num_channels > MAX_XFERS)
+	{
+		printf("burst x channels must not exceed %d\n", MAX_XFERS);
+		print_usage(argv[0]);
+	}
+}
+
+/*****************************************
+ * @brief	To parse the channel list
+ ****************************************/
+static void parse_channels(char *list, const char *prog)
+{
+	unsigned int mask = 0;
+	char *tok, *save;
+	
+	num_channels = 0;
+	for (tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+	{
+		char *end;
+		long ch = strtol(tok, &end, 10);
+		
+		if (*end != '\0' || ch < 0 || ch >= ADC_NUM_CHANNELS || (mask & (1 << ch)))
+			print_usage(prog);
+		mask |= 1 << ch;
+		channels[num_channels++].channel = ch;
+	}
+	if (num_channels == 0)
+		print_usage(prog);
 }
 
 /*****************************************
@@ -295,7 +496,7 @@ static void spi_transfer_test(int fd)
 		.bits_per_word = bits,
 	};
 
-	ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
+	ret = spi_ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
 	if (ret < 1)
 		pabort("can't send spi message");
 
@@ -308,91 +509,218 @@ static void spi_transfer_test(int fd)
 }
 
 /*****************************************
- * @brief	SPI pulse sensor read fn
+ * @brief	Prepare the chained transfers:
+ *		count scans of every selected
+ *		channel, spread over one tick
  ****************************************/
-static int pulse_read(int fd)
+static void pulse_burst_setup(unsigned int count, unsigned int period_us)
 {
-	int ret = 0;
-	uint16_t ADC_value = 0;
-	
-	// transmit buffer
-	uint8_t data[] = {
-		ADC_CHANNEL_0,
-		0x00,
-		0x00,	// dummy data
-	};
-	// receive buffer
-	uint8_t value[ARRAY_SIZE(data)] = {0, };
-	
-	// SPI Transfer data struct
-	struct spi_ioc_transfer tr = {
-		.tx_buf = (unsigned long)data,
-		.rx_buf = (unsigned long)value,
-		.len = ARRAY_SIZE(data),
-		.delay_usecs = delay,
-		.speed_hz = speed,
-		.bits_per_word = bits,
-	};
+	int list[ADC_NUM_CHANNELS];
 	
-	ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
-	if (ret < 1)
-	{
-		printf("can't send spi message\n");
-		return -1;
-	}
+	for (unsigned int c = 0; c < num_channels; c++)
+		list[c] = channels[c].channel;
+	if (mcp3008_burst_setup(&burst, list, num_channels, count, period_us,
+				burst_gap_us, speed, bits, delay) < 0)
+		pabort("can't set up the ADC burst");
+}
+
+/*****************************************
+ * @brief	SPI pulse sensor read fn, one
+ *		ioctl for a burst of conversions
+ ****************************************/
+static int pulse_read_burst(int fd, int32_t *values)
+{
+	int ret = mcp3008_read_burst(fd, &burst, values);
 	
-	ADC_value = ( ((value[0] & 0x07) << 7) | (value[1] & 0xFE) );
-	//printf("ADC Read Value %d\n\n", ADC_value);
+	// a dead bus fails every tick, counted and reported once
+	if (ret < 0 && spiErrors++ == 0)
+		perror("can't send spi message");
 	
-	return ADC_value;	
+	return ret;
 }
 
 
 void get_bpm()
 {
 	int ret;
-	// to store MQTT command format
-	char BPM_MQTT_cmd[256];
+	// to store MQTT message payload
+	char BPM_MQTT_msg[MQTT_MSG_LEN];
+	char HRV_MQTT_msg[HRV_MSG_LEN];
+	struct hrv_stats hrv;
+	
+	// connect once, the client reconnects on its own if the broker drops
+	if (mqtt_client_init(&mqtt, &mqtt_cfg) < 0)
+		pabort("can't set up mqtt client");
+	if (!mqtt_client_connected(&mqtt))
+		printf("MQTT broker %s:%u not reachable, will retry\n",
+		       mqtt_cfg.host, mqtt_cfg.port);
+	if (store_cfg.dir && ts_store_open(&store, &store_cfg) < 0)
+		pabort(store_cfg.dir);
+	
 	// initilaize Pulse Sensor beat finder
 	initPulseSensorVariables();
+	
+	// Ctrl-C ends the loop below so the exit reports still get printed
+	struct sigaction sa = { .sa_handler = stopHandler };
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	
 	// start sampling
-	startTimer(OPT_R, OPT_U);
+	startSampler(sample_period_us);
 	
-	while(1)
+	// baseline for the CPU usage report
+	double wallStart = cpuSeconds(CLOCK_MONOTONIC);
+	double procStart = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+	double selfStart = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+	double nextStats = wallStart + stats_interval_s;
+	struct pollfd pfd = { .fd = sample_efd, .events = POLLIN };
+	struct pulse_sample batch[DRAIN_BATCH];
+	int32_t signal[DRAIN_BATCH];
+	uint32_t sampleMs[DRAIN_BATCH];
+	struct beat_event events[DRAIN_BATCH];
+	uint32_t n;
+	size_t count;
+	int newBeats;
+	uint64_t samples;
+	
+	while(!stopRequested)
     	{
-        	if(sampleFlag)
+    		// sleep until the sampler posts, or give up after TIME_OUT
+    		ret = poll(&pfd, 1, US_TO_MS(TIME_OUT));
+    		if(ret < 0)
+    		{
+    			if(errno == EINTR)
+    				continue;
+    			perror("poll");
+    			break;
+    		}
+         	if(ret == 0)
+         	{
+         		printf("Program timed out\n");
+            		break;
+        	}
+        	// counter holds the number of samples since the last wakeup
+        	if(read(sample_efd, &samples, sizeof(samples)) != sizeof(samples))
+        		continue;
+        	
+        	for(unsigned int c = 0; c < num_channels; c++)
         	{
-            		sampleFlag = 0;
-            		timeOutStart = micros();
-            		
-            		// PRINT DATA TO TERMINAL
-            		printf("BPM: %d\n", BPM);
-            		
-            		// resting heart rate range
-            		if(BPM >=60 && BPM <= 100)
-            		{
-			    	//command to execute for sending BPM data to server
-			    	snprintf(BPM_MQTT_cmd, sizeof(BPM_MQTT_cmd), "python3 /bin/MQTT/client.py BPM:%d",BPM);
-
-			    	//Execute the command to send data
-			    	ret = system(BPM_MQTT_cmd);
-
-			    	if(ret)
+        		struct pulse_channel *pc = &channels[c];
+        		
+	        	// run the detector over everything queued since last time
+	        	newBeats = 0;
+	        	while((n = sample_ring_pop_batch(&pc->ring, batch, DRAIN_BATCH)) > 0)
+	        	{
+	        		for(uint32_t i = 0; i < n; i++)
+	        		{
+	        			signal[i] = batch[i].value;
+	        			sampleMs[i] = US_TO_MS(batch[i].timestamp_us - sampleStartUs);
+	        		}
+	        		count = beat_detector_step_block(&pc->det, signal, sampleMs, n, events);
+	        		if(store_cfg.dir)
+	        			storeBlock(pc, batch, n, events, count);
+	        		
+	        		// every new IBI goes into the HRV window
+	        		for(size_t e = 0; e < count; e++)
+	        		{
+	        			if(events[e].flags & BEAT_EVENT_BEAT)
+	        			{
+	        				hrv_add(&pc->hrv, events[e].IBI);
+	        				newBeats++;
+	        			}
+	        			if(events[e].flags & BEAT_EVENT_LOST)
+	        				hrv_break(&pc->hrv);
+	        		}
+	        	}
+	        	
+	            	// PRINT DATA TO TERMINAL
+	            	if(num_channels == 1)
+	            		printf("BPM: %d\n", pc->det.BPM);
+	            	else
+	            		printf("BPM[%d]: %d\n", pc->channel, pc->det.BPM);
+	            	
+	            	// resting heart rate range
+	            	if(pc->det.BPM >=60 && pc->det.BPM <= 100)
+	            	{
+			    	//message for sending BPM data to server
+			    	ret = snprintf(BPM_MQTT_msg, sizeof(BPM_MQTT_msg), "BPM:%d",pc->det.BPM);
+
+			    	//queue on the open connection
+			    	if(mqtt_client_publish(&mqtt, pc->topic, BPM_MQTT_msg, ret, mqtt_qos))
 			    	{
-			 		printf("system: error status %d\n", ret);
-					break;
+			 		printf("mqtt: error sending BPM data (%s)\n", strerror(errno));
 			    	}
 			    	else
 			    	{
 			    		printf("Sending BPM data to MQTT server\n\n");
 			    	}
-		    	}   	
-         	}
-         	if((micros() - timeOutStart) > TIME_OUT)
-         	{
-         		printf("Program timed out\n");
-            		break;
-        	}
+		    	}
+		    	
+		    	// HRV figures change once per beat, publish them with it
+		    	if(newBeats && hrv_get(&pc->hrv, &hrv) == 0)
+		    	{
+		    		if(num_channels == 1)
+		    			printf("HRV: ");
+		    		else
+		    			printf("HRV[%d]: ", pc->channel);
+		    		printf("mean %.0f ms SDNN %.1f ms RMSSD %.1f ms pNN50 %.1f%% median BPM %d (%u beats)\n",
+		    		       hrv.mean, hrv.sdnn, hrv.rmssd, hrv.pnn50,
+		    		       hrv.medianBPM, hrv.beats);
+		    		ret = hrv_format(&hrv, HRV_MQTT_msg, sizeof(HRV_MQTT_msg));
+		    		if(mqtt_client_publish(&mqtt, pc->hrvTopic, HRV_MQTT_msg, ret, mqtt_qos))
+		    			printf("mqtt: error sending HRV data (%s)\n", strerror(errno));
+		    	}
+		}
+		
+		// push out this tick's messages in one write, keepalive and QoS 1 acks
+		mqtt_client_poll(&mqtt, 0);
+		
+		// sampling latency since the previous report
+		if(stats_interval_s && cpuSeconds(CLOCK_MONOTONIC) >= nextStats)
+		{
+			printLatency("latency, last interval", 1);
+			nextStats += stats_interval_s;
+		}
+    	}
+    	
+    	double wall = cpuSeconds(CLOCK_MONOTONIC) - wallStart;
+    	double proc = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - procStart;
+    	double self = cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - selfStart;
+    	printf("cpu: process %.3f s (%.2f%%), consumer %.3f s (%.2f%%) over %.1f s\n",
+    	       proc, wall > 0 ? 100.0 * proc / wall : 0.0,
+    	       self, wall > 0 ? 100.0 * self / wall : 0.0, wall);
+    	
+    	sampler_stop(&sampler);
+    	printf("sampler: %llu ticks, %llu overruns, %llu spi errors, mean jitter %d uS\n",
+    	       (unsigned long long)sampler.wakeups,
+    	       (unsigned long long)sampler.overruns,
+    	       (unsigned long long)spiErrors,
+    	       sampler.wakeups ? (int)(sumJitter / (int64_t)sampler.wakeups) : 0);
+    	printLatency("latency, whole run", 0);
+    	for(unsigned int c = 0; c < num_channels; c++)
+    	{
+    		struct sample_ring *r = &channels[c].ring;
+    		
+	    	printf("ring[%d]: %u slots, %llu samples, %llu overflows, max lag %u, mean lag %.1f\n",
+	    	       channels[c].channel, r->size,
+	    	       (unsigned long long)r->pushed,
+	    	       (unsigned long long)r->overflows,
+	    	       r->max_lag,
+	    	       r->drains ? (double)r->lag_sum / r->drains : 0.0);
+    	}
+    	mqtt_client_print_stats(&mqtt, "mqtt");
+    	mqtt_client_close(&mqtt);
+    	if(store_cfg.dir)
+    	{
+    		ts_store_print_stats(&store, "store");
+    		ts_store_close(&store);
+    	}
+    	close(sample_efd);
+    	for(unsigned int c = 0; c < num_channels; c++)
+    	{
+    		sample_ring_free(&channels[c].ring);
+    		hrv_free(&channels[c].hrv);
     	}
 }
 
@@ -404,189 +732,226 @@ uint64_t micros()
     return us;
 }
 
-void initPulseSensorVariables(void)
+/*****************************************
+ * @brief	CLOCK_REALTIME in uS, what the
+ *		store keeps
+ ****************************************/
+static uint64_t wallMicros(void)
 {
-    	for (int i = 0; i < 10; ++i)
-    	{
-        	rate[i] = 0;
-    	}
-    	QS = 0;
-    	BPM = 0;
-    	IBI = 600;       	// 600ms per beat = 100 Beats Per Minute (BPM)
-    	Pulse = 0;
-	sampleCounter = 0;
-	lastBeatTime = 0;
-	P = 512;           	// peak at 1/2 the input range of 0..1023
-	T = 512;            	// trough at 1/2 the input range.
-	threshSetting = 550;  	// used to seed and reset the thresh variable
-	thresh = 550;     	// threshold a little above the trough
-	amp = 100;           	// beat amplitude 1/10 of input range.
-	firstBeat = 1;     	// looking for the first beat
-	secondBeat = 0;    	// not yet looking for the second beat in a row
-	lastTime = micros();
-	timeOutStart = lastTime;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return SEC_TO_US((uint64_t)ts.tv_sec) + NS_TO_US((uint64_t)ts.tv_nsec);
 }
 
-void startTimer(int latency, unsigned int micros)
+static double cpuSeconds(clockid_t clk)
 {
-	signal(SIGALRM, getPulse);
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-	// generate SIGALRM signal
-	// after latency interval and
-	// every micros interval
-	int err = ualarm(latency, micros);
-	if(err == 0)
+/*****************************************
+ * @brief	Print the latency histograms,
+ *		interval != 0 covers only what
+ *		was recorded since the last call
+ ****************************************/
+static void printLatency(const char *title, int interval)
+{
+	static struct lat_hist_snap prev[LAT_COUNT];
+	static struct lat_hist_snap now, delta;
+	
+	printf("%s:\n", title);
+	for (int i = 0; i < LAT_COUNT; i++)
 	{
-		if(micros > 0)
+		lat_hist_snapshot(&lat[i], &now);
+		if (interval)
 		{
-	    		printf("ualarm ON\n");
+			lat_hist_delta(&delta, &now, &prev[i]);
+			prev[i] = now;
+			lat_hist_print(lat[i].name, &delta);
 		}
 		else
 		{
-	    		printf("ualarm OFF\n");
-		}	
+			lat_hist_print(lat[i].name, &now);
+		}
 	}
 }
 
+/*****************************************
+ * @brief	SIGINT/SIGTERM: leave the
+ *		consumer loop
+ ****************************************/
+static void stopHandler(int sig)
+{
+	stopRequested = 1;
+}
 
-void getPulse(int sig_num)
-{	
-	if(sig_num == SIGALRM)
-    	{
-        	thisTime = micros();
-		Signal = pulse_read(spi_fd);
-		elapsedTime = thisTime - lastTime;
-		lastTime = thisTime;
-		jitter = elapsedTime - OPT_U;
-		sumJitter += jitter;
-		sampleFlag = 1;
-
-		// keep track of the time in mS with this variable
-	  	sampleCounter += 2;
-	  	// monitor the time since the last beat to avoid noise
-		int N = sampleCounter - lastBeatTime;
+/*****************************************
+ * @brief	Run a recording through the
+ *		detector as fast as possible
+ ****************************************/
+static void replay(const char *path)
+{
+	struct replay_stats st;
+	
+	if(replay_run(path, sample_period_us, hrv_window, &st) < 0)
+		pabort(path);
+	
+	fprintf(stderr, "replay: %llu samples in %.3f s, %.0f samples/s, %s detector %.0f samples/s\n",
+		(unsigned long long)st.samples, st.seconds,
+		st.seconds > 0 ? st.samples / st.seconds : 0.0,
+		beat_detector_kernel(),
+		st.detect_seconds > 0 ? st.samples / st.detect_seconds : 0.0);
+	fprintf(stderr, "replay: %llu beats, %llu lost, %llu lines skipped\n",
+		(unsigned long long)st.beats,
+		(unsigned long long)st.lost,
+		(unsigned long long)st.skipped);
+	if(st.hrv.beats)
+		fprintf(stderr, "replay: HRV over the last %u beats: mean %.1f ms SDNN %.1f ms RMSSD %.1f ms pNN50 %.1f%% median BPM %d\n",
+			st.hrv.beats, st.hrv.mean, st.hrv.sdnn, st.hrv.rmssd,
+			st.hrv.pnn50, st.hrv.medianBPM);
+}
+
+void initPulseSensorVariables(void)
+{
+	for (unsigned int c = 0; c < num_channels; c++)
+	{
+		initChannel(&channels[c]);
+	}
+	lat_hist_init(&lat[LAT_INTERVAL], "interval");
+	lat_hist_init(&lat[LAT_JITTER], "jitter");
+	lat_hist_init(&lat[LAT_HANDLER], "handler");
+	lat_hist_init(&lat[LAT_IOCTL], "ioctl");
+	sampleTimeUs = 0;
+	lastTime = micros();
+	sampleStartUs = lastTime;
+	realtimeOffsetUs = wallMicros() - sampleStartUs;
+}
+
+static void initChannel(struct pulse_channel *pc)
+{
+	beat_detector_init(&pc->det, BEAT_THRESH_DEFAULT);
+	if (hrv_init(&pc->hrv, hrv_window) < 0)
+		pabort("can't set up HRV window");
+	
+	// one topic per channel once more than one is scanned
+	if (num_channels > 1)
+	{
+		snprintf(pc->topic, sizeof(pc->topic), "%s/%d", mqtt_topic, pc->channel);
+		snprintf(pc->hrvTopic, sizeof(pc->hrvTopic), "%s/%d" MQTT_HRV_TOPIC,
+			 mqtt_topic, pc->channel);
+	}
+	else
+	{
+		snprintf(pc->topic, sizeof(pc->topic), "%s", mqtt_topic);
+		snprintf(pc->hrvTopic, sizeof(pc->hrvTopic), "%s" MQTT_HRV_TOPIC, mqtt_topic);
+	}
+}
+
+/*****************************************
+ * @brief	Append a drained block and its
+ *		beat events to the store
+ ****************************************/
+static void storeBlock(const struct pulse_channel *pc,
+		       const struct pulse_sample *batch, uint32_t n,
+		       const struct beat_event *events, size_t count)
+{
+	uint16_t series = pc->channel;
+	int ret = 0;
+	
+	for(uint32_t i = 0; i < n; i++)
+		ret |= ts_store_append(&store, batch[i].timestamp_us + realtimeOffsetUs,
+				       series, TS_KIND_PULSE_SAMPLE, batch[i].value);
+	for(size_t e = 0; e < count; e++)
+	{
+		uint64_t t = batch[events[e].index].timestamp_us + realtimeOffsetUs;
 		
-		//  find the peak and trough of the pulse wave
-		// avoid dichrotic noise by waiting 3/5 of last IBI
-		if (Signal < thresh && N > (IBI / 5) * 3)
+		if(events[e].flags & BEAT_EVENT_BEAT)
 		{
-			// T is the trough
-			if (Signal < T) 
-			{
-				// keep track of lowest point in pulse wave
-      				T = Signal;
-    			}
-  		}
-  		// thresh condition helps avoid noise
-  		if (Signal > thresh && Signal > P)
-  		{
-  			// P is the peak
-    			P = Signal;
-  		}
-  		
-  		//  NOW IT'S TIME TO LOOK FOR THE HEART BEAT
-  		// signal surges up in value every time there is a pulse
-  		if (N > 250) // avoid high frequency noise
-  		{
-    			if ( (Signal > thresh) && (Pulse == 0) && (N > ((IBI / 5) * 3)) )
-    			{
-    				// set the Pulse flag when we think there is a pulse
-      				Pulse = 1;
-      				// measure time between beats in mS
-      				IBI = sampleCounter - lastBeatTime;
-      				// keep track of time for next pulse 
-		      		lastBeatTime = sampleCounter;
-		      		
-		      		// if this is the second beat, if secondBeat == 1
-		      		if (secondBeat)
-		      		{
-		      			// clear secondBeat flag
-		      			secondBeat = 0;
-        				// seed the running total to get a realisitic BPM at startup
-        				for (int i = 0; i <= 9; i++)
-        				{
-          					rate[i] = IBI;
-        				}
-      				}
-      				
-      				// if it's the first time we found a beat, if firstBeat == 1
-      				if (firstBeat) 
-      				{
-      					// clear firstBeat flag
-      					firstBeat = 0;
-      					// set the second beat flag
-					secondBeat = 1;
-					// IBI value is unreliable so discard it
-					return;
-      				}
-      				
-      				// keep a running total of the last 10 IBI values
-      				int runningTotal = 0;
-
-				// shift data in the rate array
-			      	for (int i = 0; i <= 8; i++) 
-			      	{
-			      		// and drop the oldest IBI value
-					rate[i] = rate[i + 1];
-					// add up the 9 oldest IBI values
-					runningTotal += rate[i];
-			      	}
-
-				// add the latest IBI to the rate array
-      				rate[9] = IBI;
-      				// add the latest IBI to runningTotal
-      				runningTotal += rate[9];
-      				// average the last 10 IBI values
-      				runningTotal /= 10;
-      				// how many beats can fit into a minute? that's BPM!
-      				BPM = 60000 / runningTotal;
-      				// set Quantified Self flag (we detected a beat)
-      				QS = 1;
-      
-    			}
+			ret |= ts_store_append(&store, t, series, TS_KIND_PULSE_IBI, events[e].IBI);
+			ret |= ts_store_append(&store, t, series, TS_KIND_PULSE_BPM, events[e].BPM);
 		}
-		
-		// when the values are going down, the beat is over
-		if (Signal < thresh && Pulse == 1) 
+		if(events[e].flags & BEAT_EVENT_LOST)
+			ret |= ts_store_append(&store, t, series, TS_KIND_PULSE_LOST, 0);
+	}
+	if(ret)
+		printf("store: append failed (%s)\n", strerror(errno));
+}
+
+void startSampler(unsigned int period_us)
+{
+	// each channel's samples travel through its own lock-free ring,
+	// lost ones are counted
+	for (unsigned int c = 0; c < num_channels; c++)
+	{
+		if(sample_ring_init(&channels[c].ring, ring_size))
 		{
-			// reset the Pulse flag so we can do it again
-    			Pulse = 0;
-    			// get amplitude of the pulse wave
-    			amp = P - T;
-    			// set thresh at 50% of the amplitude
-    			thresh = amp / 2 + T;
-    			// reset these for next time
-    			P = thresh;
-    			T = thresh;
-  		}
-  		
-  		// if 2.5 seconds go by without a beat
-  		if (N > 2500) 
-  		{
-  			// set thresh default
-    			thresh = threshSetting;
-    			// set P default
-		    	P = 512;
-		    	// set T default
-		    	T = 512;
-		    	// bring the lastBeatTime up to date
-		    	lastBeatTime = sampleCounter;
-		    	// set these to avoid noise
-		    	firstBeat = 1;
-		    	// when we get the heartbeat back
-		    	secondBeat = 0;
-		    	QS = 0;
-		    	BPM = 0;
-		    	// 600ms per beat = 100 Beats Per Minute (BPM)
-		    	IBI = 600;
-		    	Pulse = 0;
-		    	// beat amplitude 1/10 of input range.
-		    	amp = 100;
-  		}
-  		
-  		duration = micros()-thisTime;
-		
+			pabort("can't set up sample ring (size must be a power of two)");
+		}
+	}
+	
+	// the sampler posts one count per tick to wake the consumer
+	sample_efd = eventfd(0, EFD_CLOEXEC);
+	if(sample_efd < 0)
+	{
+		pabort("can't create sample eventfd");
+	}
+	
+	// chained SPI transfers for the per-tick burst
+	pulse_burst_setup(burst_count, period_us);
+	
+	// sample from a dedicated thread woken by a periodic timerfd
+	if(sampler_start(&sampler, period_us, sampler_prio, getPulse, NULL))
+	{
+		pabort("can't start sampling thread");
 	}
+	printf("sampler ON (%u uS, %u scans of %u channels %u uS apart)\n",
+	       period_us, burst_count, num_channels, burst.step_us);
 }
 
 
+void getPulse(void *arg, uint64_t expirations)
+{
+	uint64_t one = 1;
+	struct pulse_sample sample;
+	int32_t values[MAX_XFERS];
+	unsigned int n = 0;
+	int ret;
+	
+	thisTime = micros();
+	ret = pulse_read_burst(spi_fd, values);
+	lat_hist_record(&lat[LAT_IOCTL], micros() - thisTime);
+	elapsedTime = thisTime - lastTime;
+	lastTime = thisTime;
+	// expected gap is one period per timer expiration
+	jitter = elapsedTime - expirations * sample_period_us;
+	sumJitter += (int)jitter;
+	lat_hist_record(&lat[LAT_INTERVAL], elapsedTime);
+	lat_hist_record(&lat[LAT_JITTER], (int)jitter < 0 ? -(int)jitter : (int)jitter);
+
+	// nominal time of the tick,
+	// missed periods (overruns) still advance the clock
+	sampleTimeUs += expirations * sample_period_us;
+	
+	// hand over to the detector thread, a full ring drops the sample,
+	// a failed read has none
+	for (unsigned int i = 0; ret == 0 && i < burst_count; i++)
+	{
+		for (unsigned int c = 0; c < num_channels; c++, n++)
+		{
+			sample.timestamp_us = sampleStartUs + sampleTimeUs +
+					      i * burst.step_us + c * burst.xfer_us;
+			sample.value = values[n];
+			sample_ring_push(&channels[c].ring, &sample);
+		}
+	}
+	
+	duration = micros()-thisTime;
+	lat_hist_record(&lat[LAT_HANDLER], duration);
+	
+	// wake the consumer, the eventfd counter adds up if it is late
+	if(write(sample_efd, &one, sizeof(one)) != sizeof(one))
+	{
+		perror("eventfd write");
+	}
+}
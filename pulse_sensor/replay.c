@@ -0,0 +1,267 @@
+/***********************************************************************
+ * @file      		replay.c
+ * @version   		0.1
+ * @brief		offline replay of recorded pulse sensor data
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * The recording is mapped read-only and decoded a block at a time into
+ * the arrays beat_detector_step_block() takes, so nothing is copied
+ * through stdio and the detector sees the same block shape as live.
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "beat_detector.h"
+#include "hrv.h"
+#include "replay.h"
+
+/**************************** Defines  **********************************/
+#define REPLAY_BLOCK		(4096)	// samples per detector call
+
+/**************************** Data Types ********************************/
+struct replay_block {
+	struct beat_detector det;
+	struct hrv hrv;
+	struct replay_stats *stats;
+	size_t n;
+	int32_t signal[REPLAY_BLOCK];
+	uint32_t time_ms[REPLAY_BLOCK];
+	struct beat_event events[REPLAY_BLOCK];
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Seconds on the monotonic clock
+ ****************************************/
+static double replay_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*****************************************
+ * @brief	Run the queued samples through
+ *		the detector and print events
+ ****************************************/
+static void replay_flush(struct replay_block *b)
+{
+	struct replay_stats *st = b->stats;
+	double start = replay_now();
+	size_t events;
+
+	events = beat_detector_step_block(&b->det, b->signal, b->time_ms,
+					  b->n, b->events);
+	st->detect_seconds += replay_now() - start;
+	st->samples += b->n;
+	b->n = 0;
+
+	for (size_t i = 0; i < events; i++)
+	{
+		const struct beat_event *ev = &b->events[i];
+
+		if (ev->flags & BEAT_EVENT_BEAT)
+		{
+			printf("beat %u ms IBI %d BPM %d\n",
+			       ev->time_ms, ev->IBI, ev->BPM);
+			hrv_add(&b->hrv, ev->IBI);
+			st->beats++;
+		}
+		if (ev->flags & BEAT_EVENT_LOST)
+		{
+			printf("lost %u ms\n", ev->time_ms);
+			hrv_break(&b->hrv);
+			st->lost++;
+		}
+	}
+}
+
+/*****************************************
+ * @brief	Queue one sample, flushing
+ *		when the block is full
+ ****************************************/
+static inline void replay_add(struct replay_block *b, int32_t value,
+			      uint32_t time_ms)
+{
+	b->signal[b->n] = value;
+	b->time_ms[b->n] = time_ms;
+	if (++b->n == REPLAY_BLOCK)
+		replay_flush(b);
+}
+
+/*****************************************
+ * @brief	Raw little-endian 16-bit
+ *		samples, period_us apart
+ ****************************************/
+static void replay_binary(struct replay_block *b, const uint8_t *data,
+			  size_t len, unsigned int period_us)
+{
+	size_t count = len / 2;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		int32_t value = data[2 * i] | (data[2 * i + 1] << 8);
+
+		replay_add(b, value, (uint32_t)((uint64_t)i * period_us / 1000));
+	}
+}
+
+/*****************************************
+ * @brief	Parse a decimal number, any
+ *		fraction is truncated, NULL if
+ *		there are no digits at p
+ ****************************************/
+static const char *replay_number(const char *p, const char *end,
+				 int64_t *out)
+{
+	int neg = 0;
+	int64_t v = 0;
+
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+	if (p == end || *p < '0' || *p > '9')
+		return NULL;
+	while (p < end && *p >= '0' && *p <= '9')
+		v = v * 10 + (*p++ - '0');
+	if (p < end && *p == '.')
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+			;
+	*out = neg ? -v : v;
+	return p;
+}
+
+/*****************************************
+ * @brief	"value" or "time_ms,value"
+ *		lines, one sample each
+ ****************************************/
+static void replay_csv(struct replay_block *b, const char *p, size_t len,
+		       unsigned int period_us)
+{
+	const char *end = p + len;
+	uint64_t index = 0;
+
+	while (p < end)
+	{
+		const char *eol = memchr(p, '\n', end - p);
+		const char *q;
+		int64_t first, second;
+
+		if (eol == NULL)
+			eol = end;
+		while (p < eol && (*p == ' ' || *p == '\t'))
+			p++;
+
+		q = replay_number(p, eol, &first);
+		if (q == NULL)
+		{
+			// header, comment or junk, blank lines are not counted
+			if (p < eol && *p != '\r')
+				b->stats->skipped++;
+			p = eol + 1;
+			continue;
+		}
+		while (q < eol && (*q == ' ' || *q == '\t'))
+			q++;
+		if (q < eol && (*q == ',' || *q == ';'))
+		{
+			for (q++; q < eol && (*q == ' ' || *q == '\t'); q++)
+				;
+			if (replay_number(q, eol, &second) == NULL)
+			{
+				b->stats->skipped++;
+				p = eol + 1;
+				continue;
+			}
+			replay_add(b, (int32_t)second, (uint32_t)first);
+		}
+		else
+		{
+			replay_add(b, (int32_t)first,
+				   (uint32_t)(index * period_us / 1000));
+		}
+		index++;
+		p = eol + 1;
+	}
+}
+
+/*****************************************
+ * @brief	Replay a recording through a
+ *		fresh detector, HRV is taken
+ *		over hrv_window beats
+ ****************************************/
+int replay_run(const char *path, unsigned int period_us,
+	       unsigned int hrv_window, struct replay_stats *stats)
+{
+	static struct replay_block block;
+	const char *ext = strrchr(path, '.');
+	struct stat st;
+	void *data = NULL;
+	double start;
+	int fd;
+
+	memset(stats, 0, sizeof(*stats));
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	if (st.st_size > 0)
+	{
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			return -1;
+		}
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	beat_detector_init(&block.det, BEAT_THRESH_DEFAULT);
+	if (hrv_init(&block.hrv, hrv_window) < 0)
+	{
+		if (data)
+			munmap(data, st.st_size);
+		return -1;
+	}
+	block.stats = stats;
+	block.n = 0;
+
+	start = replay_now();
+	if (ext && strcasecmp(ext, ".csv") == 0)
+		replay_csv(&block, data, st.st_size, period_us);
+	else
+		replay_binary(&block, data, st.st_size, period_us);
+	if (block.n)
+		replay_flush(&block);
+	stats->seconds = replay_now() - start;
+	hrv_get(&block.hrv, &stats->hrv);
+	hrv_free(&block.hrv);
+
+	if (data)
+		munmap(data, st.st_size);
+
+	return 0;
+}
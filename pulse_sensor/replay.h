@@ -0,0 +1,45 @@
+/***********************************************************************
+ * @file      		replay.h
+ * @version   		0.1
+ * @brief		offline replay of recorded pulse sensor data
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Runs a recording through the same beat detector as the live app, as
+ * fast as the CPU allows, and prints every beat and lost-signal event.
+ *
+ * Recordings ending in .csv hold one sample per line, either "value" or
+ * "time_ms,value"; lines that do not start with a number are skipped.
+ * Any other file is raw little-endian 16-bit ADC values. Samples without
+ * a time are spaced period_us apart.
+ *
+ ************************************************************************/
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+
+#include "hrv.h"
+
+/**************************** Data Types ********************************/
+struct replay_stats {
+	uint64_t samples;		// samples fed to the detector
+	uint64_t beats;			// BEAT_EVENT_BEAT events
+	uint64_t lost;			// BEAT_EVENT_LOST events
+	uint64_t skipped;		// CSV lines that held no sample
+	double seconds;			// wall time, parsing included
+	double detect_seconds;		// time spent inside the detector
+	struct hrv_stats hrv;		// over the last window beats at the end
+};
+
+/**************************** Function Declarations *********************/
+int replay_run(const char *path, unsigned int period_us,
+	       unsigned int hrv_window, struct replay_stats *stats);
+
+#endif /* REPLAY_H */
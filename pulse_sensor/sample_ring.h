@@ -0,0 +1,163 @@
+/***********************************************************************
+ * @file      		sample_ring.h
+ * @version   		0.1
+ * @brief		wait-free single producer / single consumer ring of
+ *			pulse samples
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * The sampling thread is the only producer, the detector/publisher
+ * thread the only consumer. head is written by the producer and tail by
+ * the consumer, each on its own cache line, and each side keeps a
+ * private copy of the other index so the shared line is only touched
+ * when the cached value says the ring looks full (or empty).
+ *
+ * A full ring never blocks the producer: the new sample is discarded
+ * and counted in overflows. Counters are owned by the side that writes
+ * them; read them from the other thread only after it has stopped.
+ *
+ ************************************************************************/
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+/**************************** Defines  **********************************/
+#define CACHE_LINE_SIZE		(64)
+
+/**************************** Data Types ********************************/
+struct pulse_sample {
+	uint64_t timestamp_us;		// nominal sample time, micros() clock
+	int32_t value;			// raw 10-bit ADC reading, -1 on error
+};
+
+struct sample_ring {
+	// producer line
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;
+	uint32_t tail_cache;		// producer's last view of tail
+	uint64_t pushed;
+	uint64_t overflows;		// samples dropped because full
+
+	// consumer line
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;
+	uint32_t head_cache;		// consumer's last view of head
+	uint32_t max_lag;		// deepest backlog seen by the consumer
+	uint64_t lag_sum;		// backlog summed over drains
+	uint64_t drains;		// pop_batch calls that found data
+
+	// read-only after init
+	_Alignas(CACHE_LINE_SIZE) uint32_t size;
+	uint32_t mask;
+	struct pulse_sample *buf;
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Allocate a ring of size slots,
+ *		size must be a power of two
+ ****************************************/
+static inline int sample_ring_init(struct sample_ring *r, uint32_t size)
+{
+	if (size < 2 || (size & (size - 1)))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(r, 0, sizeof(*r));
+	if (posix_memalign((void **)&r->buf, CACHE_LINE_SIZE,
+			   size * sizeof(*r->buf)))
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	r->size = size;
+	r->mask = size - 1;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Release the ring storage
+ ****************************************/
+static inline void sample_ring_free(struct sample_ring *r)
+{
+	free(r->buf);
+	r->buf = NULL;
+}
+
+/*****************************************
+ * @brief	Producer: append one sample,
+ *		-1 if the ring is full
+ ****************************************/
+static inline int sample_ring_push(struct sample_ring *r,
+				   const struct pulse_sample *s)
+{
+	uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+	r->pushed++;
+	if (head - r->tail_cache == r->size)
+	{
+		r->tail_cache = atomic_load_explicit(&r->tail,
+						     memory_order_acquire);
+		if (head - r->tail_cache == r->size)
+		{
+			r->overflows++;
+			return -1;
+		}
+	}
+
+	r->buf[head & r->mask] = *s;
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Consumer: move up to max of
+ *		the oldest samples into out
+ ****************************************/
+static inline uint32_t sample_ring_pop_batch(struct sample_ring *r,
+					     struct pulse_sample *out,
+					     uint32_t max)
+{
+	uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	uint32_t avail = r->head_cache - tail;
+	uint32_t n;
+
+	if (avail < max)
+	{
+		r->head_cache = atomic_load_explicit(&r->head,
+						     memory_order_acquire);
+		avail = r->head_cache - tail;
+	}
+	if (avail == 0)
+		return 0;
+
+	if (avail > r->max_lag)
+		r->max_lag = avail;
+	r->lag_sum += avail;
+	r->drains++;
+
+	n = avail < max ? avail : max;
+	for (uint32_t i = 0; i < n; i++)
+		out[i] = r->buf[(tail + i) & r->mask];
+	atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+
+	return n;
+}
+
+#endif /* SAMPLE_RING_H */
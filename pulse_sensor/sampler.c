@@ -0,0 +1,141 @@
+/***********************************************************************
+ * @file      		sampler.c
+ * @version   		0.1
+ * @brief		periodic sampling thread driven by a timerfd
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * @references
+ *
+ * https://man7.org/linux/man-pages/man2/timerfd_create.2.html
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+
+#include "sampler.h"
+
+/**************************** Function Declarations *********************/
+static void *sampler_thread(void *arg);
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Arm the timer and start the
+ *		sampling thread
+ ****************************************/
+int sampler_start(struct sampler *s, unsigned int period_us, int rt_prio,
+		  sampler_cb_t cb, void *arg)
+{
+	struct itimerspec its = {
+		.it_interval = {
+			.tv_sec = period_us / 1000000,
+			.tv_nsec = (period_us % 1000000) * 1000,
+		},
+	};
+	int ret;
+
+	if (period_us == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(s, 0, sizeof(*s));
+	s->period_us = period_us;
+	s->rt_prio = rt_prio;
+	s->cb = cb;
+	s->arg = arg;
+
+	s->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (s->timer_fd < 0)
+		return -1;
+
+	// first expiry one period from now, then every period
+	its.it_value = its.it_interval;
+	if (timerfd_settime(s->timer_fd, 0, &its, NULL) < 0)
+		goto fail;
+
+	s->running = 1;
+	ret = pthread_create(&s->thread, NULL, sampler_thread, s);
+	if (ret)
+	{
+		errno = ret;
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	close(s->timer_fd);
+	s->timer_fd = -1;
+	s->running = 0;
+	return -1;
+}
+
+/*****************************************
+ * @brief	Stop the thread after its
+ *		current period and disarm
+ ****************************************/
+void sampler_stop(struct sampler *s)
+{
+	if (!s->running)
+		return;
+
+	s->running = 0;
+	pthread_join(s->thread, NULL);
+	close(s->timer_fd);
+	s->timer_fd = -1;
+}
+
+/*****************************************
+ * @brief	Sampling thread body
+ ****************************************/
+static void *sampler_thread(void *arg)
+{
+	struct sampler *s = arg;
+	uint64_t expirations;
+	ssize_t ret;
+
+	if (s->rt_prio > 0)
+	{
+		struct sched_param param = { .sched_priority = s->rt_prio };
+
+		ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (ret)
+			fprintf(stderr, "sampler: SCHED_FIFO %d not set: %s\n",
+				s->rt_prio, strerror(ret));
+	}
+
+	while (s->running)
+	{
+		ret = read(s->timer_fd, &expirations, sizeof(expirations));
+		if (ret != sizeof(expirations))
+		{
+			if (ret < 0 && errno == EINTR)
+				continue;
+			perror("sampler: timerfd read");
+			break;
+		}
+
+		s->wakeups++;
+		s->periods += expirations;
+		s->overruns += expirations - 1;
+		s->cb(s->arg, expirations);
+	}
+
+	return NULL;
+}
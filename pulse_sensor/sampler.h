@@ -0,0 +1,48 @@
+/***********************************************************************
+ * @file      		sampler.h
+ * @version   		0.1
+ * @brief		periodic sampling thread driven by a timerfd
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * The thread blocks in read() on a periodic CLOCK_MONOTONIC timerfd and
+ * calls the sample callback once per wakeup, outside of any signal
+ * context. The expiration count returned by read() tells the callback
+ * how many periods elapsed, anything above one is an overrun.
+ *
+ ************************************************************************/
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <pthread.h>
+
+/**************************** Data Types ********************************/
+typedef void (*sampler_cb_t)(void *arg, uint64_t expirations);
+
+struct sampler {
+	pthread_t thread;
+	int timer_fd;
+	unsigned int period_us;
+	int rt_prio;			// SCHED_FIFO priority, 0 keeps SCHED_OTHER
+	sampler_cb_t cb;
+	void *arg;
+	volatile int running;
+	// written by the sampling thread only
+	uint64_t wakeups;		// read() calls that returned
+	uint64_t periods;		// sum of expiration counts
+	uint64_t overruns;		// periods missed (expirations - 1)
+};
+
+/**************************** Function Declarations *********************/
+int sampler_start(struct sampler *s, unsigned int period_us, int rt_prio,
+		  sampler_cb_t cb, void *arg);
+void sampler_stop(struct sampler *s);
+
+#endif /* SAMPLER_H */
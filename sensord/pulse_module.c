@@ -0,0 +1,337 @@
+/***********************************************************************
+ * @file      		pulse_module.c
+ * @version   		0.1
+ * @brief		MCP3008 pulse sensor pipeline as a sensord module
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * The sampler thread, sample rings and eventfd of pulse_app are gone:
+ * the burst is read and detected on the loop thread, which the timerfd
+ * wakes once per period instead of twice per sample.
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+#include <linux/spi/spidev.h>
+
+#include "spi_transport.h"
+#include "beat_detector.h"
+#include "pulse_module.h"
+
+/**************************** Defines  **********************************/
+#define US_TO_MS(us)    		((us)/1000)
+#define MQTT_MSG_LEN			(32)	// "BPM:%d" payload buffer
+#define MQTT_TOPIC_LEN			(64)	// per channel "<topic>/<ch>"
+#define MQTT_HRV_TOPIC			"/hrv"	// HRV sub-topic of each BPM topic
+
+/**************************** Data Types ********************************/
+struct pulse_channel {
+	int channel;			// MCP3008 input 0..7
+	char topic[MQTT_TOPIC_LEN];
+	char hrvTopic[MQTT_TOPIC_LEN + sizeof(MQTT_HRV_TOPIC)];
+	struct beat_detector det;
+	struct hrv hrv;			// IBI statistics of this channel
+	uint64_t beats;
+	uint64_t lost;
+};
+
+/**************************** Global Variables **************************/
+struct pulse_module_config pulse_cfg = {
+	.device = "/dev/spidev0.0",
+	.bits = 8,
+	.speed = 250000,
+	.period_us = PULSE_PERIOD_US,
+	.scans = PULSE_SCANS,
+	.channel = { 0 },
+	.num_channels = 1,
+	.topic = PULSE_TOPIC,
+	.hrv_window = HRV_WINDOW_DEFAULT,
+};
+
+static int spi_fd = -1;
+static struct mcp3008_burst burst;
+static struct pulse_channel channels[MCP3008_CHANNELS];
+static uint64_t startUs;		// monotonic time of the first period
+static uint64_t tickUs;			// nominal time of the current period
+static uint64_t realtimeOffsetUs;	// CLOCK_REALTIME - CLOCK_MONOTONIC
+static uint64_t ticks, overruns, spiErrors, samples;
+
+/**************************** Function Declarations *********************/
+static int pulse_start(struct sensord *d);
+static int pulse_stats(char *buf, size_t len);
+static void pulse_stop(struct sensord *d);
+static void pulse_tick(struct sensord *d, int fd, uint32_t events, void *arg);
+static void pulse_block(struct sensord *d, struct pulse_channel *pc,
+			const int32_t *values, unsigned int c);
+static void pulse_beat(struct sensord *d, struct pulse_channel *pc,
+		       const struct beat_event *ev);
+
+struct sensord_module pulse_module = {
+	.name = "pulse",
+	.enabled = 1,
+	.start = pulse_start,
+	.stats = pulse_stats,
+	.stop = pulse_stop,
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	To parse the channel list
+ ****************************************/
+int pulse_module_parse_channels(char *list)
+{
+	unsigned int mask = 0;
+	char *tok, *save;
+
+	pulse_cfg.num_channels = 0;
+	for (tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+	{
+		char *end;
+		long ch = strtol(tok, &end, 10);
+
+		if (*end != '\0' || ch < 0 || ch >= MCP3008_CHANNELS || (mask & (1 << ch)))
+			return -1;
+		mask |= 1 << ch;
+		pulse_cfg.channel[pulse_cfg.num_channels++] = ch;
+	}
+
+	return pulse_cfg.num_channels ? 0 : -1;
+}
+
+/*****************************************
+ * @brief	Open and set up the ADC, start
+ *		the period timer
+ ****************************************/
+static int pulse_start(struct sensord *d)
+{
+	spi_fd = spi_open(pulse_cfg.device);
+	if (spi_fd < 0)
+	{
+		perror(pulse_cfg.device);
+		return -1;
+	}
+	if (spi_ioctl(spi_fd, SPI_IOC_WR_MODE, &pulse_cfg.mode) == -1 ||
+	    spi_ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &pulse_cfg.bits) == -1 ||
+	    spi_ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &pulse_cfg.speed) == -1)
+	{
+		perror("can't set up spi");
+		return -1;
+	}
+	if (mcp3008_burst_setup(&burst, pulse_cfg.channel, pulse_cfg.num_channels,
+				pulse_cfg.scans, pulse_cfg.period_us, -1,
+				pulse_cfg.speed, pulse_cfg.bits, pulse_cfg.delay) < 0)
+	{
+		perror("can't set up the ADC burst");
+		return -1;
+	}
+
+	for (unsigned int c = 0; c < pulse_cfg.num_channels; c++)
+	{
+		struct pulse_channel *pc = &channels[c];
+
+		pc->channel = pulse_cfg.channel[c];
+		beat_detector_init(&pc->det, BEAT_THRESH_DEFAULT);
+		if (hrv_init(&pc->hrv, pulse_cfg.hrv_window) < 0)
+		{
+			perror("can't set up HRV window");
+			return -1;
+		}
+
+		// one topic per channel once more than one is scanned
+		if (pulse_cfg.num_channels > 1)
+		{
+			snprintf(pc->topic, sizeof(pc->topic), "%s/%d",
+				 pulse_cfg.topic, pc->channel);
+			snprintf(pc->hrvTopic, sizeof(pc->hrvTopic), "%s/%d" MQTT_HRV_TOPIC,
+				 pulse_cfg.topic, pc->channel);
+		}
+		else
+		{
+			snprintf(pc->topic, sizeof(pc->topic), "%s", pulse_cfg.topic);
+			snprintf(pc->hrvTopic, sizeof(pc->hrvTopic), "%s" MQTT_HRV_TOPIC,
+				 pulse_cfg.topic);
+		}
+	}
+
+	startUs = sensord_monotonic_us();
+	realtimeOffsetUs = sensord_realtime_us() - startUs;
+	tickUs = 0;
+	if (sensord_timer(d, pulse_cfg.period_us, "pulse", pulse_tick, NULL) < 0)
+	{
+		perror("pulse timer");
+		return -1;
+	}
+	printf("pulse: %s, %u scans of %u channels every %u uS, %u uS apart\n",
+	       pulse_cfg.device, pulse_cfg.scans, pulse_cfg.num_channels,
+	       pulse_cfg.period_us, burst.step_us);
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Period timer: one burst, then
+ *		the detector over each channel
+ ****************************************/
+static void pulse_tick(struct sensord *d, int fd, uint32_t events, void *arg)
+{
+	uint64_t expirations = sensord_timer_read(fd);
+	int32_t values[MCP3008_MAX_XFERS];
+
+	if (expirations == 0)
+		return;
+	ticks++;
+	overruns += expirations - 1;
+	// missed periods (overruns) still advance the clock
+	tickUs += expirations * pulse_cfg.period_us;
+
+	if (mcp3008_read_burst(spi_fd, &burst, values) < 0)
+	{
+		if (spiErrors++ == 0)
+			perror("can't send spi message");
+		return;
+	}
+	for (unsigned int c = 0; c < pulse_cfg.num_channels; c++)
+		pulse_block(d, &channels[c], values, c);
+}
+
+/*****************************************
+ * @brief	Run one channel's share of the
+ *		burst through the detector
+ ****************************************/
+static void pulse_block(struct sensord *d, struct pulse_channel *pc,
+			const int32_t *values, unsigned int c)
+{
+	unsigned int nc = pulse_cfg.num_channels;
+	unsigned int n = pulse_cfg.scans;
+	int32_t signal[MCP3008_MAX_XFERS];
+	uint64_t timeUs[MCP3008_MAX_XFERS];
+	uint32_t sampleMs[MCP3008_MAX_XFERS];
+	struct beat_event events[MCP3008_MAX_XFERS];
+	size_t count;
+	int ret = 0;
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		signal[i] = values[i * nc + c];
+		timeUs[i] = tickUs + i * burst.step_us + c * burst.xfer_us;
+		sampleMs[i] = US_TO_MS(timeUs[i]);
+	}
+	samples += n;
+	count = beat_detector_step_block(&pc->det, signal, sampleMs, n, events);
+
+	if (d->store)
+	{
+		for (unsigned int i = 0; i < n; i++)
+			ret |= ts_store_append(d->store, startUs + timeUs[i] + realtimeOffsetUs,
+					       pc->channel, TS_KIND_PULSE_SAMPLE, signal[i]);
+	}
+	for (size_t e = 0; e < count; e++)
+	{
+		uint64_t t = startUs + timeUs[events[e].index] + realtimeOffsetUs;
+
+		if (events[e].flags & BEAT_EVENT_BEAT)
+		{
+			if (d->store)
+			{
+				ret |= ts_store_append(d->store, t, pc->channel,
+						       TS_KIND_PULSE_IBI, events[e].IBI);
+				ret |= ts_store_append(d->store, t, pc->channel,
+						       TS_KIND_PULSE_BPM, events[e].BPM);
+			}
+			pulse_beat(d, pc, &events[e]);
+		}
+		if (events[e].flags & BEAT_EVENT_LOST)
+		{
+			if (d->store)
+				ret |= ts_store_append(d->store, t, pc->channel,
+						       TS_KIND_PULSE_LOST, 0);
+			hrv_break(&pc->hrv);
+			pc->lost++;
+		}
+	}
+	if (ret)
+		printf("store: append failed (%s)\n", strerror(errno));
+}
+
+/*****************************************
+ * @brief	A new IBI: update HRV, publish
+ *		BPM and HRV
+ ****************************************/
+static void pulse_beat(struct sensord *d, struct pulse_channel *pc,
+		       const struct beat_event *ev)
+{
+	char BPM_MQTT_msg[MQTT_MSG_LEN];
+	char HRV_MQTT_msg[HRV_MSG_LEN];
+	struct hrv_stats hrv;
+	int len;
+
+	hrv_add(&pc->hrv, ev->IBI);
+	pc->beats++;
+	if (d->verbose)
+		printf("BPM[%d]: %d\n", pc->channel, ev->BPM);
+
+	// resting heart rate range
+	if (ev->BPM >= 60 && ev->BPM <= 100)
+	{
+		len = snprintf(BPM_MQTT_msg, sizeof(BPM_MQTT_msg), "BPM:%d", ev->BPM);
+		if (sensord_publish(d, pc->topic, BPM_MQTT_msg, len))
+			printf("mqtt: error sending BPM data (%s)\n", strerror(errno));
+	}
+
+	if (hrv_get(&pc->hrv, &hrv) == 0)
+	{
+		len = hrv_format(&hrv, HRV_MQTT_msg, sizeof(HRV_MQTT_msg));
+		if (sensord_publish(d, pc->hrvTopic, HRV_MQTT_msg, len))
+			printf("mqtt: error sending HRV data (%s)\n", strerror(errno));
+	}
+}
+
+/*****************************************
+ * @brief	Counters for the stats line
+ ****************************************/
+static int pulse_stats(char *buf, size_t len)
+{
+	int n = snprintf(buf, len,
+			 "pulse_ticks:%llu,pulse_overruns:%llu,pulse_spi_errors:%llu,"
+			 "pulse_samples:%llu",
+			 (unsigned long long)ticks, (unsigned long long)overruns,
+			 (unsigned long long)spiErrors, (unsigned long long)samples);
+
+	for (unsigned int c = 0; c < pulse_cfg.num_channels && n < (int)len; c++)
+		n += snprintf(buf + n, len - n, ",bpm%d:%d,beats%d:%llu",
+			      channels[c].channel, channels[c].det.BPM,
+			      channels[c].channel,
+			      (unsigned long long)channels[c].beats);
+
+	return n < (int)len ? n : (int)len - 1;
+}
+
+static void pulse_stop(struct sensord *d)
+{
+	for (unsigned int c = 0; c < pulse_cfg.num_channels; c++)
+	{
+		printf("pulse[%d]: %llu beats, %llu lost, BPM %d\n",
+		       channels[c].channel,
+		       (unsigned long long)channels[c].beats,
+		       (unsigned long long)channels[c].lost,
+		       channels[c].det.BPM);
+		hrv_free(&channels[c].hrv);
+	}
+	if (spi_fd >= 0)
+		spi_close(spi_fd);
+	spi_fd = -1;
+}
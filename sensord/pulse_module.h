@@ -0,0 +1,56 @@
+/***********************************************************************
+ * @file      		pulse_module.h
+ * @version   		0.1
+ * @brief		MCP3008 pulse sensor pipeline as a sensord module
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Every period a timerfd wakes the loop, one ioctl takes scans
+ * conversions of every channel spread over the period, and the block
+ * goes straight through the beat detector and the HRV window. BPM and
+ * HRV are published once per beat.
+ *
+ ************************************************************************/
+#ifndef PULSE_MODULE_H
+#define PULSE_MODULE_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+
+#include "sensord.h"
+#include "mcp3008.h"
+#include "hrv.h"
+
+/**************************** Defines  **********************************/
+#define PULSE_TOPIC		"sensor/pulse"
+#define PULSE_PERIOD_US		(20000)	// 50 wakeups a second
+#define PULSE_SCANS		(10)	// 500 Hz per channel
+
+/**************************** Data Types ********************************/
+struct pulse_module_config {
+	const char *device;		// spidev path or "sim[:opts]"
+	uint8_t mode;
+	uint8_t bits;
+	uint32_t speed;
+	uint16_t delay;
+	unsigned int period_us;		// between wakeups
+	unsigned int scans;		// of all channels per wakeup
+	int channel[MCP3008_CHANNELS];
+	unsigned int num_channels;
+	const char *topic;
+	unsigned int hrv_window;
+};
+
+/**************************** Global Variables **************************/
+extern struct pulse_module_config pulse_cfg;
+extern struct sensord_module pulse_module;
+
+/**************************** Function Declarations *********************/
+int pulse_module_parse_channels(char *list);
+
+#endif /* PULSE_MODULE_H */
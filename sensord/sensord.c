@@ -0,0 +1,812 @@
+/***********************************************************************
+ * @file      		sensord.c
+ * @version   		0.1
+ * @brief		one process for the pulse and temperature sensors
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Runs the MCP3008 pulse pipeline of pulse_app and the TMP102 reader of
+ * temp_app as modules of a single epoll loop, with one MQTT connection,
+ * one store and one stats report. Nothing spins: the loop only wakes
+ * when a timerfd, the ALERT line or a signal has something for it, and
+ * the one helper thread, the MQTT publisher, sleeps until the loop hands
+ * it messages or the keepalive is due. Connecting, writing and waiting
+ * for acks all happen there, never between two pulse timer ticks.
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#include "sensord.h"
+#include "pulse_module.h"
+#include "temp_module.h"
+
+/**************************** Defines  **********************************/
+#define ARRAY_SIZE(a) 			(sizeof(a) / sizeof((a)[0]))
+#define SEC_TO_US(sec) 			((sec)*1000000)
+#define NS_TO_US(ns)    		((ns)/1000)
+
+/**************************** Global Variables **************************/
+static struct sensord daemon_ctx;
+static struct mqtt_config mqtt_cfg;
+static struct ts_store_config store_cfg;
+static struct ts_store store;
+static unsigned int stats_interval_s = SENSORD_STATS_S;
+
+static struct sensord_module *modules[] = {
+	&pulse_module,
+	&temp_module,
+};
+
+// what the previous report was taken against
+static struct {
+	uint64_t start_us;		// main() entered
+	uint64_t mono_us;
+	uint64_t wakeups;
+	double cpu_s;
+} last;
+
+/**************************** Function Declarations *********************/
+static void print_usage(const char *prog);
+static void parse_opts(int argc, char *argv[]);
+static int parse_modules(char *list);
+static double cpu_seconds(void);
+static unsigned long rss_kb(void);
+static void report(struct sensord *d, int publish);
+static void on_signal(struct sensord *d, int fd, uint32_t events, void *arg);
+static void on_stats(struct sensord *d, int fd, uint32_t events, void *arg);
+static int publisher_start(struct sensord *d);
+static void publisher_stop(struct sensord *d);
+static void *publisher(void *arg);
+
+/**************************** main function *****************************/
+int main(int argc, char *argv[])
+{
+	struct sensord *d = &daemon_ctx;
+	unsigned int started = 0;
+	sigset_t mask;
+	int sfd, ret = 0;
+
+	last.start_us = sensord_monotonic_us();
+	mqtt_config_default(&mqtt_cfg);
+	mqtt_cfg.client_id = "sensord";
+	ts_store_config_default(&store_cfg);
+	parse_opts(argc, argv);
+
+	if (sensord_init(d) < 0)
+	{
+		perror("epoll");
+		return 1;
+	}
+
+	// signals arrive as a readable fd like everything else
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sfd < 0 || sensord_watch(d, sfd, "signal", on_signal, NULL) < 0)
+	{
+		perror("signalfd");
+		return 1;
+	}
+	d->watch[d->watches - 1].owned = 1;
+
+	// the publisher connects while the modules start
+	if (publisher_start(d) < 0)
+	{
+		perror("publisher");
+		return 1;
+	}
+
+	if (store_cfg.dir)
+	{
+		if (ts_store_open(&store, &store_cfg) < 0)
+		{
+			perror(store_cfg.dir);
+			return 1;
+		}
+		d->store = &store;
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(modules); i++)
+	{
+		if (!modules[i]->enabled)
+			continue;
+		if (modules[i]->start(d) < 0)
+		{
+			printf("%s: can't start module\n", modules[i]->name);
+			ret = 1;
+			goto exit;
+		}
+		started = i + 1;
+	}
+
+	if (stats_interval_s &&
+	    sensord_timer(d, SEC_TO_US((uint64_t)stats_interval_s), "stats",
+			  on_stats, NULL) < 0)
+	{
+		perror("stats timer");
+		ret = 1;
+		goto exit;
+	}
+
+	last.mono_us = sensord_monotonic_us();
+	last.cpu_s = cpu_seconds();
+	printf("sensord: started in %.1f mS, %.1f mS cpu, rss %lu kB\n",
+	       (last.mono_us - last.start_us) / 1000.0, last.cpu_s * 1000.0,
+	       rss_kb());
+
+	// the publisher keeps the broker happy, the loop only wakes for work
+	while (!d->stop)
+	{
+		if (sensord_run_once(d, -1) < 0)
+		{
+			perror("epoll_wait");
+			ret = 1;
+			break;
+		}
+	}
+
+	// whole run, printed only
+	last.mono_us = last.start_us;
+	last.wakeups = 0;
+	last.cpu_s = 0;
+	report(d, 0);
+
+exit:
+	for (unsigned int i = started; i-- > 0;)
+	{
+		if (modules[i]->enabled && modules[i]->stop)
+			modules[i]->stop(d);
+	}
+	publisher_stop(d);
+	for (unsigned int i = 0; i < d->watches; i++)
+		printf("watch %s: %llu calls\n", d->watch[i].name,
+		       (unsigned long long)d->watch[i].calls);
+	printf("outbox: %llu queued, %llu dropped, %u deepest\n",
+	       (unsigned long long)d->out.queued,
+	       (unsigned long long)d->out.dropped, d->out.high);
+	mqtt_client_print_stats(&d->mqtt, "mqtt");
+	mqtt_client_close(&d->mqtt);
+	if (d->store)
+	{
+		ts_store_print_stats(d->store, "store");
+		ts_store_close(d->store);
+	}
+	sensord_close(d);
+
+	return ret;
+}
+
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	Create the epoll set
+ ****************************************/
+int sensord_init(struct sensord *d)
+{
+	d->epfd = epoll_create1(EPOLL_CLOEXEC);
+	d->watches = 0;
+	d->stop = 0;
+
+	return d->epfd < 0 ? -1 : 0;
+}
+
+/*****************************************
+ * @brief	Call cb whenever fd is readable,
+ *		fd stays the caller's to close
+ ****************************************/
+int sensord_watch(struct sensord *d, int fd, const char *name,
+		  sensord_cb cb, void *arg)
+{
+	struct sensord_watch *w;
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	if (d->watches == SENSORD_MAX_WATCHES)
+	{
+		errno = ENOSPC;
+		return -1;
+	}
+	w = &d->watch[d->watches];
+	w->fd = fd;
+	w->name = name;
+	w->cb = cb;
+	w->arg = arg;
+	w->owned = 0;
+	w->calls = 0;
+	ev.data.ptr = w;
+	if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -1;
+	d->watches++;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Periodic CLOCK_MONOTONIC timerfd,
+ *		returns the fd
+ ****************************************/
+int sensord_timer(struct sensord *d, uint64_t period_us, const char *name,
+		  sensord_cb cb, void *arg)
+{
+	struct itimerspec its = {
+		.it_interval = { .tv_sec = period_us / 1000000,
+				 .tv_nsec = (period_us % 1000000) * 1000 },
+	};
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (fd < 0)
+		return -1;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fd, 0, &its, NULL) < 0 ||
+	    sensord_watch(d, fd, name, cb, arg) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	d->watch[d->watches - 1].owned = 1;
+
+	return fd;
+}
+
+/*****************************************
+ * @brief	Expirations since the last read,
+ *		0 if none
+ ****************************************/
+uint64_t sensord_timer_read(int fd)
+{
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return 0;
+
+	return expirations;
+}
+
+/*****************************************
+ * @brief	Sleep until something is ready,
+ *		run its callbacks, then wake the
+ *		publisher once for all they
+ *		published
+ ****************************************/
+int sensord_run_once(struct sensord *d, int timeout_ms)
+{
+	struct epoll_event ev[SENSORD_MAX_EVENTS];
+	int n = epoll_wait(d->epfd, ev, SENSORD_MAX_EVENTS, timeout_ms);
+
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+	if (n > 0)
+		d->wakeups++;
+	for (int i = 0; i < n; i++)
+	{
+		struct sensord_watch *w = ev[i].data.ptr;
+
+		w->calls++;
+		d->dispatches++;
+		w->cb(d, w->fd, ev[i].events, w->arg);
+	}
+
+	// this pass's messages go out in one write
+	if (d->out.fresh)
+	{
+		d->out.fresh = 0;
+		pthread_mutex_lock(&d->out.lock);
+		pthread_cond_signal(&d->out.cond);
+		pthread_mutex_unlock(&d->out.lock);
+	}
+
+	return n;
+}
+
+/*****************************************
+ * @brief	Copy a message into the outbox,
+ *		never waits for the publisher:
+ *		when the outbox is full the new
+ *		message is dropped, ENOBUFS
+ ****************************************/
+int sensord_publish(struct sensord *d, const char *topic,
+		    const void *payload, size_t len)
+{
+	struct sensord_outbox *o = &d->out;
+	struct sensord_msg *m;
+	size_t topic_len = strlen(topic);
+
+	if (topic_len >= sizeof(m->topic) || len > sizeof(m->payload))
+	{
+		o->dropped++;
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	pthread_mutex_lock(&o->lock);
+	if (o->count == SENSORD_OUTBOX_DEPTH)
+	{
+		o->dropped++;
+		pthread_mutex_unlock(&o->lock);
+		errno = ENOBUFS;
+		return -1;
+	}
+	m = &o->msg[(o->head + o->count) % SENSORD_OUTBOX_DEPTH];
+	memcpy(m->topic, topic, topic_len + 1);
+	memcpy(m->payload, payload, len);
+	m->len = len;
+	o->count++;
+	if (o->count > o->high)
+		o->high = o->count;
+	o->queued++;
+	pthread_mutex_unlock(&o->lock);
+	o->fresh++;
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Set up the outbox and start the
+ *		thread that owns the MQTT client
+ ****************************************/
+static int publisher_start(struct sensord *d)
+{
+	struct sensord_outbox *o = &d->out;
+	pthread_condattr_t attr;
+	int err;
+
+	pthread_mutex_init(&o->lock, NULL);
+	// keepalive deadlines are on the monotonic clock
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&o->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	err = pthread_create(&d->publisher, NULL, publisher, d);
+	if (err)
+	{
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+/*****************************************
+ * @brief	Let the publisher send what is
+ *		left, then wait for it
+ ****************************************/
+static void publisher_stop(struct sensord *d)
+{
+	struct sensord_outbox *o = &d->out;
+
+	pthread_mutex_lock(&o->lock);
+	o->closing = 1;
+	pthread_cond_signal(&o->cond);
+	pthread_mutex_unlock(&o->lock);
+	pthread_join(d->publisher, NULL);
+	pthread_cond_destroy(&o->cond);
+	pthread_mutex_destroy(&o->lock);
+}
+
+/*****************************************
+ * @brief	Publisher thread: connect, then
+ *		sleep until the loop hands over
+ *		messages or half the keepalive
+ *		has passed. Messages are sent
+ *		from their outbox slots, which
+ *		the loop does not reuse until
+ *		they are released.
+ ****************************************/
+static void *publisher(void *arg)
+{
+	struct sensord *d = arg;
+	struct sensord_outbox *o = &d->out;
+	unsigned int wait_ms;
+	struct timespec deadline;
+	int failing = 0;		// the last publish was dropped
+
+	// connect once, the client reconnects on its own if the broker drops
+	if (mqtt_client_init(&d->mqtt, &mqtt_cfg) < 0)
+		perror("mqtt");
+	else if (!mqtt_client_connected(&d->mqtt))
+		printf("MQTT broker %s:%u not reachable, will retry\n",
+		       d->mqtt.cfg.host, d->mqtt.cfg.port);
+	wait_ms = d->mqtt.cfg.keepalive * 500;
+
+	pthread_mutex_lock(&o->lock);
+	while (1)
+	{
+		unsigned int head = o->head, n = o->count;
+
+		if (!n)
+		{
+			if (o->closing)
+				break;
+			if (!wait_ms)
+			{
+				pthread_cond_wait(&o->cond, &o->lock);
+				continue;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &deadline);
+			deadline.tv_sec += wait_ms / 1000;
+			deadline.tv_nsec += (wait_ms % 1000) * 1000000L;
+			if (deadline.tv_nsec >= 1000000000L)
+			{
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			if (pthread_cond_timedwait(&o->cond, &o->lock,
+						   &deadline) != ETIMEDOUT)
+				continue;
+		}
+		pthread_mutex_unlock(&o->lock);
+
+		for (unsigned int i = 0; i < n; i++)
+		{
+			struct sensord_msg *m =
+				&o->msg[(head + i) % SENSORD_OUTBOX_DEPTH];
+
+			// the client counts drops, say so only when that starts
+			// and when it stops
+			if (mqtt_client_publish(&d->mqtt, m->topic, m->payload,
+						m->len, d->qos) < 0)
+			{
+				if (!failing)
+					printf("mqtt: can't send %s (%s), "
+					       "dropping until the broker is back\n",
+					       m->topic, strerror(errno));
+				failing = 1;
+			}
+			else if (failing)
+			{
+				printf("mqtt: sending again, %llu dropped so far\n",
+				       (unsigned long long)d->mqtt.stats.dropped);
+				failing = 0;
+			}
+		}
+		// the batch in one write, keepalive and QoS 1 acks
+		mqtt_client_poll(&d->mqtt, 0);
+
+		pthread_mutex_lock(&o->lock);
+		o->head = (head + n) % SENSORD_OUTBOX_DEPTH;
+		o->count -= n;
+	}
+	pthread_mutex_unlock(&o->lock);
+	mqtt_client_flush(&d->mqtt);
+
+	return NULL;
+}
+
+/*****************************************
+ * @brief	Close the timers and the epoll
+ *		set
+ ****************************************/
+void sensord_close(struct sensord *d)
+{
+	for (unsigned int i = 0; i < d->watches; i++)
+	{
+		if (d->watch[i].owned)
+			close(d->watch[i].fd);
+	}
+	d->watches = 0;
+	close(d->epfd);
+}
+
+uint64_t sensord_monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SEC_TO_US((uint64_t)ts.tv_sec) + NS_TO_US((uint64_t)ts.tv_nsec);
+}
+
+uint64_t sensord_realtime_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return SEC_TO_US((uint64_t)ts.tv_sec) + NS_TO_US((uint64_t)ts.tv_nsec);
+}
+
+static double cpu_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*****************************************
+ * @brief	Resident set size, kB
+ ****************************************/
+static unsigned long rss_kb(void)
+{
+	unsigned long size, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/*****************************************
+ * @brief	One line for the daemon and all
+ *		modules since the last report,
+ *		printed and published the same
+ ****************************************/
+static void report(struct sensord *d, int publish)
+{
+	char line[SENSORD_STATS_LEN];
+	uint64_t now_us = sensord_monotonic_us();
+	double cpu_s = cpu_seconds();
+	double span_s = (now_us - last.mono_us) / 1e6;
+	int len;
+
+	len = snprintf(line, sizeof(line),
+		       "interval:%.1f,wakeups_per_s:%.1f,cpu:%.2f,rss_kB:%lu,"
+		       "outbox_dropped:%llu",
+		       span_s,
+		       span_s > 0 ? (d->wakeups - last.wakeups) / span_s : 0.0,
+		       span_s > 0 ? 100.0 * (cpu_s - last.cpu_s) / span_s : 0.0,
+		       rss_kb(), (unsigned long long)d->out.dropped);
+	for (unsigned int i = 0; i < ARRAY_SIZE(modules); i++)
+	{
+		if (!modules[i]->enabled || !modules[i]->stats ||
+		    len + 1 >= (int)sizeof(line))
+			continue;
+		line[len++] = ',';
+		len += modules[i]->stats(line + len, sizeof(line) - len);
+	}
+	if (len >= (int)sizeof(line))
+		len = sizeof(line) - 1;
+
+	printf("stats: %s\n", line);
+	if (publish && sensord_publish(d, SENSORD_STATS_TOPIC, line, len))
+		printf("mqtt: error sending stats (%s)\n", strerror(errno));
+
+	last.mono_us = now_us;
+	last.wakeups = d->wakeups;
+	last.cpu_s = cpu_s;
+}
+
+/*****************************************
+ * @brief	SIGINT/SIGTERM: leave the loop
+ ****************************************/
+static void on_signal(struct sensord *d, int fd, uint32_t events, void *arg)
+{
+	struct signalfd_siginfo si;
+
+	if (read(fd, &si, sizeof(si)) == sizeof(si))
+		d->stop = 1;
+}
+
+static void on_stats(struct sensord *d, int fd, uint32_t events, void *arg)
+{
+	if (sensord_timer_read(fd))
+		report(d, 1);
+}
+
+/*****************************************
+ * @brief	To print usage
+ ****************************************/
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [options]\n", prog);
+	puts("  -M --modules   modules to run, e.g. pulse,temp (default both)\n"
+	     "  -m --mqtt      MQTT broker host[:port] (default localhost:1883)\n"
+	     "  -q --qos       MQTT QoS level 0 or 1 (default 0)\n"
+	     "  -s --store     keep samples, beats and readings in a time-series\n"
+	     "                 store, dir[:seg=MB,keep=N,flush=ms,...], see ts_store.h\n"
+	     "  -i --stats     seconds between stats reports, also published to\n"
+	     "                 " SENSORD_STATS_TOPIC ", 0 only at exit (default 10)\n"
+	     "  -v --verbose   print every beat and reading\n"
+	     " pulse:\n"
+	     "  -D --device    SPI device (default /dev/spidev0.0), \"sim[:opts]\"\n"
+	     "                 for a simulated MCP3008 and pulse, see spi_sim.h\n"
+	     "     --speed    SPI max speed (Hz, default 250000)\n"
+	     "  -c --channels  ADC channels to scan, e.g. 0,3,5 (default 0)\n"
+	     "  -p --period    usec between wakeups (default 20000)\n"
+	     "  -k --burst     scans of all channels per wakeup, one ioctl, spread\n"
+	     "                 over the period (default 10, 500 Hz sampling)\n"
+	     "  -P --pulse-topic MQTT topic (default " PULSE_TOPIC ")\n"
+	     "  -w --hrv       beats in the HRV window (default 60)\n"
+	     " temperature:\n"
+	     "  -S --sensors   bus:addr pairs to poll, e.g. 1:0x48,1:0x49,2:0x48\n"
+	     "                 (default 1:0x48)\n"
+	     "  -I --interval  msec between reads (default 1000)\n"
+	     "  -T --temp-topic MQTT topic (default " TEMP_TOPIC ")\n"
+	     "  -d --deadband  celsius change needed to publish (default 0.0625)\n"
+	     "  -X --max-gap   max sec between messages of a sensor, 0 never\n"
+	     "                 (default 60)\n"
+	     "  -A --alert     chip:line of the ALERT pin, e.g. gpiochip0:17; read\n"
+	     "                 on alert and heartbeat instead of every interval\n"
+	     "  -H --high      T_HIGH in celsius (default 80)\n"
+	     "  -L --low       T_LOW in celsius (default 75)\n"
+	     "  -C --comparator ALERT in comparator mode (default interrupt mode)\n"
+	     "  -b --heartbeat sec between reads without an alert (default 60)\n");
+	exit(1);
+}
+
+/*****************************************
+ * @brief	To parse the module list
+ ****************************************/
+static int parse_modules(char *list)
+{
+	char *tok, *save;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(modules); i++)
+		modules[i]->enabled = 0;
+	for (tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+	{
+		for (i = 0; i < ARRAY_SIZE(modules); i++)
+		{
+			if (strcmp(tok, modules[i]->name) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(modules))
+			return -1;
+		modules[i]->enabled = 1;
+	}
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	To parse arguments
+ ****************************************/
+static void parse_opts(int argc, char *argv[])
+{
+	static const struct option lopts[] = {
+		{ "modules",  1, 0, 'M' },
+		{ "mqtt",     1, 0, 'm' },
+		{ "qos",      1, 0, 'q' },
+		{ "store",    1, 0, 's' },
+		{ "stats",    1, 0, 'i' },
+		{ "verbose",  0, 0, 'v' },
+		{ "device",   1, 0, 'D' },
+		{ "speed",    1, 0, 'F' },
+		{ "channels", 1, 0, 'c' },
+		{ "period",   1, 0, 'p' },
+		{ "burst",    1, 0, 'k' },
+		{ "pulse-topic", 1, 0, 'P' },
+		{ "hrv",      1, 0, 'w' },
+		{ "sensors",  1, 0, 'S' },
+		{ "interval", 1, 0, 'I' },
+		{ "temp-topic", 1, 0, 'T' },
+		{ "deadband", 1, 0, 'd' },
+		{ "max-gap",  1, 0, 'X' },
+		{ "alert",    1, 0, 'A' },
+		{ "high",     1, 0, 'H' },
+		{ "low",      1, 0, 'L' },
+		{ "comparator", 0, 0, 'C' },
+		{ "heartbeat", 1, 0, 'b' },
+		{ NULL, 0, 0, 0 },
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "M:m:q:s:i:vD:c:p:k:P:w:S:I:T:d:X:A:H:L:Cb:",
+				lopts, NULL)) != -1)
+	{
+		switch (c) {
+		case 'M':
+			if (parse_modules(optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'm':
+			if (mqtt_parse_broker(&mqtt_cfg, optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'q':
+			daemon_ctx.qos = atoi(optarg);
+			if (daemon_ctx.qos < 0 || daemon_ctx.qos > 1)
+				print_usage(argv[0]);
+			break;
+		case 's':
+			if (ts_store_parse(&store_cfg, optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'i':
+			stats_interval_s = atoi(optarg);
+			break;
+		case 'v':
+			daemon_ctx.verbose = 1;
+			break;
+		case 'D':
+			pulse_cfg.device = optarg;
+			break;
+		case 'F':
+			pulse_cfg.speed = atoi(optarg);
+			break;
+		case 'c':
+			if (pulse_module_parse_channels(optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'p':
+			pulse_cfg.period_us = atoi(optarg);
+			if (pulse_cfg.period_us < 100)
+				print_usage(argv[0]);
+			break;
+		case 'k':
+			pulse_cfg.scans = atoi(optarg);
+			if (pulse_cfg.scans < 1 || pulse_cfg.scans > MCP3008_MAX_XFERS)
+				print_usage(argv[0]);
+			break;
+		case 'P':
+			pulse_cfg.topic = optarg;
+			break;
+		case 'w':
+			pulse_cfg.hrv_window = atoi(optarg);
+			if (pulse_cfg.hrv_window < 2 || pulse_cfg.hrv_window > HRV_WINDOW_MAX)
+				print_usage(argv[0]);
+			break;
+		case 'S':
+			if (temp_module_parse_sensors(optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'I':
+			temp_cfg.interval_ms = atoi(optarg);
+			if (temp_cfg.interval_ms == 0)
+				print_usage(argv[0]);
+			break;
+		case 'T':
+			temp_cfg.topic = optarg;
+			break;
+		case 'd':
+			temp_cfg.publish.deadband = strtof(optarg, NULL);
+			if (temp_cfg.publish.deadband < 0)
+				print_usage(argv[0]);
+			break;
+		case 'X':
+			temp_cfg.publish.max_interval_us = strtoull(optarg, NULL, 0) * 1000000;
+			break;
+		case 'A':
+			if (temp_module_parse_alert(optarg) < 0)
+				print_usage(argv[0]);
+			break;
+		case 'H':
+			temp_cfg.t_high = strtof(optarg, NULL);
+			break;
+		case 'L':
+			temp_cfg.t_low = strtof(optarg, NULL);
+			break;
+		case 'C':
+			temp_cfg.comparator = 1;
+			break;
+		case 'b':
+			temp_cfg.heartbeat_s = atoi(optarg);
+			if (temp_cfg.heartbeat_s == 0)
+				print_usage(argv[0]);
+			break;
+		default:
+			print_usage(argv[0]);
+			break;
+		}
+	}
+
+	// every scan of every channel is one transfer of the message
+	if (pulse_cfg.scans * pulse_cfg.num_channels > MCP3008_MAX_XFERS)
+	{
+		printf("burst x channels must not exceed %d\n", MCP3008_MAX_XFERS);
+		print_usage(argv[0]);
+	}
+	if (temp_cfg.t_low >= temp_cfg.t_high)
+		print_usage(argv[0]);
+}
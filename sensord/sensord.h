@@ -0,0 +1,119 @@
+/***********************************************************************
+ * @file      		sensord.h
+ * @version   		0.1
+ * @brief		sensor daemon, event loop and module interface
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * One thread sleeps in epoll_wait on every descriptor the modules
+ * watch, timerfds for periodic work, GPIO line events, the signalfd.
+ * A callback runs for each ready one. What the modules publish is
+ * copied into a bounded outbox and, once per pass, handed to a
+ * publisher thread that owns the MQTT connection, so a slow or absent
+ * broker never delays a timer. Modules append to one shared
+ * time-series store and report into one stats line, printed and
+ * published every stats interval.
+ *
+ ************************************************************************/
+#ifndef SENSORD_H
+#define SENSORD_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "mqtt_client.h"
+#include "ts_store.h"
+
+/**************************** Defines  **********************************/
+#define SENSORD_MAX_WATCHES	(16)	// descriptors in the epoll set
+#define SENSORD_MAX_EVENTS	(16)	// taken per epoll_wait
+#define SENSORD_STATS_LEN	(512)	// one stats line, all modules
+#define SENSORD_STATS_TOPIC	"sensord/stats"
+#define SENSORD_STATS_S		(10)	// default seconds between reports
+#define SENSORD_OUTBOX_DEPTH	(64)	// messages waiting for the publisher
+#define SENSORD_TOPIC_LEN	(64)
+
+/**************************** Data Types ********************************/
+struct sensord;
+
+// fd is ready, events as returned by epoll
+typedef void (*sensord_cb)(struct sensord *d, int fd, uint32_t events, void *arg);
+
+struct sensord_watch {
+	int fd;
+	const char *name;
+	sensord_cb cb;
+	void *arg;
+	int owned;			// a timer of ours, closed at exit
+	uint64_t calls;			// times cb ran
+};
+
+// a module hosted by the daemon, every hook but start may be NULL
+struct sensord_module {
+	const char *name;
+	int enabled;
+	int (*start)(struct sensord *d);	// open devices, add watches
+	// "key:value,..." of the module's counters, returns the length
+	int (*stats)(char *buf, size_t len);
+	void (*stop)(struct sensord *d);	// flush, print, close
+};
+
+// one message on its way to the publisher thread
+struct sensord_msg {
+	char topic[SENSORD_TOPIC_LEN];
+	uint16_t len;
+	uint8_t payload[SENSORD_STATS_LEN];
+};
+
+// loop thread -> publisher thread, the loop never waits on it
+struct sensord_outbox {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct sensord_msg msg[SENSORD_OUTBOX_DEPTH];
+	unsigned int head;		// oldest message
+	unsigned int count;
+	unsigned int fresh;		// queued since the last wakeup, loop only
+	int closing;			// drain, flush and leave
+	uint64_t queued;
+	uint64_t dropped;		// outbox full, or too long
+	unsigned int high;		// deepest fill level seen
+};
+
+struct sensord {
+	int epfd;
+	int stop;			// set by a callback to leave the loop
+	int verbose;			// print every reading
+	struct sensord_watch watch[SENSORD_MAX_WATCHES];
+	unsigned int watches;
+	struct sensord_outbox out;	// shared by every module
+	pthread_t publisher;
+	struct mqtt_client mqtt;	// publisher thread only
+	int qos;
+	struct ts_store *store;		// NULL: no store
+	uint64_t wakeups;		// epoll_wait returns with work
+	uint64_t dispatches;		// callbacks run
+};
+
+/**************************** Function Declarations *********************/
+int sensord_init(struct sensord *d);
+int sensord_watch(struct sensord *d, int fd, const char *name,
+		  sensord_cb cb, void *arg);
+int sensord_timer(struct sensord *d, uint64_t period_us, const char *name,
+		  sensord_cb cb, void *arg);
+uint64_t sensord_timer_read(int fd);
+int sensord_run_once(struct sensord *d, int timeout_ms);
+int sensord_publish(struct sensord *d, const char *topic,
+		    const void *payload, size_t len);
+void sensord_close(struct sensord *d);
+
+uint64_t sensord_monotonic_us(void);
+uint64_t sensord_realtime_us(void);
+
+#endif /* SENSORD_H */
@@ -0,0 +1,285 @@
+/***********************************************************************
+ * @file      		temp_module.c
+ * @version   		0.1
+ * @brief		TMP102 temperature reader as a sensord module
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * The reading queue and publisher thread of temp_app are gone: a read
+ * is a few hundred uS of I2C, so it is filtered and published right on
+ * the loop thread.
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "alert_line.h"
+#include "temp_module.h"
+
+/**************************** Global Variables **************************/
+struct temp_module_config temp_cfg = {
+	.interval_ms = TEMP_INTERVAL_MS,
+	.topic = TEMP_TOPIC,
+	.publish = {
+		.deadband = TEMP_DEADBAND_C,
+		.max_interval_us = TEMP_MAX_PUBLISH_S * 1000000ULL,
+	},
+	.t_high = 80.0f,		// TMP102 power-up limits
+	.t_low = 75.0f,
+	.heartbeat_s = TEMP_HEARTBEAT_S,
+};
+
+// sorted by bus, the ones on one bus are read in one transfer
+static struct temp_sensors sensors;
+static struct alert_line alert = { .fd = -1 };
+static uint64_t cycles, alerts, heartbeats, messages;
+
+/**************************** Function Declarations *********************/
+static int temp_start(struct sensord *d);
+static int temp_stats(char *buf, size_t len);
+static void temp_stop(struct sensord *d);
+static void temp_sample(struct sensord *d, uint64_t timestamp_us);
+static void temp_publish(struct sensord *d, const struct temp_sensor *sensor,
+			 const struct publish_span *span);
+static void temp_interval(struct sensord *d, int fd, uint32_t events, void *arg);
+static void temp_heartbeat(struct sensord *d, int fd, uint32_t events, void *arg);
+static void temp_alert(struct sensord *d, int fd, uint32_t events, void *arg);
+
+struct sensord_module temp_module = {
+	.name = "temp",
+	.enabled = 1,
+	.start = temp_start,
+	.stats = temp_stats,
+	.stop = temp_stop,
+};
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	To parse bus:addr pairs
+ ****************************************/
+int temp_module_parse_sensors(char *list)
+{
+	if (temp_sensors_parse(&sensors, list) < 0)
+		return -1;
+
+	return sensors.count ? 0 : -1;
+}
+
+/*****************************************
+ * @brief	To parse chip:line of the
+ *		ALERT pin
+ ****************************************/
+int temp_module_parse_alert(char *spec)
+{
+	return temp_sensors_parse_alert(spec, &temp_cfg.alert_chip,
+					&temp_cfg.alert_offset);
+}
+
+/*****************************************
+ * @brief	Open the sensors and start the
+ *		interval timer, or the ALERT
+ *		line and heartbeat timer
+ ****************************************/
+static int temp_start(struct sensord *d)
+{
+	if (sensors.count == 0)
+		temp_sensors_add(&sensors, 1, TMP102_ADDR_DEFAULT);
+	if (temp_sensors_open(&sensors, temp_cfg.topic) < 0)
+	{
+		printf("temp: can't open the sensors (%s)\n", strerror(errno));
+		return -1;
+	}
+
+	if (temp_cfg.alert_chip)
+	{
+		if (temp_sensors_program_alerts(&sensors, temp_cfg.t_low,
+						temp_cfg.t_high,
+						temp_cfg.comparator) < 0)
+		{
+			printf("temp: can't program the alerts (%s)\n",
+			       strerror(errno));
+			return -1;
+		}
+		if (alert_line_open(&alert, temp_cfg.alert_chip, temp_cfg.alert_offset,
+				    temp_cfg.comparator) < 0 ||
+		    sensord_watch(d, alert.fd, "temp alert", temp_alert, NULL) < 0)
+		{
+			printf("temp: can't watch ALERT %s:%u (%s)\n",
+			       temp_cfg.alert_chip, temp_cfg.alert_offset,
+			       strerror(errno));
+			return -1;
+		}
+		if (sensord_timer(d, temp_cfg.heartbeat_s * 1000000ULL,
+				  "temp heartbeat", temp_heartbeat, NULL) < 0)
+			return -1;
+		printf("temp: %zu sensors on %zu buses, ALERT %s:%u (%s mode, "
+		       "T_LOW %.4fC, T_HIGH %.4fC)\n", sensors.count, sensors.bus_count,
+		       temp_cfg.alert_chip, temp_cfg.alert_offset,
+		       temp_cfg.comparator ? "comparator" : "interrupt",
+		       temp_cfg.t_low, temp_cfg.t_high);
+	}
+	else
+	{
+		if (sensord_timer(d, temp_cfg.interval_ms * 1000ULL, "temp",
+				  temp_interval, NULL) < 0)
+			return -1;
+		printf("temp: %zu sensors on %zu buses every %u mS\n",
+		       sensors.count, sensors.bus_count, temp_cfg.interval_ms);
+	}
+
+	// first reading right away, it also clears a latched alert
+	temp_sample(d, sensord_realtime_us());
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Read every sensor, store the
+ *		readings and publish what the
+ *		filter lets through
+ ****************************************/
+static void temp_sample(struct sensord *d, uint64_t timestamp_us)
+{
+	struct publish_span span;
+
+	cycles++;
+	temp_sensors_poll(&sensors);
+
+	for (size_t i = 0; i < sensors.count; i++)
+	{
+		struct temp_sensor *sensor = &sensors.sensor[i];
+
+		if (!sensor->valid)
+			continue;
+		if (d->verbose)
+			printf("Temperature[%s] = %fC\n", sensor->id, sensor->temperature);
+		// the store keeps what the deadband holds back
+		if (d->store &&
+		    ts_store_append(d->store, timestamp_us,
+				    (sensor->node << 8) | sensor->addr,
+				    TS_KIND_TEMP, sensor->temperature) < 0)
+			printf("store: append failed (%s)\n", strerror(errno));
+		if (publish_filter_offer(&sensor->filter, &temp_cfg.publish,
+					 sensor->temperature, timestamp_us,
+					 &span) != PUBLISH_NONE)
+			temp_publish(d, sensor, &span);
+	}
+}
+
+/*****************************************
+ * @brief	Queue one message for the
+ *		readings a span stands for
+ ****************************************/
+static void temp_publish(struct sensord *d, const struct temp_sensor *sensor,
+			 const struct publish_span *span)
+{
+	char temp_MQTT_msg[TEMP_SENSOR_MSG_LEN];
+	int len = temp_sensors_format(span, temp_MQTT_msg, sizeof(temp_MQTT_msg));
+
+	if (sensord_publish(d, sensor->topic, temp_MQTT_msg, len))
+		printf("mqtt: error sending temperature (%s)\n", strerror(errno));
+	else
+		messages++;
+}
+
+static void temp_interval(struct sensord *d, int fd, uint32_t events, void *arg)
+{
+	if (sensord_timer_read(fd))
+		temp_sample(d, sensord_realtime_us());
+}
+
+static void temp_heartbeat(struct sensord *d, int fd, uint32_t events, void *arg)
+{
+	if (sensord_timer_read(fd))
+	{
+		heartbeats++;
+		temp_sample(d, sensord_realtime_us());
+	}
+}
+
+/*****************************************
+ * @brief	ALERT edges: read the sensors,
+ *		tagged with the time of the last
+ *		edge
+ ****************************************/
+static void temp_alert(struct sensord *d, int fd, uint32_t events, void *arg)
+{
+	struct gpio_v2_line_event ev[ALERT_LINE_EVENTS];
+	int count = alert_line_wait(&alert, 0, ev, ALERT_LINE_EVENTS);
+
+	if (count <= 0)
+		return;
+	alerts++;
+	if (d->verbose)
+		printf("ALERT %s\n",
+		       ev[count - 1].id == GPIO_V2_LINE_EVENT_RISING_EDGE ?
+		       "raised" : "cleared");
+	temp_sample(d, sensord_realtime_us() - (sensord_monotonic_us() -
+						 ev[count - 1].timestamp_ns / 1000));
+}
+
+/*****************************************
+ * @brief	Counters for the stats line
+ ****************************************/
+static int temp_stats(char *buf, size_t len)
+{
+	uint64_t samples = 0, errors = 0;
+	int n;
+
+	for (size_t i = 0; i < sensors.count; i++)
+	{
+		samples += sensors.sensor[i].samples;
+		errors += sensors.sensor[i].errors;
+	}
+	n = snprintf(buf, len,
+		     "temp_reads:%llu,temp_samples:%llu,temp_errors:%llu,"
+		     "temp_messages:%llu",
+		     (unsigned long long)cycles, (unsigned long long)samples,
+		     (unsigned long long)errors, (unsigned long long)messages);
+	if (temp_cfg.alert_chip && n < (int)len)
+		n += snprintf(buf + n, len - n, ",temp_alerts:%llu,temp_heartbeats:%llu",
+			      (unsigned long long)alerts,
+			      (unsigned long long)heartbeats);
+
+	return n < (int)len ? n : (int)len - 1;
+}
+
+/*****************************************
+ * @brief	Send held changes, print the
+ *		filter counts, close the buses
+ ****************************************/
+static void temp_stop(struct sensord *d)
+{
+	struct publish_span span;
+
+	for (size_t i = 0; i < sensors.count; i++)
+	{
+		struct temp_sensor *sensor = &sensors.sensor[i];
+		const struct publish_stats *st = &sensor->filter.stats;
+
+		// changes still held by the rate limit are not lost at exit
+		if (publish_filter_due(&sensor->filter, &temp_cfg.publish,
+				       sensord_realtime_us(), true, &span) != PUBLISH_NONE)
+			temp_publish(d, sensor, &span);
+		printf("temp[%s]: %llu samples, %llu errors, %llu changes, "
+		       "%llu heartbeats, %llu saved by deadband\n", sensor->id,
+		       (unsigned long long)sensor->samples,
+		       (unsigned long long)sensor->errors,
+		       (unsigned long long)st->changes,
+		       (unsigned long long)st->heartbeats,
+		       (unsigned long long)st->deadband);
+	}
+	alert_line_close(&alert);
+	temp_sensors_close(&sensors);
+}
@@ -0,0 +1,57 @@
+/***********************************************************************
+ * @file      		temp_module.h
+ * @version   		0.1
+ * @brief		TMP102 temperature reader as a sensord module
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Reads every sensor on a timerfd, or when the shared ALERT line
+ * changes plus a heartbeat timerfd, with one combined transfer per bus.
+ * Readings go to the store and through a publish_filter per sensor, so
+ * only changes and heartbeats become messages.
+ *
+ ************************************************************************/
+#ifndef TEMP_MODULE_H
+#define TEMP_MODULE_H
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sensord.h"
+#include "temp_sensors.h"
+
+/**************************** Defines  **********************************/
+#define TEMP_TOPIC		"sensor/temperature"
+#define TEMP_INTERVAL_MS	(1000)	// the TMP102 converts 4 times a second
+#define TEMP_HEARTBEAT_S	(60)
+#define TEMP_DEADBAND_C		(0.0625f)	// one TMP102 LSB
+#define TEMP_MAX_PUBLISH_S	(60)
+
+/**************************** Data Types ********************************/
+struct temp_module_config {
+	unsigned int interval_ms;
+	const char *topic;
+	struct publish_policy publish;
+	const char *alert_chip;		// set: read on ALERT and heartbeat
+	unsigned int alert_offset;
+	float t_high;
+	float t_low;
+	int comparator;			// ALERT follows the limits, no latching
+	unsigned int heartbeat_s;
+};
+
+/**************************** Global Variables **************************/
+extern struct temp_module_config temp_cfg;
+extern struct sensord_module temp_module;
+
+/**************************** Function Declarations *********************/
+int temp_module_parse_sensors(char *list);
+int temp_module_parse_alert(char *spec);
+
+#endif /* TEMP_MODULE_H */
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Binary SPI transfer trace, see spi_trace.h
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "spi_trace.h"
+
+/* widest line hex_dump() renders */
+#define HEX_MAX_LINE 256
+
+uint64_t spi_trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *src, size_t len)
+{
+	const uint8_t *p = src;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int trace_put(struct spi_trace *t, const void *src, size_t len)
+{
+	if (t->used + len > sizeof(t->buf) && spi_trace_flush(t))
+		return -1;
+	/* larger than the whole buffer, straight to the file */
+	if (len > sizeof(t->buf)) {
+		if (write_all(t->fd, src, len))
+			return -1;
+		t->bytes += len;
+		return 0;
+	}
+	memcpy(t->buf + t->used, src, len);
+	t->used += len;
+	return 0;
+}
+
+int spi_trace_open(struct spi_trace *t, const char *path, uint32_t mode,
+		   uint8_t bits, uint32_t speed)
+{
+	struct spi_trace_header h;
+	struct timespec ts;
+
+	t->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (t->fd < 0)
+		return -1;
+	t->used = 0;
+	t->records = 0;
+	t->bytes = 0;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SPI_TRACE_MAGIC, sizeof(h.magic));
+	h.version = SPI_TRACE_VERSION;
+	h.mode = mode;
+	h.speed = speed;
+	h.bits = bits;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	h.start_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	t->t0 = spi_trace_now();
+
+	return trace_put(t, &h, sizeof(h));
+}
+
+/*
+ * Appends one transfer, start and end as from spi_trace_now() around
+ * the ioctl that carried it. Only copies unless the buffer is full.
+ */
+int spi_trace_xfer(struct spi_trace *t, uint64_t start, uint64_t end,
+		   const void *tx, const void *rx, uint32_t len)
+{
+	struct spi_trace_rec r = {
+		.ts_ns = start - t->t0,
+		.dur_ns = end - start,
+		.len = len,
+	};
+
+	t->records++;
+	if (trace_put(t, &r, sizeof(r)) || trace_put(t, tx, len))
+		return -1;
+	return trace_put(t, rx, len);
+}
+
+int spi_trace_flush(struct spi_trace *t)
+{
+	if (!t->used)
+		return 0;
+	if (write_all(t->fd, t->buf, t->used))
+		return -1;
+	t->bytes += t->used;
+	t->used = 0;
+	return 0;
+}
+
+int spi_trace_close(struct spi_trace *t)
+{
+	int ret = spi_trace_flush(t);
+
+	if (close(t->fd))
+		ret = -1;
+	t->fd = -1;
+	return ret;
+}
+
+/*
+ * Hex and ASCII, line_size bytes a line, each line formatted in place
+ * and printed in one go.
+ */
+void hex_dump(const void *src, size_t length, size_t line_size,
+	      const char *prefix)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const unsigned char *p = src;
+	char out[3 * HEX_MAX_LINE + HEX_MAX_LINE + 4];
+	size_t i, n;
+	char *o;
+
+	if (line_size > HEX_MAX_LINE)
+		line_size = HEX_MAX_LINE;
+
+	while (length) {
+		n = length < line_size ? length : line_size;
+		o = out;
+		for (i = 0; i < line_size; i++) {
+			if (i < n) {
+				*o++ = hex[p[i] >> 4];
+				*o++ = hex[p[i] & 0xf];
+			} else {
+				*o++ = '_';
+				*o++ = '_';
+			}
+			*o++ = ' ';
+		}
+		*o++ = ' ';
+		*o++ = '|';
+		for (i = 0; i < n; i++)
+			*o++ = (p[i] < 32 || p[i] > 126) ? '.' : p[i];
+		*o++ = '|';
+		printf("%s | %.*s\n", prefix, (int)(o - out), out);
+		p += n;
+		length -= n;
+	}
+}
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Binary SPI transfer trace, written by spidev_test_1 -t and read back
+ * by spi_trace_dump.
+ *
+ * A file is one struct spi_trace_header followed by records, each a
+ * struct spi_trace_rec and then len bytes of TX and len bytes of RX.
+ * Fields are in the byte order of the host that wrote the file.
+ */
+#ifndef SPI_TRACE_H
+#define SPI_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SPI_TRACE_MAGIC "SPITRACE"
+#define SPI_TRACE_VERSION 1
+/* records are gathered here and leave in one write() */
+#define SPI_TRACE_BUF (256 * 1024)
+
+struct spi_trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t mode;
+	uint32_t speed; /* Hz */
+	uint8_t bits;
+	uint8_t pad[3];
+	uint64_t start_ns; /* CLOCK_REALTIME when the trace was opened */
+};
+
+struct spi_trace_rec {
+	uint64_t ts_ns; /* start of the ioctl, since the trace was opened */
+	uint32_t dur_ns; /* the ioctl the transfer went out in */
+	uint32_t len; /* of TX, the same again of RX follows */
+};
+
+struct spi_trace {
+	int fd;
+	uint64_t t0; /* CLOCK_MONOTONIC at open */
+	size_t used;
+	uint64_t records;
+	uint64_t bytes; /* written to the file */
+	uint8_t buf[SPI_TRACE_BUF];
+};
+
+uint64_t spi_trace_now(void);
+int spi_trace_open(struct spi_trace *t, const char *path, uint32_t mode,
+		   uint8_t bits, uint32_t speed);
+int spi_trace_xfer(struct spi_trace *t, uint64_t start, uint64_t end,
+		   const void *tx, const void *rx, uint32_t len);
+int spi_trace_flush(struct spi_trace *t);
+int spi_trace_close(struct spi_trace *t);
+
+void hex_dump(const void *src, size_t length, size_t line_size,
+	      const char *prefix);
+
+#endif /* SPI_TRACE_H */
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Renders a trace written by spidev_test_1 -t as hex and ASCII
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spi_trace.h"
+
+static size_t line_size = 32;
+static int headers_only;
+static uint64_t first;
+static uint64_t count = UINT64_MAX;
+
+static void pabort(const char *s)
+{
+	if (errno != 0)
+		perror(s);
+	else
+		fprintf(stderr, "%s\n", s);
+
+	exit(1);
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [-wqfn] trace.bin\n", prog);
+	puts("  -w --width    bytes per line (default 32)\n"
+	     "  -q --quiet    one line per transfer, no data\n"
+	     "  -f --first    first transfer to show (default 0)\n"
+	     "  -n --count    transfers to show (default all)\n");
+	exit(1);
+}
+
+static void parse_opts(int argc, char *argv[])
+{
+	while (1) {
+		static const struct option lopts[] = {
+			{ "width",  1, 0, 'w' },
+			{ "quiet",  0, 0, 'q' },
+			{ "first",  1, 0, 'f' },
+			{ "count",  1, 0, 'n' },
+			{ NULL, 0, 0, 0 },
+		};
+		int c;
+
+		c = getopt_long(argc, argv, "w:qf:n:", lopts, NULL);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'w':
+			line_size = strtoul(optarg, NULL, 0);
+			if (!line_size)
+				line_size = 32;
+			break;
+		case 'q':
+			headers_only = 1;
+			break;
+		case 'f':
+			first = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			print_usage(argv[0]);
+		}
+	}
+	if (optind + 1 != argc)
+		print_usage(argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+	struct spi_trace_header h;
+	struct spi_trace_rec r;
+	uint8_t *data = NULL;
+	size_t cap = 0;
+	uint64_t n = 0, bytes = 0, last = 0;
+	time_t start;
+	FILE *f;
+
+	parse_opts(argc, argv);
+
+	f = fopen(argv[optind], "rb");
+	if (!f)
+		pabort("can't open trace file");
+	errno = 0;
+	if (fread(&h, sizeof(h), 1, f) != 1 ||
+	    memcmp(h.magic, SPI_TRACE_MAGIC, sizeof(h.magic)))
+		pabort("not a spidev_test_1 trace");
+	if (h.version != SPI_TRACE_VERSION)
+		pabort("unknown trace version");
+
+	start = h.start_ns / 1000000000ULL;
+	printf("spi mode: 0x%x\n", h.mode);
+	printf("bits per word: %u\n", h.bits);
+	printf("max speed: %u Hz (%u kHz)\n", h.speed, h.speed / 1000);
+	printf("started: %s", ctime(&start));
+
+	while (fread(&r, sizeof(r), 1, f) == 1) {
+		if ((size_t)r.len * 2 > cap) {
+			cap = (size_t)r.len * 2;
+			free(data);
+			data = malloc(cap);
+			if (!data)
+				pabort("can't allocate transfer buffer");
+		}
+		errno = 0;
+		if (fread(data, 1, (size_t)r.len * 2, f) != (size_t)r.len * 2)
+			pabort("trace ends inside a transfer");
+
+		if (n >= first && n - first < count) {
+			printf("#%llu +%.6fs %.1fus %u bytes\n",
+			       (unsigned long long)n, r.ts_ns / 1e9,
+			       r.dur_ns / 1e3, r.len);
+			if (!headers_only) {
+				hex_dump(data, r.len, line_size, "TX");
+				hex_dump(data + r.len, r.len, line_size, "RX");
+			}
+		}
+		bytes += r.len;
+		last = r.ts_ns + r.dur_ns;
+		n++;
+	}
+	if (ferror(f))
+		pabort("can't read trace file");
+
+	printf("total: %llu transfers, %.1fKB in %.6fs\n",
+	       (unsigned long long)n, bytes / 1024.0, last / 1e9);
+
+	free(data);
+	fclose(f);
+	return 0;
+}
@@ -17,14 +17,32 @@
 #include <getopt.h>
 #include <fcntl.h>
 #include <time.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <linux/ioctl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
+#include "spi_transport.h"
+#include "spi_trace.h"
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
+/* most segments SPI_IOC_MESSAGE() can encode in the ioctl size field */
+#define MAX_BATCH ((1 << _IOC_SIZEBITS) / sizeof(struct spi_ioc_transfer) - 1)
+#define MAX_BATCH_SIZES 16
+/* default file chunk, spidev's default bufsiz */
+#define CHUNK_SIZE 4096
+/* input consumed before its pages are dropped */
+#define DROP_BEHIND (1 << 20)
+/* devices driven at once by -W */
+#define MAX_WORKERS 8
+/* latency histogram: 8 linear steps per power of two of nS */
+#define HIST_SUB 8
+#define HIST_SIZE (64 * HIST_SUB)
+
 static void pabort(const char *s)
 {
 	if (errno != 0)
@@ -40,12 +58,53 @@ static uint32_t mode;
 static uint8_t bits = 8;
 static char *input_file;
 static char *output_file;
+static int out_fd = -1;
+static char *trace_file;
+static struct spi_trace trace; /* -t, every transfer from the main thread */
+static size_t chunk_size = CHUNK_SIZE;
 static uint32_t speed = 500000;
 static uint16_t delay;
 static int verbose;
 static int transfer_size;
 static int iterations;
 static int interval = 5; /* interval in seconds for showing transfer rate */
+static unsigned int batch[MAX_BATCH_SIZES]; /* segments per ioctl, -B */
+static int batch_sizes;
+static int cs_change;
+static int lock_buffers; /* -m: mlock the benchmark buffers */
+static int refresh_tx; /* -r: new TX pattern every iteration */
+static uint64_t pattern_seed = 1;
+static int run_secs = 5; /* -T: seconds per -W phase */
+
+struct worker_stats {
+	uint64_t xfers;
+	uint64_t bytes;
+	uint64_t lat_sum; /* nS */
+	uint64_t lat_max;
+	double secs;
+	uint32_t hist[HIST_SIZE];
+};
+
+/* one -W device and its thread */
+struct worker {
+	const char *path;
+	int size;
+	uint32_t speed;
+	int duty; /* % of the time spent in transfers */
+	int fd;
+	uint8_t *tx;
+	uint8_t *rx;
+	struct spi_ioc_transfer tr;
+	pthread_t thread;
+	struct worker_stats *st; /* the phase being run */
+	struct worker_stats solo;
+	struct worker_stats shared;
+};
+
+static struct worker workers[MAX_WORKERS];
+static int num_workers;
+static uint64_t phase_end_ns;
+static pthread_barrier_t phase_start;
 
 static uint8_t default_tx[] = {
 	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
@@ -59,34 +118,6 @@ static uint8_t default_tx[] = {
 static uint8_t default_rx[ARRAY_SIZE(default_tx)] = {0, };
 static char *input_tx;
 
-static void hex_dump(const void *src, size_t length, size_t line_size,
-		     char *prefix)
-{
-	int i = 0;
-	const unsigned char *address = src;
-	const unsigned char *line = address;
-	unsigned char c;
-
-	printf("%s | ", prefix);
-	while (length-- > 0) {
-		printf("%02X ", *address++);
-		if (!(++i % line_size) || (length == 0 && i % line_size)) {
-			if (length == 0) {
-				while (i++ % line_size)
-					printf("__ ");
-			}
-			printf(" |");
-			while (line < address) {
-				c = *line++;
-				printf("%c", (c < 32 || c > 126) ? '.' : c);
-			}
-			printf("|\n");
-			if (length > 0)
-				printf("%s | ", prefix);
-		}
-	}
-}
-
 /*
  *  Unescape - process hexadecimal escape character
  *      converts shell input "\x23" -> 0x23
@@ -115,55 +146,68 @@ static int unescape(char *_dst, char *_src, size_t len)
 	return ret;
 }
 
-static void transfer(int fd, uint8_t const *tx, uint8_t const *rx, size_t len)
+static void setup_transfer(struct spi_ioc_transfer *tr, uint8_t const *tx,
+			   uint8_t const *rx, size_t len)
 {
-	int ret;
-	int out_fd;
-	struct spi_ioc_transfer tr = {
-		.tx_buf = (unsigned long)tx,
-		.rx_buf = (unsigned long)rx,
-		.len = len,
-		.delay_usecs = delay,
-		.speed_hz = speed,
-		.bits_per_word = bits,
-	};
+	memset(tr, 0, sizeof(*tr));
+	tr->tx_buf = (unsigned long)tx;
+	tr->rx_buf = (unsigned long)rx;
+	tr->len = len;
+	tr->delay_usecs = delay;
+	tr->speed_hz = speed;
+	tr->bits_per_word = bits;
 
 	if (mode & SPI_TX_OCTAL)
-		tr.tx_nbits = 8;
+		tr->tx_nbits = 8;
 	else if (mode & SPI_TX_QUAD)
-		tr.tx_nbits = 4;
+		tr->tx_nbits = 4;
 	else if (mode & SPI_TX_DUAL)
-		tr.tx_nbits = 2;
+		tr->tx_nbits = 2;
 	if (mode & SPI_RX_OCTAL)
-		tr.rx_nbits = 8;
+		tr->rx_nbits = 8;
 	else if (mode & SPI_RX_QUAD)
-		tr.rx_nbits = 4;
+		tr->rx_nbits = 4;
 	else if (mode & SPI_RX_DUAL)
-		tr.rx_nbits = 2;
+		tr->rx_nbits = 2;
 	if (!(mode & SPI_LOOP)) {
 		if (mode & (SPI_TX_OCTAL | SPI_TX_QUAD | SPI_TX_DUAL))
-			tr.rx_buf = 0;
+			tr->rx_buf = 0;
 		else if (mode & (SPI_RX_OCTAL | SPI_RX_QUAD | SPI_RX_DUAL))
-			tr.tx_buf = 0;
+			tr->tx_buf = 0;
 	}
+}
+
+static void trace_xfer(uint64_t start, uint64_t end, const void *tx,
+		       const void *rx, size_t len)
+{
+	if (spi_trace_xfer(&trace, start, end, tx, rx, len))
+		pabort("can't write trace file");
+}
 
-	ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
+static void transfer(int fd, uint8_t const *tx, uint8_t const *rx, size_t len)
+{
+	int ret;
+	struct spi_ioc_transfer tr;
+	uint64_t t0 = 0;
+
+	setup_transfer(&tr, tx, rx, len);
+
+	if (trace_file)
+		t0 = spi_trace_now();
+	ret = spi_ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
 	if (ret < 1)
 		pabort("can't send spi message");
+	if (trace_file)
+		trace_xfer(t0, spi_trace_now(), tx, rx, len);
 
 	if (verbose)
 		hex_dump(tx, len, 32, "TX");
 
-	if (output_file) {
-		out_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-		if (out_fd < 0)
-			pabort("could not open output file");
-
-		ret = write(out_fd, rx, len);
+	/* the file holds the last transfer, opened once by main() */
+	if (out_fd >= 0) {
+		ret = pwrite(out_fd, rx, len, 0);
 		if (ret != len)
 			pabort("not all bytes written to output file");
-
-		close(out_fd);
 	}
 
 	if (verbose)
@@ -172,9 +216,10 @@ static void transfer(int fd, uint8_t const *tx, uint8_t const *rx, size_t len)
 
 static void print_usage(const char *prog)
 {
-	printf("Usage: %s [-2348CDFHILMNORSZbdilopsv]\n", prog);
+	printf("Usage: %s [-2348BCDFHILMNORSTWZbcdiklmoprstv]\n", prog);
 	puts("general device settings:\n"
-		 "  -D --device         device to use (default /dev/spidev1.1)\n"
+		 "  -D --device         device to use (default /dev/spidev1.1),\n"
+		 "                      \"sim[:opts]\" for a simulated MCP3008\n"
 		 "  -s --speed          max speed (Hz)\n"
 		 "  -d --delay          delay (usec)\n"
 		 "  -l --loop           loopback\n"
@@ -191,9 +236,23 @@ static void print_usage(const char *prog)
 		 "data:\n"
 		 "  -i --input          input data from a file (e.g. \"test.bin\")\n"
 		 "  -o --output         output data to a file (e.g. \"results.bin\")\n"
+		 "  -k --chunk          bytes per transfer when streaming --input\n"
+		 "                      (default 4096, spidev's bufsiz)\n"
 		 "  -p                  Send data (e.g. \"1234\\xde\\xad\")\n"
 		 "  -S --size           transfer size\n"
 		 "  -I --iter           iterations\n"
+		 "  -B --batch          transfers chained per ioctl with -S/-I, a list\n"
+		 "                      (e.g. 1,4,16,64) runs and reports each size\n"
+		 "  -c --cs-change      deselect the chip between chained transfers\n"
+		 "  -m --mlock          lock the -S/-I buffers in memory\n"
+		 "  -r --refresh        new TX pattern every iteration (default: once)\n"
+		 "  -t --trace          append every transfer's TX and RX, timestamped,\n"
+		 "                      to a binary file (decode with spi_trace_dump)\n"
+		 "several devices:\n"
+		 "  -W --worker         dev[@size=N,speed=Hz,duty=%] adds a device with\n"
+		 "                      its own thread, repeat for more; each runs alone,\n"
+		 "                      then all together (defaults -S, -s, 100)\n"
+		 "  -T --time           seconds per device alone and together (default 5)\n"
 		 "additional parameters:\n"
 		 "  -b --bpw            bits per word\n"
 		 "  -L --lsb            least significant bit first\n"
@@ -206,6 +265,58 @@ static void print_usage(const char *prog)
 	exit(1);
 }
 
+static void parse_batch(char *list)
+{
+	char *tok, *save, *end;
+	unsigned long n;
+
+	batch_sizes = 0;
+	for (tok = strtok_r(list, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		n = strtoul(tok, &end, 0);
+		if (*end || n < 1 || n > MAX_BATCH ||
+		    batch_sizes == MAX_BATCH_SIZES) {
+			errno = 0;
+			pabort("batch sizes must be 1..511, at most 16 of them");
+		}
+		batch[batch_sizes++] = n;
+	}
+}
+
+/* dev[@size=N,speed=Hz,duty=%], the defaults come from -S and -s */
+static void parse_worker(struct worker *w)
+{
+	char *at = strchr(w->path, '@');
+	char *tok, *save, *val;
+
+	w->size = transfer_size ? transfer_size : 32;
+	w->speed = speed;
+	w->duty = 100;
+	if (!at)
+		return;
+	*at = '\0';
+	for (tok = strtok_r(at + 1, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		val = strchr(tok, '=');
+		if (!val)
+			goto bad;
+		*val++ = '\0';
+		if (!strcmp(tok, "size"))
+			w->size = atoi(val);
+		else if (!strcmp(tok, "speed"))
+			w->speed = strtoul(val, NULL, 0);
+		else if (!strcmp(tok, "duty"))
+			w->duty = atoi(val);
+		else
+			goto bad;
+	}
+	if (w->size > 0 && w->duty > 0 && w->duty <= 100)
+		return;
+bad:
+	errno = 0;
+	pabort("bad -W device, expected dev[@size=N,speed=Hz,duty=1..100]");
+}
+
 static void parse_opts(int argc, char *argv[])
 {
 	while (1) {
@@ -224,8 +335,16 @@ static void parse_opts(int argc, char *argv[])
 			{ "3wire-hiz",     0, 0, 'Z' },
 			{ "input",         1, 0, 'i' },
 			{ "output",        1, 0, 'o' },
+			{ "chunk",         1, 0, 'k' },
 			{ "size",          1, 0, 'S' },
 			{ "iter",          1, 0, 'I' },
+			{ "batch",         1, 0, 'B' },
+			{ "cs-change",     0, 0, 'c' },
+			{ "mlock",         0, 0, 'm' },
+			{ "refresh",       0, 0, 'r' },
+			{ "trace",         1, 0, 't' },
+			{ "worker",        1, 0, 'W' },
+			{ "time",          1, 0, 'T' },
 			{ "bpw",           1, 0, 'b' },
 			{ "lsb",           0, 0, 'L' },
 			{ "cs-high",       0, 0, 'C' },
@@ -237,7 +356,7 @@ static void parse_opts(int argc, char *argv[])
 		};
 		int c;
 
-		c = getopt_long(argc, argv, "D:s:d:b:i:o:lHOLC3ZFMNR248p:vS:I:",
+		c = getopt_long(argc, argv, "D:s:d:b:i:o:k:lHOLC3ZFMNR248p:vS:I:B:cmrt:W:T:",
 				lopts, NULL);
 
 		if (c == -1)
@@ -262,6 +381,13 @@ static void parse_opts(int argc, char *argv[])
 		case 'o':
 			output_file = optarg;
 			break;
+		case 'k':
+			chunk_size = strtoul(optarg, NULL, 0);
+			if (!chunk_size) {
+				errno = 0;
+				pabort("chunk size must not be 0");
+			}
+			break;
 		case 'l':
 			mode |= SPI_LOOP;
 			break;
@@ -316,10 +442,41 @@ static void parse_opts(int argc, char *argv[])
 		case 'I':
 			iterations = atoi(optarg);
 			break;
+		case 'B':
+			parse_batch(optarg);
+			break;
+		case 'c':
+			cs_change = 1;
+			break;
+		case 'm':
+			lock_buffers = 1;
+			break;
+		case 'r':
+			refresh_tx = 1;
+			break;
+		case 't':
+			trace_file = optarg;
+			break;
+		case 'W':
+			if (num_workers == MAX_WORKERS) {
+				errno = 0;
+				pabort("too many -W devices");
+			}
+			workers[num_workers++].path = optarg;
+			break;
+		case 'T':
+			run_secs = atoi(optarg);
+			break;
 		default:
 			print_usage(argv[0]);
 		}
 	}
+	for (int w = 0; w < num_workers; w++)
+		parse_worker(&workers[w]);
+	if (cs_change && !batch_sizes) {
+		errno = 0;
+		pabort("-c applies to the transfers chained by -B");
+	}
 	if (mode & SPI_LOOP) {
 		if (mode & SPI_TX_DUAL)
 			mode |= SPI_RX_DUAL;
@@ -350,37 +507,58 @@ static void transfer_escaped_string(int fd, char *str)
 	free(tx);
 }
 
-static void transfer_file(int fd, char *filename)
+/*
+ * Benchmark buffers: page aligned, every page touched up front so the
+ * timed loop takes no faults, and with -m locked so it never will.
+ */
+static size_t buf_size(size_t len)
 {
-	ssize_t bytes;
-	struct stat sb;
-	int tx_fd;
-	uint8_t *tx;
-	uint8_t *rx;
+	size_t page = sysconf(_SC_PAGESIZE);
 
-	if (stat(filename, &sb) == -1)
-		pabort("can't stat input file");
+	return len ? (len + page - 1) / page * page : page;
+}
 
-	tx_fd = open(filename, O_RDONLY);
-	if (tx_fd < 0)
-		pabort("can't open input file");
+static void *alloc_buf(size_t len)
+{
+	size_t size = buf_size(len);
+	void *buf;
 
-	tx = malloc(sb.st_size);
-	if (!tx)
-		pabort("can't allocate tx buffer");
+	errno = posix_memalign(&buf, sysconf(_SC_PAGESIZE), size);
+	if (errno)
+		pabort("can't allocate buffer");
+	memset(buf, 0, size);
+	if (lock_buffers && mlock(buf, size))
+		pabort("can't lock buffer (see ulimit -l)");
 
-	rx = malloc(sb.st_size);
-	if (!rx)
-		pabort("can't allocate rx buffer");
+	return buf;
+}
+
+static void free_buf(void *buf, size_t len)
+{
+	if (lock_buffers)
+		munlock(buf, buf_size(len));
+	free(buf);
+}
+
+/*
+ * TX pattern, splitmix64 of a counter: every word is independent of
+ * the others, so the loop vectorizes and costs a fraction of a byte
+ * at a time random(). Writes whole words, buf must be a whole number
+ * of them, which alloc_buf() guarantees.
+ */
+static void fill_pattern(uint8_t *buf, size_t len, uint64_t seed)
+{
+	uint64_t *w = (uint64_t *)buf;
+	size_t n = (len + 7) / 8;
 
-	bytes = read(tx_fd, tx, sb.st_size);
-	if (bytes != sb.st_size)
-		pabort("failed to read input file");
+	seed *= 0x9E3779B97F4A7C15ULL;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t z = seed + (i + 1) * 0x9E3779B97F4A7C15ULL;
 
-	transfer(fd, tx, rx, sb.st_size);
-	free(rx);
-	free(tx);
-	close(tx_fd);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		w[i] = z ^ (z >> 31);
+	}
 }
 
 static uint64_t _read_count;
@@ -394,27 +572,17 @@ static void show_transfer_rate(void)
 	rx_rate = ((_read_count - prev_read_count) * 8) / (interval*1000.0);
 	tx_rate = ((_write_count - prev_write_count) * 8) / (interval*1000.0);
 
-	printf("rate: tx %.1fkbps, rx %.1fkbps\n", rx_rate, tx_rate);
+	printf("rate: tx %.1fkbps, rx %.1fkbps\n", tx_rate, rx_rate);
 
 	prev_read_count = _read_count;
 	prev_write_count = _write_count;
 }
 
-static void transfer_buf(int fd, int len)
+/* one iteration on the buffers main() set up */
+static void transfer_buf(int fd, uint8_t *tx, uint8_t *rx, int len)
 {
-	uint8_t *tx;
-	uint8_t *rx;
-	int i;
-
-	tx = malloc(len);
-	if (!tx)
-		pabort("can't allocate tx buffer");
-	for (i = 0; i < len; i++)
-		tx[i] = random();
-
-	rx = malloc(len);
-	if (!rx)
-		pabort("can't allocate rx buffer");
+	if (refresh_tx)
+		fill_pattern(tx, len, pattern_seed++);
 
 	transfer(fd, tx, rx, len);
 
@@ -429,23 +597,100 @@ static void transfer_buf(int fd, int len)
 			exit(1);
 		}
 	}
+}
 
-	free(rx);
-	free(tx);
+static double elapsed(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
 }
 
-int main(int argc, char *argv[])
+/*
+ * Moves iterations transfers of len bytes, n chained in each
+ * SPI_IOC_MESSAGE(n), and reports how the time splits between the bus
+ * and everything else. tx and rx come from main(), len * n bytes each.
+ */
+static void transfer_batch(int fd, uint8_t *tx, uint8_t *rx, int len,
+			   unsigned int n)
 {
-	int ret = 0;
-	int fd;
-	uint32_t request;
+	struct spi_ioc_transfer *tr;
+	struct timespec start, end;
+	uint64_t ioctls = 0;
+	uint64_t bytes = 0;
+	double secs, wire;
+	int left = iterations;
+	unsigned int i;
+	int ret;
 
-	parse_opts(argc, argv);
+	tr = calloc(n, sizeof(*tr));
+	if (!tr)
+		pabort("can't allocate batch transfers");
+	for (i = 0; i < n; i++) {
+		setup_transfer(&tr[i], tx + i * len, rx + i * len, len);
+		/* on the last segment cs_change would keep CS asserted */
+		tr[i].cs_change = cs_change && i + 1 < n;
+	}
 
-	if (input_tx && input_file)
-		pabort("only one of -p and --input may be selected");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (left > 0) {
+		unsigned int segs = (unsigned int)left < n ? (unsigned int)left : n;
+		uint64_t t0 = 0, t1;
+
+		if (refresh_tx)
+			fill_pattern(tx, (size_t)len * segs, pattern_seed++);
+		/* a short last message ends early, release CS there too */
+		if (segs < n)
+			tr[segs - 1].cs_change = 0;
+		if (trace_file)
+			t0 = spi_trace_now();
+		ret = spi_ioctl(fd, SPI_IOC_MESSAGE(segs), tr);
+		if (ret < 1)
+			pabort("can't send spi message");
+		if (trace_file) {
+			/* one record per segment, all with the ioctl's times */
+			t1 = spi_trace_now();
+			for (i = 0; i < segs; i++)
+				trace_xfer(t0, t1, tx + i * len, rx + i * len, len);
+		}
+		if ((mode & SPI_LOOP) && memcmp(tx, rx, (size_t)len * segs)) {
+			fprintf(stderr, "transfer error !\n");
+			hex_dump(tx, (size_t)len * segs, 32, "TX");
+			hex_dump(rx, (size_t)len * segs, 32, "RX");
+			exit(1);
+		}
+		ioctls++;
+		bytes += (uint64_t)len * segs;
+		left -= segs;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	_write_count += bytes;
+	_read_count += bytes;
+	secs = elapsed(&start, &end);
+	/* clock time of the data alone, delays and CS gaps not counted */
+	wire = speed ? bytes * 8.0 / speed : 0;
+	printf("batch %3u: %8llu ioctls %9.1fKB %8.3fs %10.1fkbps "
+	       "%8.2fus/ioctl %7.2fus/xfer bus %5.1f%%\n",
+	       n, (unsigned long long)ioctls, bytes / 1024.0, secs,
+	       secs > 0 ? bytes * 8 / (secs * 1000.0) : 0.0,
+	       ioctls ? secs * 1e6 / ioctls : 0.0,
+	       iterations ? secs * 1e6 / iterations : 0.0,
+	       secs > 0 ? 100.0 * wire / secs : 0.0);
+
+	free(tr);
+}
 
-	fd = open(device, O_RDWR);
+/*
+ * Opens a device and applies the mode, bits per word and *hz, reading
+ * back what the driver actually took into *dev_mode and *hz.
+ */
+static int open_device(const char *path, uint32_t *dev_mode, uint32_t *hz)
+{
+	uint8_t dev_bits = bits;
+	uint32_t request;
+	int ret;
+	int fd;
+
+	fd = spi_open(path);
 	if (fd < 0)
 		pabort("can't open device");
 
@@ -453,75 +698,462 @@ int main(int argc, char *argv[])
 	 * spi mode
 	 */
 	/* WR is make a request to assign 'mode' */
-	request = mode;
-	ret = ioctl(fd, SPI_IOC_WR_MODE32, &mode);
+	request = *dev_mode;
+	ret = spi_ioctl(fd, SPI_IOC_WR_MODE32, dev_mode);
 	if (ret == -1)
 		pabort("can't set spi mode");
 
 	/* RD is read what mode the device actually is in */
-	ret = ioctl(fd, SPI_IOC_RD_MODE32, &mode);
+	ret = spi_ioctl(fd, SPI_IOC_RD_MODE32, dev_mode);
 	if (ret == -1)
 		pabort("can't get spi mode");
 	/* Drivers can reject some mode bits without returning an error.
 	 * Read the current value to identify what mode it is in, and if it
 	 * differs from the requested mode, warn the user.
 	 */
-	if (request != mode)
-		printf("WARNING device does not support requested mode 0x%x\n",
-			request);
+	if (request != *dev_mode)
+		printf("WARNING %s does not support requested mode 0x%x\n",
+			path, request);
 
 	/*
 	 * bits per word
 	 */
-	ret = ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
+	ret = spi_ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &dev_bits);
 	if (ret == -1)
 		pabort("can't set bits per word");
 
-	ret = ioctl(fd, SPI_IOC_RD_BITS_PER_WORD, &bits);
+	ret = spi_ioctl(fd, SPI_IOC_RD_BITS_PER_WORD, &dev_bits);
 	if (ret == -1)
 		pabort("can't get bits per word");
 
 	/*
 	 * max speed hz
 	 */
-	ret = ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+	ret = spi_ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, hz);
 	if (ret == -1)
 		pabort("can't set max speed hz");
 
-	ret = ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed);
+	ret = spi_ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, hz);
 	if (ret == -1)
 		pabort("can't get max speed hz");
 
+	return fd;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int hist_index(uint64_t v)
+{
+	unsigned int msb;
+
+	if (v < HIST_SUB)
+		return v;
+	msb = 63 - __builtin_clzll(v);
+	return (msb - 2) * HIST_SUB + ((v >> (msb - 3)) & (HIST_SUB - 1));
+}
+
+/* lower bound of the bucket */
+static uint64_t hist_value(unsigned int i)
+{
+	unsigned int msb = i / HIST_SUB + 2;
+
+	if (i < HIST_SUB)
+		return i;
+	return (uint64_t)(HIST_SUB + i % HIST_SUB) << (msb - 3);
+}
+
+/*
+ * Latency at fraction q of the transfers, uS: the upper bound of the
+ * bucket it falls in, so at most 1/HIST_SUB pessimistic, never less
+ * than the truth. The slowest transfer caps it.
+ */
+static double hist_quantile(const struct worker_stats *st, double q)
+{
+	uint64_t want = st->xfers * q, seen = 0, up;
+
+	for (unsigned int i = 0; i + 1 < HIST_SIZE; i++) {
+		seen += st->hist[i];
+		if (seen > want) {
+			up = hist_value(i + 1);
+			return (up < st->lat_max ? up : st->lat_max) / 1000.0;
+		}
+	}
+	return st->lat_max / 1000.0;
+}
+
+/*
+ * Transfers back to back until the phase ends. Below 100% duty each
+ * transfer is followed by a sleep that leaves it duty% of the time.
+ */
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+	struct worker_stats *st = w->st;
+	uint64_t start, t0, t1, lat;
+	struct timespec next;
+	int ret;
+
+	pthread_barrier_wait(&phase_start);
+	start = now_ns();
+	do {
+		if (refresh_tx)
+			fill_pattern(w->tx, w->size, pattern_seed + st->xfers);
+		t0 = now_ns();
+		ret = spi_ioctl(w->fd, SPI_IOC_MESSAGE(1), &w->tr);
+		t1 = now_ns();
+		if (ret < 1)
+			pabort("can't send spi message");
+
+		lat = t1 - t0;
+		st->xfers++;
+		st->bytes += w->size;
+		st->lat_sum += lat;
+		if (lat > st->lat_max)
+			st->lat_max = lat;
+		st->hist[hist_index(lat)]++;
+
+		if (w->duty < 100) {
+			t1 = t0 + lat * 100 / w->duty;
+			next.tv_sec = t1 / 1000000000ULL;
+			next.tv_nsec = t1 % 1000000000ULL;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	} while (t1 < phase_end_ns);
+	st->secs = (now_ns() - start) / 1e9;
+
+	return NULL;
+}
+
+/* runs the given workers together for run_secs */
+static void run_phase(struct worker **set, int n, int shared)
+{
+	pthread_barrier_init(&phase_start, NULL, n + 1);
+	for (int i = 0; i < n; i++) {
+		set[i]->st = shared ? &set[i]->shared : &set[i]->solo;
+		if (pthread_create(&set[i]->thread, NULL, worker_run, set[i]))
+			pabort("can't start worker thread");
+	}
+	phase_end_ns = now_ns() + run_secs * 1000000000ULL;
+	pthread_barrier_wait(&phase_start);
+	for (int i = 0; i < n; i++)
+		pthread_join(set[i]->thread, NULL);
+	pthread_barrier_destroy(&phase_start);
+}
+
+static double kbps(const struct worker_stats *st)
+{
+	return st->secs > 0 ? st->bytes * 8 / (st->secs * 1000.0) : 0.0;
+}
+
+/*
+ * -W: every device alone for a baseline, then all of them at once.
+ * Devices on one controller share its queue, the difference between
+ * the two shows what they cost each other.
+ */
+static void run_workers(void)
+{
+	struct worker *all[MAX_WORKERS];
+	double solo = 0, shared = 0;
+
+	for (int i = 0; i < num_workers; i++) {
+		struct worker *w = &workers[i];
+		uint32_t dev_mode = mode;
+
+		w->fd = open_device(w->path, &dev_mode, &w->speed);
+		w->tx = alloc_buf(w->size);
+		w->rx = alloc_buf(w->size);
+		fill_pattern(w->tx, w->size, pattern_seed++);
+		setup_transfer(&w->tr, w->tx, w->rx, w->size);
+		w->tr.speed_hz = w->speed;
+		all[i] = w;
+		printf("%s: %d bytes at %u Hz, %d%% duty\n", w->path, w->size,
+		       w->speed, w->duty);
+	}
+
+	for (int i = 0; i < num_workers; i++)
+		run_phase(&all[i], 1, 0);
+	run_phase(all, num_workers, 1);
+
+	printf("latency: upper bound of a histogram bucket, within 1/%d\n",
+	       HIST_SUB);
+	printf("%-20s %10s %8s %8s | %11s %8s %8s | %6s\n", "device",
+	       "solo kbps", "p50 us", "p99 us",
+	       "shared kbps", "p50 us", "p99 us", "p99 x");
+	for (int i = 0; i < num_workers; i++) {
+		struct worker *w = &workers[i];
+		double p99 = hist_quantile(&w->solo, 0.99);
+
+		printf("%-20s %10.1f %8.1f %8.1f | %11.1f %8.1f %8.1f | %6.2f\n",
+		       w->path, kbps(&w->solo), hist_quantile(&w->solo, 0.5), p99,
+		       kbps(&w->shared), hist_quantile(&w->shared, 0.5),
+		       hist_quantile(&w->shared, 0.99),
+		       p99 > 0 ? hist_quantile(&w->shared, 0.99) / p99 : 0.0);
+		solo += kbps(&w->solo);
+		shared += kbps(&w->shared);
+	}
+	printf("aggregate: %.1f kbps solo, %.1f kbps shared (%.0f%%)\n",
+	       solo, shared, solo > 0 ? 100.0 * shared / solo : 0.0);
+
+	for (int i = 0; i < num_workers; i++) {
+		free_buf(workers[i].rx, workers[i].size);
+		free_buf(workers[i].tx, workers[i].size);
+		spi_close(workers[i].fd);
+	}
+}
+
+/*
+ * Double buffered output: the transfer fills one rx buffer while this
+ * thread writes the other, so the file write of chunk i overlaps the
+ * SPI transfer of chunk i + 1.
+ */
+struct out_stream {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint8_t *buf[2];
+	size_t len[2];
+	int full[2];
+	int done;
+	double wait; /* seconds the transfer side waited for a buffer */
+};
+
+static void *out_writer(void *arg)
+{
+	struct out_stream *os = arg;
+	int slot = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&os->lock);
+		while (!os->full[slot] && !os->done)
+			pthread_cond_wait(&os->cond, &os->lock);
+		if (!os->full[slot]) {
+			pthread_mutex_unlock(&os->lock);
+			break;
+		}
+		pthread_mutex_unlock(&os->lock);
+
+		if (write(out_fd, os->buf[slot], os->len[slot]) != (ssize_t)os->len[slot])
+			pabort("not all bytes written to output file");
+
+		pthread_mutex_lock(&os->lock);
+		os->full[slot] = 0;
+		pthread_cond_signal(&os->cond);
+		pthread_mutex_unlock(&os->lock);
+		slot ^= 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * Streams a file of any size: the input is mapped, sent straight from
+ * the mapping in chunk_size transfers, and dropped from memory behind
+ * the cursor. Memory use is two rx chunks and DROP_BEHIND of input.
+ */
+static void transfer_file(int fd, char *filename)
+{
+	struct out_stream os = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	struct spi_ioc_transfer tr;
+	struct timespec start, end;
+	pthread_t writer;
+	uint8_t *map = NULL;
+	size_t off, dropped = 0, chunks = 0;
+	uint64_t t0 = 0;
+	struct stat sb;
+	double secs;
+	int tx_fd;
+	int slot = 0;
+	int ret;
+
+	tx_fd = open(filename, O_RDONLY);
+	if (tx_fd < 0)
+		pabort("can't open input file");
+	if (fstat(tx_fd, &sb) == -1)
+		pabort("can't stat input file");
+	if (sb.st_size) {
+		map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, tx_fd, 0);
+		if (map == MAP_FAILED)
+			pabort("can't map input file");
+		madvise(map, sb.st_size, MADV_SEQUENTIAL);
+	}
+
+	os.buf[0] = alloc_buf(chunk_size);
+	os.buf[1] = alloc_buf(chunk_size);
+	if (out_fd >= 0 && pthread_create(&writer, NULL, out_writer, &os))
+		pabort("can't start writer thread");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (off = 0; off < (size_t)sb.st_size; off += tr.len, chunks++) {
+		size_t len = sb.st_size - off < chunk_size ?
+			     sb.st_size - off : chunk_size;
+
+		/* the writer may still be busy with this slot's last chunk */
+		if (out_fd >= 0) {
+			struct timespec w0, w1;
+
+			pthread_mutex_lock(&os.lock);
+			if (os.full[slot]) {
+				clock_gettime(CLOCK_MONOTONIC, &w0);
+				while (os.full[slot])
+					pthread_cond_wait(&os.cond, &os.lock);
+				clock_gettime(CLOCK_MONOTONIC, &w1);
+				os.wait += elapsed(&w0, &w1);
+			}
+			pthread_mutex_unlock(&os.lock);
+		}
+
+		setup_transfer(&tr, map + off, os.buf[slot], len);
+		if (trace_file)
+			t0 = spi_trace_now();
+		ret = spi_ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
+		if (ret < 1)
+			pabort("can't send spi message");
+		if (trace_file)
+			trace_xfer(t0, spi_trace_now(), map + off, os.buf[slot], len);
+		if (verbose) {
+			hex_dump(map + off, len, 32, "TX");
+			hex_dump(os.buf[slot], len, 32, "RX");
+		}
+
+		if (out_fd >= 0) {
+			pthread_mutex_lock(&os.lock);
+			os.len[slot] = len;
+			os.full[slot] = 1;
+			pthread_cond_signal(&os.cond);
+			pthread_mutex_unlock(&os.lock);
+			slot ^= 1;
+		}
+
+		/* page aligned, whole DROP_BEHIND steps */
+		if (off + len - dropped >= 2 * DROP_BEHIND) {
+			madvise(map + dropped, DROP_BEHIND, MADV_DONTNEED);
+			dropped += DROP_BEHIND;
+		}
+	}
+
+	if (out_fd >= 0) {
+		pthread_mutex_lock(&os.lock);
+		os.done = 1;
+		pthread_cond_signal(&os.cond);
+		pthread_mutex_unlock(&os.lock);
+		pthread_join(writer, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = elapsed(&start, &end);
+	printf("file: %lld bytes in %zu chunks of %zu, %.3fs, %.1fkbps",
+	       (long long)sb.st_size, chunks, chunk_size, secs,
+	       secs > 0 ? sb.st_size * 8 / (secs * 1000.0) : 0.0);
+	if (out_fd >= 0)
+		printf(", waited %.3fs for the output", os.wait);
+	printf("\n");
+
+	free_buf(os.buf[1], chunk_size);
+	free_buf(os.buf[0], chunk_size);
+	if (map)
+		munmap(map, sb.st_size);
+	close(tx_fd);
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = 0;
+	int fd;
+
+	parse_opts(argc, argv);
+
+	if (input_tx && input_file)
+		pabort("only one of -p and --input may be selected");
+
+	if (num_workers) {
+		if (trace_file) {
+			errno = 0;
+			pabort("-t traces one device, not -W");
+		}
+		run_workers();
+		return 0;
+	}
+
+	fd = open_device(device, &mode, &speed);
+
 	printf("spi mode: 0x%x\n", mode);
 	printf("bits per word: %u\n", bits);
 	printf("max speed: %u Hz (%u kHz)\n", speed, speed/1000);
 
+	if (output_file) {
+		out_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (out_fd < 0)
+			pabort("could not open output file");
+	}
+
+	if (trace_file && spi_trace_open(&trace, trace_file, mode, bits, speed))
+		pabort("can't open trace file");
+
 	if (input_tx)
 		transfer_escaped_string(fd, input_tx);
 	else if (input_file)
 		transfer_file(fd, input_file);
 	else if (transfer_size) {
 		struct timespec last_stat;
+		unsigned int most = 1;
+		size_t size;
+		uint8_t *tx;
+		uint8_t *rx;
+
+		/* one pair of buffers, big enough for the largest -B */
+		for (int b = 0; b < batch_sizes; b++)
+			if (batch[b] > most)
+				most = batch[b];
+		size = (size_t)transfer_size * most;
+		tx = alloc_buf(size);
+		rx = alloc_buf(size);
+		fill_pattern(tx, size, pattern_seed++);
+
+		if (batch_sizes) {
+			printf("%d transfers of %d bytes%s\n", iterations,
+			       transfer_size,
+			       cs_change ? ", CS released between them" : "");
+			for (int b = 0; b < batch_sizes; b++)
+				transfer_batch(fd, tx, rx, transfer_size, batch[b]);
+		} else {
+			clock_gettime(CLOCK_MONOTONIC, &last_stat);
+			while (iterations-- > 0) {
+				struct timespec current;
 
-		clock_gettime(CLOCK_MONOTONIC, &last_stat);
-
-		while (iterations-- > 0) {
-			struct timespec current;
-
-			transfer_buf(fd, transfer_size);
+				transfer_buf(fd, tx, rx, transfer_size);
 
-			clock_gettime(CLOCK_MONOTONIC, &current);
-			if (current.tv_sec - last_stat.tv_sec > interval) {
-				show_transfer_rate();
-				last_stat = current;
+				clock_gettime(CLOCK_MONOTONIC, &current);
+				if (current.tv_sec - last_stat.tv_sec > interval) {
+					show_transfer_rate();
+					last_stat = current;
+				}
 			}
 		}
 		printf("total: tx %.1fKB, rx %.1fKB\n",
 		       _write_count/1024.0, _read_count/1024.0);
+		free_buf(rx, size);
+		free_buf(tx, size);
 	} else
 		transfer(fd, default_tx, default_rx, sizeof(default_tx));
 
-	close(fd);
+	if (out_fd >= 0)
+		close(out_fd);
+	if (trace_file) {
+		if (spi_trace_close(&trace))
+			pabort("can't write trace file");
+		printf("trace: %llu transfers, %lluKB to %s\n",
+		       (unsigned long long)trace.records,
+		       (unsigned long long)trace.bytes / 1024, trace_file);
+	}
+	spi_close(fd);
 
 	return ret;
 }
@@ -0,0 +1,185 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file alert_line.c
+ * @brief Edge events of a TMP102 ALERT line through the GPIO character
+ *        device (uAPI v2).
+ *
+ * @version 1.0
+ * @resources https://www.kernel.org/doc/html/latest/userspace-api/gpio/chardev.html
+ */
+
+/* Header files */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "alert_line.h"
+
+/* Macro definitions */
+#define SUCCESS               0
+#define FAILURE              -1
+#define MAX_PATH_LEN          64
+#define CONSUMER              "temp_app alert"
+
+/* Function definitions */
+/**
+ * @brief Requests one line of a gpiochip for edge events.
+ *
+ * @param line
+ * @param chip       "gpiochip0", "/dev/gpiochip0" or just "0"
+ * @param offset     line on the chip
+ * @param both_edges also report the alert clearing
+ *
+ * @return int
+ */
+int alert_line_open(struct alert_line *line, const char *chip,
+                    unsigned int offset, bool both_edges)
+{
+    char path[MAX_PATH_LEN] = {0};
+    struct gpio_v2_line_request req;
+    int chip_fd = -1;
+    int ret = FAILURE;
+
+    memset(line, 0, sizeof(*line));
+    line->fd = -1;
+    line->offset = offset;
+
+    if ('/' == chip[0])
+    {
+        snprintf(path, sizeof(path), "%s", chip);
+    }
+    else if ((chip[0] >= '0') && (chip[0] <= '9'))
+    {
+        snprintf(path, sizeof(path), "/dev/gpiochip%s", chip);
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "/dev/%s", chip);
+    }
+    chip_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (FAILURE == chip_fd)
+    {
+        return FAILURE;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = offset;
+    req.num_lines = 1;
+    req.event_buffer_size = ALERT_LINE_EVENTS;
+    snprintf(req.consumer, sizeof(req.consumer), "%s", CONSUMER);
+    /* ALERT is open drain, active low: rising edge = alert raised */
+    req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_ACTIVE_LOW |
+                       GPIO_V2_LINE_FLAG_EDGE_RISING |
+                       GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+    if (both_edges)
+    {
+        req.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    }
+
+    ret = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+    if ((FAILURE == ret) && ((EINVAL == errno) || (EOPNOTSUPP == errno)))
+    {
+        /* not every chip can bias its inputs, rely on an external pull-up */
+        req.config.flags &= ~GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+        ret = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+    }
+    close(chip_fd);
+    if (FAILURE == ret)
+    {
+        return FAILURE;
+    }
+    line->fd = req.fd;
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Releases the line.
+ *
+ * @param line
+ */
+void alert_line_close(struct alert_line *line)
+{
+    if (line->fd >= 0)
+    {
+        close(line->fd);
+    }
+    line->fd = -1;
+}
+
+/**
+ * @brief Sleeps until edges are queued or timeout_ms passes, -1 waits
+ *        forever. A signal ends the wait early.
+ *
+ * @param line
+ * @param timeout_ms
+ * @param events filled with up to max edges
+ * @param max
+ *
+ * @return int edges read, 0 on timeout or signal, -1 on error
+ */
+int alert_line_wait(struct alert_line *line, int timeout_ms,
+                    struct gpio_v2_line_event *events, size_t max)
+{
+    struct pollfd pfd = { .fd = line->fd, .events = POLLIN };
+    ssize_t len = 0;
+    int count = 0;
+
+    if (FAILURE == poll(&pfd, 1, timeout_ms))
+    {
+        return (EINTR == errno) ? 0 : FAILURE;
+    }
+    if (!(pfd.revents & POLLIN))
+    {
+        return 0;
+    }
+
+    /* the kernel hands out whole events only */
+    len = read(line->fd, events, max * sizeof(*events));
+    if (len < 0)
+    {
+        return ((EINTR == errno) || (EAGAIN == errno)) ? 0 : FAILURE;
+    }
+    count = len / sizeof(*events);
+    for (int i = 0; i < count; i++)
+    {
+        line->events++;
+        if (GPIO_V2_LINE_EVENT_RISING_EDGE == events[i].id)
+        {
+            line->activations++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Current logical level of the line.
+ *
+ * @param line
+ *
+ * @return int 1 alert active, 0 inactive, -1 on error
+ */
+int alert_line_active(struct alert_line *line)
+{
+    struct gpio_v2_line_values values = { .mask = 1 };
+
+    if (FAILURE == ioctl(line->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values))
+    {
+        return FAILURE;
+    }
+
+    return (int)(values.bits & 1);
+}
@@ -0,0 +1,51 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file alert_line.h
+ * @brief Edge events of a TMP102 ALERT line through the GPIO character
+ *        device (uAPI v2).
+ *
+ * The line is requested as an active low input, the way the open drain
+ * ALERT output is wired, so a rising edge event means the alert became
+ * active and a falling one that it cleared. Events carry the kernel's
+ * CLOCK_MONOTONIC timestamp of the edge and are queued by the kernel
+ * while the caller sleeps. Any gpiochip works, including gpio-mockup and
+ * gpio-sim, whose lines can be pulled from debugfs or configfs to raise
+ * an alert without a sensor.
+ *
+ * @version 1.0
+ */
+#ifndef ALERT_LINE_H
+#define ALERT_LINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/gpio.h>
+
+#define ALERT_LINE_EVENTS     16      /* kernel event queue depth */
+
+struct alert_line
+{
+    int fd;                     /* line request, -1 when closed */
+    unsigned int offset;        /* line on the chip */
+    uint64_t events;            /* edges seen */
+    uint64_t activations;       /* of which inactive to active */
+};
+
+int alert_line_open(struct alert_line *line, const char *chip,
+                    unsigned int offset, bool both_edges);
+void alert_line_close(struct alert_line *line);
+int alert_line_wait(struct alert_line *line, int timeout_ms,
+                    struct gpio_v2_line_event *events, size_t max);
+int alert_line_active(struct alert_line *line);
+
+#endif /* ALERT_LINE_H */
@@ -0,0 +1,187 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file publish_filter.c
+ * @brief Change driven publishing for one sensor.
+ *
+ * @version 1.0
+ */
+
+/* Header files */
+#include <math.h>
+#include <string.h>
+#include "publish_filter.h"
+
+/* Function definitions */
+/**
+ * @brief Starts with nothing published.
+ *
+ * @param filter
+ */
+void publish_filter_init(struct publish_filter *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+/**
+ * @brief Hands out the span as a message and starts a new one.
+ *
+ * @param filter
+ * @param action
+ * @param out
+ *
+ * @return enum publish_action
+ */
+static enum publish_action publish_filter_emit(struct publish_filter *filter,
+                                               enum publish_action action,
+                                               struct publish_span *out)
+{
+    *out = filter->span;
+    filter->published = true;
+    filter->pending = false;
+    filter->last_value = filter->span.value;
+    filter->last_us = filter->span.timestamp_us;
+    memset(&filter->span, 0, sizeof(filter->span));
+
+    if (PUBLISH_CHANGE == action)
+    {
+        filter->stats.changes++;
+    }
+    else
+    {
+        filter->stats.heartbeats++;
+    }
+
+    return action;
+}
+
+/**
+ * @brief Takes one reading and decides whether it is published now.
+ *
+ * @param filter
+ * @param policy
+ * @param value        celsius
+ * @param timestamp_us when it was read
+ * @param out          the message to send, unless PUBLISH_NONE
+ *
+ * @return enum publish_action
+ */
+enum publish_action publish_filter_offer(struct publish_filter *filter,
+                                         const struct publish_policy *policy,
+                                         float value, uint64_t timestamp_us,
+                                         struct publish_span *out)
+{
+    struct publish_span *span = &filter->span;
+    uint64_t since_us = timestamp_us - filter->last_us;
+    float band = policy->deadband;
+    bool changed = true;
+
+    filter->stats.offered++;
+    if ((0 == span->count) || (value < span->min))
+    {
+        span->min = value;
+    }
+    if ((0 == span->count) || (value > span->max))
+    {
+        span->max = value;
+    }
+    span->sum += value;
+    span->count++;
+    span->value = value;
+    span->timestamp_us = timestamp_us;
+
+    if (!filter->published)
+    {
+        return publish_filter_emit(filter, PUBLISH_CHANGE, out);
+    }
+
+    if (policy->relative * fabsf(filter->last_value) > band)
+    {
+        band = policy->relative * fabsf(filter->last_value);
+    }
+    changed = fabsf(value - filter->last_value) >= band;
+    filter->pending |= changed;
+
+    if (filter->pending && (since_us >= policy->min_interval_us))
+    {
+        return publish_filter_emit(filter, PUBLISH_CHANGE, out);
+    }
+    if (!filter->pending && (0 != policy->max_interval_us) &&
+        (since_us >= policy->max_interval_us))
+    {
+        return publish_filter_emit(filter, PUBLISH_HEARTBEAT, out);
+    }
+
+    /* held back, counted against the policy that did it */
+    filter->held_change = changed;
+    if (changed)
+    {
+        filter->stats.rate_limited++;
+    }
+    else
+    {
+        filter->stats.deadband++;
+    }
+
+    return PUBLISH_NONE;
+}
+
+/**
+ * @brief Publishes a held change once min_interval has passed, or a
+ *        heartbeat for suppressed readings once max_interval has, when no
+ *        new reading comes along to trigger it.
+ *
+ * @param filter
+ * @param policy
+ * @param now_us
+ * @param force  send a held change right away, e.g. at exit
+ * @param out    the message to send, unless PUBLISH_NONE
+ *
+ * @return enum publish_action
+ */
+enum publish_action publish_filter_due(struct publish_filter *filter,
+                                       const struct publish_policy *policy,
+                                       uint64_t now_us, bool force,
+                                       struct publish_span *out)
+{
+    uint64_t since_us = now_us - filter->last_us;
+    enum publish_action action = PUBLISH_NONE;
+
+    if (0 == filter->span.count)
+    {
+        return PUBLISH_NONE;
+    }
+    if (filter->pending && (force || (since_us >= policy->min_interval_us)))
+    {
+        action = PUBLISH_CHANGE;
+    }
+    else if (!filter->pending && !force && (0 != policy->max_interval_us) &&
+             (since_us >= policy->max_interval_us))
+    {
+        action = PUBLISH_HEARTBEAT;
+    }
+    else
+    {
+        return PUBLISH_NONE;
+    }
+
+    /* the latest reading was counted as saved, it goes out after all */
+    if (filter->held_change)
+    {
+        filter->stats.rate_limited--;
+    }
+    else
+    {
+        filter->stats.deadband--;
+    }
+
+    return publish_filter_emit(filter, action, out);
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file publish_filter.h
+ * @brief Change driven publishing: decides which readings of one sensor
+ *        become messages.
+ *
+ * A reading is published when it differs from the last published value
+ * by at least the deadband, the larger of the absolute and the relative
+ * band. A change that arrives sooner than min_interval after the last
+ * message is held, not dropped, and goes out once the interval has
+ * passed. With nothing to report a heartbeat still goes out every
+ * max_interval. Each message carries the min, max and mean of all the
+ * readings it stands for, so short excursions inside a suppressed span
+ * stay visible.
+ *
+ * @version 1.0
+ */
+#ifndef PUBLISH_FILTER_H
+#define PUBLISH_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* What a reading turned into */
+enum publish_action
+{
+    PUBLISH_NONE,               /* suppressed, folded into the span */
+    PUBLISH_CHANGE,             /* moved past the deadband */
+    PUBLISH_HEARTBEAT,          /* max_interval without a message */
+};
+
+struct publish_policy
+{
+    float deadband;             /* celsius, 0 publishes every reading */
+    float relative;             /* fraction of the last published value */
+    uint64_t min_interval_us;   /* 0: no rate limit */
+    uint64_t max_interval_us;   /* 0: no heartbeat */
+};
+
+/* Readings covered by one message */
+struct publish_span
+{
+    float value;                /* latest reading */
+    float min;
+    float max;
+    double sum;
+    uint32_t count;
+    uint64_t timestamp_us;      /* of the latest reading */
+};
+
+struct publish_stats
+{
+    uint64_t offered;           /* readings seen */
+    uint64_t changes;           /* messages for a change */
+    uint64_t heartbeats;        /* messages for max_interval */
+    uint64_t deadband;          /* readings saved by the deadband */
+    uint64_t rate_limited;      /* changes merged by min_interval */
+};
+
+/* Per sensor state, owned by the publishing thread */
+struct publish_filter
+{
+    bool published;             /* anything sent yet */
+    bool pending;               /* a change is held by min_interval */
+    bool held_change;           /* the latest held reading was a change */
+    float last_value;           /* last published value */
+    uint64_t last_us;           /* when it was read */
+    struct publish_span span;   /* since the last message */
+    struct publish_stats stats;
+};
+
+void publish_filter_init(struct publish_filter *filter);
+enum publish_action publish_filter_offer(struct publish_filter *filter,
+                                         const struct publish_policy *policy,
+                                         float value, uint64_t timestamp_us,
+                                         struct publish_span *out);
+enum publish_action publish_filter_due(struct publish_filter *filter,
+                                       const struct publish_policy *policy,
+                                       uint64_t now_us, bool force,
+                                       struct publish_span *out);
+
+#endif /* PUBLISH_FILTER_H */
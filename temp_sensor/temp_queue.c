@@ -0,0 +1,224 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file temp_queue.c
+ * @brief Bounded queue of timestamped temperature readings.
+ *
+ * @version 1.0
+ */
+
+/* Header files */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "temp_queue.h"
+
+/* Macro definitions */
+#define SUCCESS               0
+#define FAILURE              -1
+
+/* Function definitions */
+/**
+ * @brief Allocates the ring storage and initializes the queue.
+ *
+ * @param queue
+ * @param capacity maximum number of buffered readings
+ * @param policy   what to drop when the queue is full
+ *
+ * @return int
+ */
+int temp_queue_init(struct temp_queue *queue, size_t capacity,
+                    enum temp_queue_policy policy)
+{
+    pthread_condattr_t attr;
+
+    if (0 == capacity)
+    {
+        errno = EINVAL;
+        return FAILURE;
+    }
+
+    memset(queue, 0, sizeof(*queue));
+    queue->buffer = calloc(capacity, sizeof(*queue->buffer));
+    if (NULL == queue->buffer)
+    {
+        return FAILURE;
+    }
+    queue->capacity = capacity;
+    queue->policy = policy;
+    queue->wake_level = 1;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    /* flush deadlines are computed on the monotonic clock */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&queue->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Releases the queue storage.
+ *
+ * @param queue
+ */
+void temp_queue_destroy(struct temp_queue *queue)
+{
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->buffer);
+    queue->buffer = NULL;
+}
+
+/**
+ * @brief Adds a reading without ever blocking the producer.
+ *
+ * @param queue
+ * @param reading
+ *
+ * @return bool false if the reading itself was discarded
+ */
+bool temp_queue_push(struct temp_queue *queue,
+                     const struct temp_reading *reading)
+{
+    bool stored = true;
+
+    pthread_mutex_lock(&queue->lock);
+    queue->stats.pushed++;
+    if (queue->count == queue->capacity)
+    {
+        if (QUEUE_DROP_NEWEST == queue->policy)
+        {
+            queue->stats.dropped_newest++;
+            stored = false;
+            goto unlock;
+        }
+        /* overwrite the oldest entry */
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        queue->stats.dropped_oldest++;
+    }
+
+    queue->buffer[(queue->head + queue->count) % queue->capacity] = *reading;
+    queue->count++;
+    if (queue->count > queue->stats.high_watermark)
+    {
+        queue->stats.high_watermark = queue->count;
+    }
+    /* only wake the consumer once a full batch is waiting */
+    if (queue->count == queue->wake_level)
+    {
+        pthread_cond_signal(&queue->cond);
+    }
+
+unlock:
+    pthread_mutex_unlock(&queue->lock);
+    return stored;
+}
+
+/**
+ * @brief Waits until batch_size readings are queued, the flush interval
+ *        expires or the queue is closed, then copies out up to batch_size
+ *        of the oldest readings.
+ *
+ * @param queue
+ * @param out               array of at least batch_size readings
+ * @param batch_size
+ * @param flush_interval_ms
+ *
+ * @return size_t number of readings copied, 0 on an idle flush interval
+ *         or once the queue is closed and drained
+ */
+size_t temp_queue_pop_batch(struct temp_queue *queue,
+                            struct temp_reading *out, size_t batch_size,
+                            unsigned int flush_interval_ms)
+{
+    struct timespec deadline;
+    size_t n = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += flush_interval_ms / 1000;
+    deadline.tv_nsec += (flush_interval_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    queue->wake_level = batch_size < queue->capacity ?
+                        batch_size : queue->capacity;
+    while (!queue->closed && queue->count < queue->wake_level)
+    {
+        if (ETIMEDOUT == pthread_cond_timedwait(&queue->cond, &queue->lock,
+                                                &deadline))
+        {
+            break;
+        }
+    }
+
+    while (n < batch_size && queue->count > 0)
+    {
+        out[n++] = queue->buffer[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+    queue->stats.popped += n;
+    pthread_mutex_unlock(&queue->lock);
+
+    return n;
+}
+
+/**
+ * @brief Wakes the consumer so it can drain what is left and exit.
+ *
+ * @param queue
+ */
+void temp_queue_close(struct temp_queue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Reports whether temp_queue_close() has been called.
+ *
+ * @param queue
+ *
+ * @return bool
+ */
+bool temp_queue_is_closed(struct temp_queue *queue)
+{
+    bool closed;
+
+    pthread_mutex_lock(&queue->lock);
+    closed = queue->closed;
+    pthread_mutex_unlock(&queue->lock);
+    return closed;
+}
+
+/**
+ * @brief Takes a consistent snapshot of the queue counters.
+ *
+ * @param queue
+ * @param stats
+ */
+void temp_queue_get_stats(struct temp_queue *queue,
+                          struct temp_queue_stats *stats)
+{
+    pthread_mutex_lock(&queue->lock);
+    *stats = queue->stats;
+    pthread_mutex_unlock(&queue->lock);
+}
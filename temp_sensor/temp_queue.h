@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file temp_queue.h
+ * @brief Bounded queue of timestamped temperature readings shared between
+ *        the sampling loop and the publisher thread.
+ *
+ * The producer never blocks: when the queue is full the configured policy
+ * either overwrites the oldest reading or discards the new one, and the
+ * matching overflow counter is incremented.
+ *
+ * @version 1.0
+ */
+#ifndef TEMP_QUEUE_H
+#define TEMP_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Overflow policy */
+enum temp_queue_policy
+{
+    QUEUE_DROP_OLDEST,
+    QUEUE_DROP_NEWEST,
+};
+
+/* One sample as produced by the sampling loop */
+struct temp_reading
+{
+    uint64_t timestamp_us;      /* CLOCK_REALTIME at read time */
+    float temperature;          /* degrees celsius */
+    uint16_t sensor;            /* which sensor, application defined */
+};
+
+struct temp_queue_stats
+{
+    uint64_t pushed;            /* readings offered by the producer */
+    uint64_t popped;            /* readings handed to the consumer */
+    uint64_t dropped_oldest;    /* overwritten under QUEUE_DROP_OLDEST */
+    uint64_t dropped_newest;    /* rejected under QUEUE_DROP_NEWEST */
+    size_t high_watermark;      /* deepest fill level seen */
+};
+
+struct temp_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct temp_reading *buffer;
+    size_t capacity;
+    size_t head;                /* oldest entry */
+    size_t count;
+    size_t wake_level;          /* consumer is signalled at this depth */
+    enum temp_queue_policy policy;
+    bool closed;
+    struct temp_queue_stats stats;
+};
+
+int temp_queue_init(struct temp_queue *queue, size_t capacity,
+                    enum temp_queue_policy policy);
+void temp_queue_destroy(struct temp_queue *queue);
+bool temp_queue_push(struct temp_queue *queue,
+                     const struct temp_reading *reading);
+size_t temp_queue_pop_batch(struct temp_queue *queue,
+                            struct temp_reading *out, size_t batch_size,
+                            unsigned int flush_interval_ms);
+void temp_queue_close(struct temp_queue *queue);
+bool temp_queue_is_closed(struct temp_queue *queue);
+void temp_queue_get_stats(struct temp_queue *queue,
+                          struct temp_queue_stats *stats);
+
+#endif /* TEMP_QUEUE_H */
@@ -33,157 +33,870 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
-#include <linux/i2c-dev.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "mqtt_client.h"
+#include "temp_queue.h"
+#include "tmp102.h"
+#include "temp_sensors.h"
+#include "alert_line.h"
+#include "publish_filter.h"
+#include "ts_store.h"
 
 /* Macro definitions */
-#define TMP102_DEVICE_ADDR   0x48
 #define I2C_NODE              1
 #define SUCCESS               0
 #define FAILURE              -1
-#define MAX_BUFF_LEN          5
-#define MAX_STR_LEN           15
-#define MAX_CMD_STR_LEN       100
+#define MQTT_TOPIC            "sensor/temperature"
+#define SAMPLE_INTERVAL_US    100
+#define QUEUE_DEPTH           1024
+#define BATCH_SIZE            16
+#define FLUSH_INTERVAL_MS     1000
+#define T_HIGH_DEFAULT        80.0f   /* TMP102 power-up limits */
+#define T_LOW_DEFAULT         75.0f
+#define HEARTBEAT_S           60
+#define DEADBAND_C            0.0625f /* one TMP102 LSB */
+#define MAX_PUBLISH_S         60
 
 /* Global definitions */
+struct temp_app_config
+{
+    uint8_t i2c_node;
+    uint8_t addr;
+    unsigned int sample_interval_us;
+    size_t queue_depth;
+    size_t batch_size;
+    unsigned int flush_interval_ms;
+    enum temp_queue_policy policy;
+    const char *topic;
+    int qos;
+    struct mqtt_config mqtt;
+    const char *alert_chip;         /* set: sleep on ALERT instead of polling */
+    unsigned int alert_offset;
+    float t_high;
+    float t_low;
+    bool comparator;                /* ALERT follows the limits, no latching */
+    unsigned int heartbeat_s;
+    struct publish_policy publish;
+    struct ts_store_config store;   /* dir set: keep every reading */
+};
 
+static struct temp_app_config config = {
+    .i2c_node = I2C_NODE,
+    .addr = TMP102_ADDR_DEFAULT,
+    .sample_interval_us = SAMPLE_INTERVAL_US,
+    .queue_depth = QUEUE_DEPTH,
+    .batch_size = BATCH_SIZE,
+    .flush_interval_ms = FLUSH_INTERVAL_MS,
+    .policy = QUEUE_DROP_OLDEST,
+    .topic = MQTT_TOPIC,
+    .qos = 0,
+    .t_high = T_HIGH_DEFAULT,
+    .t_low = T_LOW_DEFAULT,
+    .heartbeat_s = HEARTBEAT_S,
+    .publish = {
+        .deadband = DEADBAND_C,
+        .max_interval_us = MAX_PUBLISH_S * 1000000ULL,
+    },
+};
+
+static struct temp_queue reading_queue;
+/* readings carry the sensor's index in sensors.sensor[] */
+static struct temp_sensors sensors;
+static struct alert_line alert = { .fd = -1 };
+static uint64_t heartbeats = 0;
+static struct ts_store store;       /* publisher thread only */
+static const char *const reg_names[] = {
+    [TMP102_REG_TEMP] = "temp",
+    [TMP102_REG_CONFIG] = "config",
+    [TMP102_REG_TLOW] = "tlow",
+    [TMP102_REG_THIGH] = "thigh",
+};
+static volatile sig_atomic_t stop_requested = 0;
 
 /* Function Prototypes */
-static int init_temp_sensor(uint8_t i2c_node);
-static float read_temp_sensor(int file_id);
+static int init_sensors(void);
+static size_t sample_sensors(uint64_t timestamp_us);
+static void alert_loop(void);
+static uint64_t monotonic_us(void);
+static void print_extra_regs(const struct temp_sensor *sensor);
+static void parse_regs(char *list, const char *prog);
+static void parse_sensors(char *list, const char *prog);
+static void parse_alert(char *spec, const char *prog);
+static uint64_t realtime_us(void);
+static int publish_span(struct mqtt_client *mqtt,
+                        const struct temp_sensor *sensor,
+                        const struct publish_span *span);
+static size_t publish_due(struct mqtt_client *mqtt, bool force);
+static void *publisher_thread(void *arg);
+static void signal_handler(int signo);
+static void print_usage(const char *prog);
+static void parse_opts(int argc, char *argv[]);
 
 /* Function definitions */
 /**
- * @brief Initializes Temperature sensor by configuring i2c slave address.
+ * @brief Opens every bus with a sensor on it and prepares the register
+ *        reads taken every sample.
+ *
+ * @return int
+ */
+static int init_sensors(void)
+{
+    /* no -S list: the single sensor given by -n and -a */
+    if (0 == sensors.count)
+    {
+        temp_sensors_add(&sensors, config.i2c_node, config.addr);
+    }
+
+    return temp_sensors_open(&sensors, config.topic);
+}
+
+/**
+ * @brief Prints the extra registers of a sensor's last sample.
+ *
+ * @param sensor
+ */
+static void print_extra_regs(const struct temp_sensor *sensor)
+{
+    bool extended = sensor->reads[0].value & TMP102_TEMP_EM;
+
+    for (size_t i = 1; i <= sensors.extra_regs; i++)
+    {
+        if (TMP102_REG_CONFIG == sensor->reads[i].reg)
+        {
+            printf("  config = 0x%04x\n", sensor->reads[i].value);
+        }
+        else
+        {
+            printf("  %s = %fC\n", reg_names[sensor->reads[i].reg],
+                   tmp102_celsius(sensor->reads[i].value, extended));
+        }
+    }
+}
+
+/**
+ * @brief Reads every sensor and queues the readings of those that
+ *        answered for the publisher.
+ *
+ * @param timestamp_us CLOCK_REALTIME the readings are tagged with
+ *
+ * @return size_t sensors read
+ */
+static size_t sample_sensors(uint64_t timestamp_us)
+{
+    struct temp_reading reading = { .timestamp_us = timestamp_us };
+    size_t good = temp_sensors_poll(&sensors);
+
+    for (size_t i = 0; i < sensors.count; i++)
+    {
+        const struct temp_sensor *sensor = &sensors.sensor[i];
+
+        if (!sensor->valid)
+        {
+            continue;
+        }
+        if (1 == sensors.count)
+        {
+            printf("Temperature value = %fC\n", sensor->temperature);
+        }
+        else
+        {
+            printf("Temperature[%s] = %fC\n", sensor->id,
+                   sensor->temperature);
+        }
+        print_extra_regs(sensor);
+
+        /* never blocks, the publisher thread does the network I/O */
+        reading.sensor = i;
+        reading.temperature = sensor->temperature;
+        temp_queue_push(&reading_queue, &reading);
+    }
+
+    return good;
+}
+
+/**
+ * @brief Sleeps on the ALERT line and reads the sensors when it changes,
+ *        or every heartbeat_s seconds when it does not.
+ */
+static void alert_loop(void)
+{
+    struct gpio_v2_line_event events[ALERT_LINE_EVENTS];
+    uint64_t heartbeat_us = (uint64_t)config.heartbeat_s * 1000000;
+    uint64_t next_us = 0;
+    uint64_t now_us = 0;
+    int timeout_ms = 0;
+    int count = 0;
+
+    printf("Waiting on ALERT %s:%u (%s mode, T_LOW %.4fC, T_HIGH %.4fC), "
+           "line is %s\n", config.alert_chip, config.alert_offset,
+           config.comparator ? "comparator" : "interrupt",
+           config.t_low, config.t_high,
+           (1 == alert_line_active(&alert)) ? "active" : "inactive");
+
+    /* first reading right away, it also clears a latched alert */
+    if (0 == sample_sensors(realtime_us()))
+    {
+        syslog(LOG_ERR, "Error reading temperature value");
+        return;
+    }
+    next_us = monotonic_us() + heartbeat_us;
+
+    while (!stop_requested)
+    {
+        now_us = monotonic_us();
+        timeout_ms = (next_us > now_us) ? (int)((next_us - now_us + 999) / 1000) : 0;
+        count = alert_line_wait(&alert, timeout_ms, events, ALERT_LINE_EVENTS);
+        if (FAILURE == count)
+        {
+            syslog(LOG_ERR, "Error waiting for ALERT: %s", strerror(errno));
+            break;
+        }
+        if (count > 0)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                printf("ALERT %s at %llu.%06llu s\n",
+                       (GPIO_V2_LINE_EVENT_RISING_EDGE == events[i].id) ?
+                       "raised" : "cleared",
+                       (unsigned long long)(events[i].timestamp_ns / 1000000000),
+                       (unsigned long long)(events[i].timestamp_ns / 1000 % 1000000));
+            }
+            /* tag the readings with the wall clock time of the last edge */
+            now_us = monotonic_us();
+            if (0 == sample_sensors(realtime_us() - (now_us -
+                                    events[count - 1].timestamp_ns / 1000)))
+            {
+                syslog(LOG_ERR, "Error reading temperature value");
+                break;
+            }
+        }
+        else if (monotonic_us() >= next_us)
+        {
+            heartbeats++;
+            if (0 == sample_sensors(realtime_us()))
+            {
+                syslog(LOG_ERR, "Error reading temperature value");
+                break;
+            }
+            next_us += heartbeat_us;
+        }
+    }
+}
+
+/**
+ * @brief Monotonic time in microseconds, the clock of GPIO edge events.
  *
- * @param i2c_node
+ * @return uint64_t
+ */
+static uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Wall clock time in microseconds, used to timestamp readings.
+ *
+ * @return uint64_t
+ */
+static uint64_t realtime_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Queues one message for the readings a span stands for.
+ *
+ * @param mqtt
+ * @param sensor
+ * @param span
  *
  * @return int
  */
-static int init_temp_sensor(uint8_t i2c_node)
+static int publish_span(struct mqtt_client *mqtt,
+                        const struct temp_sensor *sensor,
+                        const struct publish_span *span)
+{
+    char temp_MQTT_msg[TEMP_SENSOR_MSG_LEN] = {0};
+    int msg_len = temp_sensors_format(span, temp_MQTT_msg,
+                                      sizeof(temp_MQTT_msg));
+
+    return mqtt_client_publish(mqtt, sensor->topic, temp_MQTT_msg, msg_len,
+                               config.qos);
+}
+
+/**
+ * @brief Sends held changes and heartbeats that have come due without a
+ *        new reading.
+ *
+ * @param mqtt
+ * @param force send every held change now
+ *
+ * @return size_t messages queued
+ */
+static size_t publish_due(struct mqtt_client *mqtt, bool force)
 {
-    char device_path[MAX_STR_LEN] = {0};
-    int file_fd = -1;
-    snprintf(device_path, MAX_STR_LEN, "/dev/i2c-%d", i2c_node);
-    file_fd = open(device_path, O_RDWR);
-    if (FAILURE == file_fd)
+    struct publish_span span;
+    uint64_t now_us = realtime_us();
+    size_t sent = 0;
+
+    for (size_t i = 0; i < sensors.count; i++)
     {
-        syslog(LOG_ERR, "Error opening i2c device %s file: %s", device_path, strerror(errno));
-        goto exit;
+        if (PUBLISH_NONE != publish_filter_due(&sensors.sensor[i].filter,
+                                               &config.publish, now_us,
+                                               force, &span))
+        {
+            publish_span(mqtt, &sensors.sensor[i], &span);
+            sent++;
+        }
     }
-    
-    if (FAILURE == ioctl(file_fd, I2C_SLAVE, TMP102_DEVICE_ADDR))
+
+    return sent;
+}
+
+/**
+ * @brief Drains the reading queue in batches and publishes them over a
+ *        single MQTT connection. A slow or absent broker only delays this
+ *        thread, the sampling loop keeps running. Only readings the
+ *        publish policy lets through become messages.
+ *
+ * @param arg unused
+ *
+ * @return void*
+ */
+static void *publisher_thread(void *arg)
+{
+    struct mqtt_client *mqtt = NULL;
+    struct temp_reading *batch = NULL;
+    struct temp_sensor *sensor = NULL;
+    struct publish_span span;
+    struct publish_stats total = {0};
+    uint64_t max_age_us = 0;
+    size_t count = 0;
+    size_t sent = 0;
+
+    (void)arg;
+    mqtt = malloc(sizeof(*mqtt));
+    batch = calloc(config.batch_size, sizeof(*batch));
+    if ((NULL == mqtt) || (NULL == batch))
     {
-        syslog(LOG_ERR, "Error setting i2c slave address %s", strerror(errno));
-        close(file_fd);
-        file_fd = -1;
+        syslog(LOG_ERR, "Error allocating publisher buffers");
         goto exit;
     }
 
+    mqtt_client_init(mqtt, &config.mqtt);
+    if (!mqtt_client_connected(mqtt))
+    {
+        syslog(LOG_WARNING, "MQTT broker %s:%u not reachable, will retry",
+               config.mqtt.host, config.mqtt.port);
+    }
+
+    while (true)
+    {
+        count = temp_queue_pop_batch(&reading_queue, batch, config.batch_size,
+                                     config.flush_interval_ms);
+        if (0 == count)
+        {
+            if (temp_queue_is_closed(&reading_queue))
+            {
+                break;
+            }
+            /* flush interval expired with nothing queued */
+            if (publish_due(mqtt, false) > 0)
+            {
+                mqtt_client_flush(mqtt);
+            }
+            mqtt_client_poll(mqtt, 0);
+            continue;
+        }
+
+        sent = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t age_us = realtime_us() - batch[i].timestamp_us;
+            if (age_us > max_age_us)
+            {
+                max_age_us = age_us;
+            }
+            sensor = &sensors.sensor[batch[i].sensor];
+            /* the store keeps what the deadband holds back */
+            if ((NULL != config.store.dir) &&
+                (FAILURE == ts_store_append(&store, batch[i].timestamp_us,
+                                            (sensor->node << 8) | sensor->addr,
+                                            TS_KIND_TEMP, batch[i].temperature)))
+            {
+                syslog(LOG_ERR, "Error appending to store %s: %s",
+                       config.store.dir, strerror(errno));
+            }
+            if (PUBLISH_NONE != publish_filter_offer(&sensor->filter,
+                                                     &config.publish,
+                                                     batch[i].temperature,
+                                                     batch[i].timestamp_us,
+                                                     &span))
+            {
+                publish_span(mqtt, sensor, &span);
+                sent++;
+            }
+        }
+        sent += publish_due(mqtt, false);
+        if (0 == sent)
+        {
+            continue;
+        }
+
+        /* one write for the whole batch */
+        if (mqtt_client_flush(mqtt))
+        {
+            printf("Error sending %zu messages to MQTT server\n", sent);
+        }
+        else
+        {
+            printf("Sent %zu messages for %zu Temperature readings to MQTT server\n",
+                   sent, count);
+        }
+    }
+
+    /* changes still held by the rate limit are not lost at exit */
+    if (publish_due(mqtt, true) > 0)
+    {
+        mqtt_client_flush(mqtt);
+    }
+    for (size_t i = 0; i < sensors.count; i++)
+    {
+        const struct publish_stats *st = &sensors.sensor[i].filter.stats;
+
+        total.offered += st->offered;
+        total.changes += st->changes;
+        total.heartbeats += st->heartbeats;
+        total.deadband += st->deadband;
+        total.rate_limited += st->rate_limited;
+    }
+    printf("publish: %llu readings, %llu change and %llu heartbeat messages, "
+           "saved %llu by deadband and %llu by rate limit\n",
+           (unsigned long long)total.offered,
+           (unsigned long long)total.changes,
+           (unsigned long long)total.heartbeats,
+           (unsigned long long)total.deadband,
+           (unsigned long long)total.rate_limited);
+
+    printf("Oldest reading waited %llu us in the queue\n",
+           (unsigned long long)max_age_us);
+    mqtt_client_print_stats(mqtt, "mqtt");
+    mqtt_client_close(mqtt);
+
 exit:
-    return file_fd;
+    free(batch);
+    free(mqtt);
+    return NULL;
 }
 
 /**
- * @brief Initializes Temperature sensor by configuring i2c slave address.
+ * @brief Requests a clean shutdown on SIGINT/SIGTERM.
  *
- * @param file_id
+ * @param signo
+ */
+static void signal_handler(int signo)
+{
+    (void)signo;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Prints command line usage and exits.
  *
- * @return float
+ * @param prog
  */
-static float read_temp_sensor(int file_id)
+static void print_usage(const char *prog)
 {
-    char buffer[MAX_BUFF_LEN] = {0};
-    float temperature_value = 0;
-    uint8_t buffer_len = 0;
-    
-    /* Write temp register value */
-    buffer[0] = 0x00;
-    buffer_len = 1;
-    if (buffer_len != write(file_id, buffer, buffer_len))
+    printf("Usage: %s [options] [i2c_node]\n", prog);
+    puts("  -n --node       i2c bus number (default 1)\n"
+         "  -a --addr       TMP102 address 0x48..0x4b (default 0x48)\n"
+         "  -S --sensors    bus:addr pairs to poll, e.g. 1:0x48,1:0x49,2:0x48\n"
+         "                  (default: the one set by -n and -a)\n"
+         "  -R --regs       registers read along with the temperature,\n"
+         "                  e.g. config,tlow,thigh (default none)\n"
+         "  -i --interval   sampling interval in usec (default 100)\n"
+         "  -m --mqtt       MQTT broker host[:port] (default localhost:1883)\n"
+         "  -T --topic      MQTT topic (default " MQTT_TOPIC ")\n"
+         "  -q --qos        MQTT QoS level 0 or 1 (default 0)\n"
+         "  -Q --queue      readings buffered for the publisher (default 1024)\n"
+         "  -B --batch      readings published per batch (default 16)\n"
+         "  -F --flush      max msec before a partial batch is sent (default 1000)\n"
+         "  -P --policy     on overflow drop 'oldest' or 'newest' (default oldest)\n"
+         "  -d --deadband   celsius change needed to publish, 0 publishes every\n"
+         "                  reading (default 0.0625)\n"
+         "  -r --relative   change needed as a % of the last published value,\n"
+         "                  the larger band applies (default 0)\n"
+         "  -x --min-gap    min msec between messages of a sensor (default 0)\n"
+         "  -X --max-gap    max sec between messages of a sensor, 0 never\n"
+         "                  (default 60)\n"
+         "  -A --alert      chip:line of the ALERT pin, e.g. gpiochip0:17; read\n"
+         "                  on alert and heartbeat instead of every interval\n"
+         "  -H --high       T_HIGH in celsius (default 80)\n"
+         "  -L --low        T_LOW in celsius (default 75)\n"
+         "  -M --comparator ALERT in comparator mode (default interrupt mode)\n"
+         "  -b --heartbeat  sec between reads without an alert (default 60)\n"
+         "  -s --store      keep every reading in a time-series store,\n"
+         "                  dir[:seg=MB,keep=N,flush=ms,...], see ts_store.h\n");
+    exit(1);
+}
+
+/**
+ * @brief Parses a comma separated list of register names into
+ *        sensors.extra_reg.
+ *
+ * @param list
+ * @param prog
+ */
+static void parse_regs(char *list, const char *prog)
+{
+    char *save = NULL;
+    char *name = NULL;
+    size_t reg = 0;
+
+    sensors.extra_regs = 0;
+    for (name = strtok_r(list, ",", &save); NULL != name;
+         name = strtok_r(NULL, ",", &save))
     {
-        syslog(LOG_ERR, "Error writing to i2c device %s", 
-               strerror(errno));
-        return FAILURE;       
+        for (reg = TMP102_REG_CONFIG; reg <= TMP102_REG_THIGH; reg++)
+        {
+            if (0 == strcmp(name, reg_names[reg]))
+            {
+                break;
+            }
+        }
+        if ((reg > TMP102_REG_THIGH) || (TEMP_SENSORS_MAX_REGS == sensors.extra_regs))
+        {
+            print_usage(prog);
+        }
+        sensors.extra_reg[sensors.extra_regs++] = reg;
     }
-    
-    /* Read temperature value */
-    buffer_len = 2;
-    if (buffer_len != read(file_id, buffer, buffer_len))
+}
+
+/**
+ * @brief Parses a comma separated list of bus:addr pairs into sensors.
+ *
+ * @param list
+ * @param prog
+ */
+static void parse_sensors(char *list, const char *prog)
+{
+    if (FAILURE == temp_sensors_parse(&sensors, list))
     {
-        syslog(LOG_ERR, "Error reading from i2c device %s", 
-               strerror(errno));
-        return FAILURE;     
+        print_usage(prog);
     }
-    /* Read 12-bit temp value */
-    temperature_value = ((buffer[0] << 4) | (buffer[1] >> 4));
-    /* convert to celsius */
-    temperature_value *= 0.0625;
-    
-    return temperature_value;
 }
 
 /**
- * @brief Initializes Temperature sensor by configuring i2c slave address.
+ * @brief Parses chip:line of the ALERT pin.
  *
- * @param i2c_node
+ * @param spec
+ * @param prog
+ */
+static void parse_alert(char *spec, const char *prog)
+{
+    if (FAILURE == temp_sensors_parse_alert(spec, &config.alert_chip,
+                                            &config.alert_offset))
+    {
+        print_usage(prog);
+    }
+}
+
+/**
+ * @brief Parses command line options into config.
  *
- * @return int
+ * @param argc
+ * @param argv
  */
-int main(int argc, char *argv[])
+static void parse_opts(int argc, char *argv[])
 {
-    uint8_t i2c_node = I2C_NODE;
-    int file_id = -1;
-    float temperature_value = 0;
-    char temp_MQTT_cmd[MAX_CMD_STR_LEN] = {0};
-    int return_value = -1;
+    static const struct option lopts[] = {
+        { "node",     1, 0, 'n' },
+        { "addr",     1, 0, 'a' },
+        { "regs",     1, 0, 'R' },
+        { "sensors",  1, 0, 'S' },
+        { "alert",    1, 0, 'A' },
+        { "high",     1, 0, 'H' },
+        { "low",      1, 0, 'L' },
+        { "comparator", 0, 0, 'M' },
+        { "heartbeat", 1, 0, 'b' },
+        { "deadband", 1, 0, 'd' },
+        { "relative", 1, 0, 'r' },
+        { "min-gap",  1, 0, 'x' },
+        { "max-gap",  1, 0, 'X' },
+        { "interval", 1, 0, 'i' },
+        { "mqtt",     1, 0, 'm' },
+        { "topic",    1, 0, 'T' },
+        { "qos",      1, 0, 'q' },
+        { "queue",    1, 0, 'Q' },
+        { "batch",    1, 0, 'B' },
+        { "flush",    1, 0, 'F' },
+        { "policy",   1, 0, 'P' },
+        { "store",    1, 0, 's' },
+        { NULL, 0, 0, 0 },
+    };
+    int c;
 
-    if (argc > 2)
+    while (-1 != (c = getopt_long(argc, argv, "n:a:R:S:i:m:T:q:Q:B:F:P:A:H:L:Mb:d:r:x:X:s:", lopts, NULL)))
     {
-        i2c_node = atoi(argv[1]);
-        syslog(LOG_DEBUG, "Configured i2c_node = %d", i2c_node);
+        switch (c)
+        {
+        case 'n':
+            config.i2c_node = atoi(optarg);
+            break;
+        case 'a':
+            config.addr = strtoul(optarg, NULL, 0);
+            if ((config.addr < TMP102_ADDR_MIN) || (config.addr > TMP102_ADDR_MAX))
+            {
+                print_usage(argv[0]);
+            }
+            break;
+        case 'R':
+            parse_regs(optarg, argv[0]);
+            break;
+        case 'S':
+            parse_sensors(optarg, argv[0]);
+            break;
+        case 'i':
+            config.sample_interval_us = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (FAILURE == mqtt_parse_broker(&config.mqtt, optarg))
+            {
+                print_usage(argv[0]);
+            }
+            break;
+        case 'T':
+            config.topic = optarg;
+            break;
+        case 'q':
+            config.qos = atoi(optarg);
+            if ((config.qos < 0) || (config.qos > 1))
+            {
+                print_usage(argv[0]);
+            }
+            break;
+        case 'Q':
+            config.queue_depth = strtoul(optarg, NULL, 0);
+            break;
+        case 'B':
+            config.batch_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'F':
+            config.flush_interval_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            if (0 == strcmp(optarg, "oldest"))
+            {
+                config.policy = QUEUE_DROP_OLDEST;
+            }
+            else if (0 == strcmp(optarg, "newest"))
+            {
+                config.policy = QUEUE_DROP_NEWEST;
+            }
+            else
+            {
+                print_usage(argv[0]);
+            }
+            break;
+        case 'A':
+            parse_alert(optarg, argv[0]);
+            break;
+        case 'H':
+            config.t_high = strtof(optarg, NULL);
+            break;
+        case 'L':
+            config.t_low = strtof(optarg, NULL);
+            break;
+        case 'M':
+            config.comparator = true;
+            break;
+        case 'b':
+            config.heartbeat_s = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            config.publish.deadband = strtof(optarg, NULL);
+            break;
+        case 'r':
+            config.publish.relative = strtof(optarg, NULL) / 100.0f;
+            break;
+        case 'x':
+            config.publish.min_interval_us = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        case 'X':
+            config.publish.max_interval_us = strtoull(optarg, NULL, 0) * 1000000;
+            break;
+        case 's':
+            if (FAILURE == ts_store_parse(&config.store, optarg))
+            {
+                print_usage(argv[0]);
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            break;
+        }
     }
-    
-    file_id = init_temp_sensor(i2c_node);
-    if (FAILURE == file_id)
+
+    /* legacy form: temp_app <i2c_node> */
+    if (optind < argc)
+    {
+        config.i2c_node = atoi(argv[optind]);
+    }
+    if ((0 == config.queue_depth) || (0 == config.batch_size) ||
+        (config.t_low >= config.t_high) || (0 == config.heartbeat_s) ||
+        (config.publish.deadband < 0) || (config.publish.relative < 0))
+    {
+        print_usage(argv[0]);
+    }
+    syslog(LOG_DEBUG, "Configured i2c_node = %d", config.i2c_node);
+}
+
+/**
+ * @brief Samples every temperature sensor and hands readings to the
+ *        publisher thread through a bounded queue.
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return int
+ */
+int main(int argc, char *argv[])
+{
+    struct temp_queue_stats stats = {0};
+    struct sigaction action = {0};
+    pthread_t publisher;
+
+    mqtt_config_default(&config.mqtt);
+    config.mqtt.client_id = "temp_app";
+    ts_store_config_default(&config.store);
+    parse_opts(argc, argv);
+
+    if (FAILURE == init_sensors())
     {
         syslog(LOG_ERR, "Error initializing i2c device");
+        temp_sensors_close(&sensors);
         return FAILURE;   
     }
+
+    if ((NULL != config.alert_chip) &&
+        (FAILURE == temp_sensors_program_alerts(&sensors, config.t_low,
+                                                config.t_high,
+                                                config.comparator)))
+    {
+        temp_sensors_close(&sensors);
+        return FAILURE;
+    }
+    if ((NULL != config.alert_chip) &&
+        (FAILURE == alert_line_open(&alert, config.alert_chip,
+                                    config.alert_offset, config.comparator)))
+    {
+        syslog(LOG_ERR, "Error requesting ALERT line %s:%u: %s",
+               config.alert_chip, config.alert_offset, strerror(errno));
+        temp_sensors_close(&sensors);
+        return FAILURE;
+    }
+
+    if (FAILURE == temp_queue_init(&reading_queue, config.queue_depth,
+                                   config.policy))
+    {
+        syslog(LOG_ERR, "Error allocating reading queue %s", strerror(errno));
+        alert_line_close(&alert);
+        temp_sensors_close(&sensors);
+        return FAILURE;
+    }
+
+    if ((NULL != config.store.dir) &&
+        (FAILURE == ts_store_open(&store, &config.store)))
+    {
+        syslog(LOG_ERR, "Error opening store %s: %s", config.store.dir,
+               strerror(errno));
+        temp_queue_destroy(&reading_queue);
+        alert_line_close(&alert);
+        temp_sensors_close(&sensors);
+        return FAILURE;
+    }
+
+    action.sa_handler = signal_handler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if (0 != pthread_create(&publisher, NULL, publisher_thread, NULL))
+    {
+        syslog(LOG_ERR, "Error creating publisher thread");
+        if (NULL != config.store.dir)
+        {
+            ts_store_close(&store);
+        }
+        temp_queue_destroy(&reading_queue);
+        alert_line_close(&alert);
+        temp_sensors_close(&sensors);
+        return FAILURE;
+    }
     
-    while (true)
+    if (NULL != config.alert_chip)
+    {
+        alert_loop();
+    }
+    /* a sensor that fails is skipped, all of them failing ends the run */
+    while ((NULL == config.alert_chip) && !stop_requested)
     {
-        temperature_value = read_temp_sensor(file_id);
-        if (FAILURE == temperature_value)
+        if (0 == sample_sensors(realtime_us()))
         {
             syslog(LOG_ERR, "Error reading temperature value");
-            goto exit;
+            break;
         }
         
-        printf("Temperature value = %fC\n", temperature_value);
-
-        // command to send temperature data to MQTT server
-	    snprintf(temp_MQTT_cmd, sizeof(temp_MQTT_cmd), "python3 /bin/MQTT/client.py Temperature:%fC",temperature_value);
-
-        // execute the MQTT client python application
-	    return_value = system(temp_MQTT_cmd);
-
-	    if(return_value)
-	    {
-	        printf("Error sending data to MQTT server %d\n", return_value);
-			break;
-	    }
-	    else
-	    {
-	        printf("Sent Temperature data to MQTT server\n");
-	    }
-        
-        usleep(100);
+        usleep(config.sample_interval_us);
     }
 
-exit:
-    close(file_id);
-    return 0;
-}
+    temp_queue_close(&reading_queue);
+    pthread_join(publisher, NULL);
 
+    temp_queue_get_stats(&reading_queue, &stats);
+    printf("queue: pushed %llu, published %llu, dropped oldest %llu, "
+           "dropped newest %llu, high watermark %zu/%zu\n",
+           (unsigned long long)stats.pushed,
+           (unsigned long long)stats.popped,
+           (unsigned long long)stats.dropped_oldest,
+           (unsigned long long)stats.dropped_newest,
+           stats.high_watermark, config.queue_depth);
 
+    for (size_t i = 0; i < sensors.bus_count; i++)
+    {
+        printf("i2c-%d: %llu transfers\n", sensors.bus[i].bus.node,
+               (unsigned long long)sensors.bus[i].bus.transfers);
+    }
+    for (size_t i = 0; i < sensors.count; i++)
+    {
+        printf("sensor %s: %llu samples, %llu errors\n", sensors.sensor[i].id,
+               (unsigned long long)sensors.sensor[i].samples,
+               (unsigned long long)sensors.sensor[i].errors);
+    }
 
+    if (NULL != config.alert_chip)
+    {
+        printf("alert: %llu edges, %llu activations, %llu heartbeats\n",
+               (unsigned long long)alert.events,
+               (unsigned long long)alert.activations,
+               (unsigned long long)heartbeats);
+    }
+
+    if (NULL != config.store.dir)
+    {
+        ts_store_print_stats(&store, "store");
+        ts_store_close(&store);
+    }
+
+    temp_queue_destroy(&reading_queue);
+    alert_line_close(&alert);
+    temp_sensors_close(&sensors);
+    return 0;
+}
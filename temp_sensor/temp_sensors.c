@@ -0,0 +1,405 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file temp_sensors.c
+ * @brief A set of TMP102 sensors on one or more i2c buses.
+ *
+ * @version 1.0
+ * @resources https://www.ti.com/product/TMP102
+ */
+
+/* Header files */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include "temp_sensors.h"
+
+/* Macro definitions */
+#define SUCCESS               0
+#define FAILURE              -1
+
+/* Function definitions */
+/**
+ * @brief Orders sensors by bus, then address.
+ *
+ * @param a
+ * @param b
+ *
+ * @return int
+ */
+static int compare_sensors(const void *a, const void *b)
+{
+    const struct temp_sensor *sa = a;
+    const struct temp_sensor *sb = b;
+
+    if (sa->node != sb->node)
+    {
+        return sa->node - sb->node;
+    }
+    return sa->addr - sb->addr;
+}
+
+/**
+ * @brief Adds one sensor to the set, before temp_sensors_open().
+ *
+ * @param sensors
+ * @param node i2c bus number
+ * @param addr
+ *
+ * @return int
+ */
+int temp_sensors_add(struct temp_sensors *sensors, uint8_t node, uint8_t addr)
+{
+    if ((TEMP_SENSORS_MAX == sensors->count) || (addr < TMP102_ADDR_MIN) ||
+        (addr > TMP102_ADDR_MAX))
+    {
+        errno = EINVAL;
+        return FAILURE;
+    }
+    sensors->sensor[sensors->count].node = node;
+    sensors->sensor[sensors->count].addr = addr;
+    sensors->count++;
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Parses a comma separated list of bus:addr pairs into the set,
+ *        replacing what it held.
+ *
+ * @param sensors
+ * @param list
+ *
+ * @return int
+ */
+int temp_sensors_parse(struct temp_sensors *sensors, char *list)
+{
+    char *save = NULL;
+    char *pair = NULL;
+    char *end = NULL;
+    unsigned long node = 0;
+    unsigned long addr = 0;
+
+    sensors->count = 0;
+    for (pair = strtok_r(list, ",", &save); NULL != pair;
+         pair = strtok_r(NULL, ",", &save))
+    {
+        node = strtoul(pair, &end, 0);
+        if ((':' != *end) || (node > UINT8_MAX))
+        {
+            errno = EINVAL;
+            return FAILURE;
+        }
+        addr = strtoul(end + 1, &end, 0);
+        if (('\0' != *end) || (addr > UINT8_MAX) ||
+            (FAILURE == temp_sensors_add(sensors, node, addr)))
+        {
+            errno = EINVAL;
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Parses chip:line of the ALERT pin, spec keeps the chip name.
+ *
+ * @param spec
+ * @param chip
+ * @param offset
+ *
+ * @return int
+ */
+int temp_sensors_parse_alert(char *spec, const char **chip,
+                             unsigned int *offset)
+{
+    char *colon = strrchr(spec, ':');
+    char *end = NULL;
+
+    if ((NULL == colon) || (colon == spec) || ('\0' == colon[1]))
+    {
+        errno = EINVAL;
+        return FAILURE;
+    }
+    *offset = strtoul(colon + 1, &end, 0);
+    if ('\0' != *end)
+    {
+        errno = EINVAL;
+        return FAILURE;
+    }
+    *colon = '\0';
+    *chip = spec;
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Opens every bus with a sensor on it and prepares the register
+ *        reads taken every sample.
+ *
+ * @param sensors
+ * @param topic base topic, one subtopic per sensor when there are more
+ *
+ * @return int
+ */
+int temp_sensors_open(struct temp_sensors *sensors, const char *topic)
+{
+    struct tmp102_read *reads = sensors->reads;
+
+    sensors->bus_count = 0;
+    qsort(sensors->sensor, sensors->count, sizeof(sensors->sensor[0]),
+          compare_sensors);
+
+    for (size_t i = 0; i < sensors->count; i++)
+    {
+        struct temp_sensor *sensor = &sensors->sensor[i];
+
+        if ((i > 0) && (0 == compare_sensors(sensor, sensor - 1)))
+        {
+            syslog(LOG_ERR, "Sensor %d:0x%02x listed twice", sensor->node,
+                   sensor->addr);
+            errno = EINVAL;
+            return FAILURE;
+        }
+        snprintf(sensor->id, sizeof(sensor->id), "%d-%04x", sensor->node,
+                 sensor->addr);
+        /* one topic per sensor once more than one is polled */
+        if (sensors->count > 1)
+        {
+            snprintf(sensor->topic, sizeof(sensor->topic), "%s/%d-%04x",
+                     topic, sensor->node, sensor->addr);
+        }
+        else
+        {
+            snprintf(sensor->topic, sizeof(sensor->topic), "%s", topic);
+        }
+
+        publish_filter_init(&sensor->filter);
+        sensor->valid = false;
+        sensor->samples = 0;
+        sensor->errors = 0;
+        sensor->reads = reads;
+        reads[0].addr = sensor->addr;
+        reads[0].reg = TMP102_REG_TEMP;
+        for (size_t r = 0; r < sensors->extra_regs; r++)
+        {
+            reads[1 + r].addr = sensor->addr;
+            reads[1 + r].reg = sensors->extra_reg[r];
+        }
+        reads += 1 + sensors->extra_regs;
+
+        /* sorted, so a new bus starts wherever the node changes */
+        if ((0 == sensors->bus_count) ||
+            (sensors->bus[sensors->bus_count - 1].bus.node != sensor->node))
+        {
+            struct temp_bus *bus = &sensors->bus[sensors->bus_count];
+
+            if (FAILURE == tmp102_bus_open(&bus->bus, sensor->node))
+            {
+                syslog(LOG_ERR, "Error opening i2c device /dev/i2c-%d: %s",
+                       sensor->node, strerror(errno));
+                return FAILURE;
+            }
+            if (!bus->bus.combined)
+            {
+                syslog(LOG_WARNING, "i2c-%d has no I2C_RDWR, using SMBus reads",
+                       sensor->node);
+            }
+            bus->first = i;
+            bus->count = 0;
+            sensors->bus_count++;
+        }
+        sensors->bus[sensors->bus_count - 1].count++;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Closes every bus.
+ *
+ * @param sensors
+ */
+void temp_sensors_close(struct temp_sensors *sensors)
+{
+    for (size_t i = 0; i < sensors->bus_count; i++)
+    {
+        tmp102_bus_close(&sensors->bus[i].bus);
+    }
+    sensors->bus_count = 0;
+}
+
+/**
+ * @brief Reads the temperature, and any extra registers, of every sensor
+ *        on one bus in one combined transaction. If that fails the
+ *        sensors are read one by one, so one missing device does not
+ *        silence the others.
+ *
+ * @param sensors
+ * @param bus
+ *
+ * @return size_t sensors read
+ */
+size_t temp_sensors_read_bus(struct temp_sensors *sensors, struct temp_bus *bus)
+{
+    struct temp_sensor *first = &sensors->sensor[bus->first];
+    size_t per_sensor = 1 + sensors->extra_regs;
+    size_t good = 0;
+
+    if (SUCCESS == tmp102_read_regs(&bus->bus, first->reads,
+                                    bus->count * per_sensor))
+    {
+        for (size_t i = 0; i < bus->count; i++)
+        {
+            first[i].valid = true;
+        }
+        good = bus->count;
+    }
+    else
+    {
+        for (size_t i = 0; i < bus->count; i++)
+        {
+            first[i].valid = (bus->count > 1) &&
+                             (SUCCESS == tmp102_read_regs(&bus->bus,
+                                                          first[i].reads,
+                                                          per_sensor));
+            if (!first[i].valid)
+            {
+                syslog(LOG_ERR, "Error reading from i2c device %s: %s",
+                       first[i].id, strerror(errno));
+                first[i].errors++;
+                continue;
+            }
+            good++;
+        }
+    }
+
+    for (size_t i = 0; i < bus->count; i++)
+    {
+        if (first[i].valid)
+        {
+            first[i].temperature = tmp102_celsius(first[i].reads[0].value,
+                                                  first[i].reads[0].value &
+                                                  TMP102_TEMP_EM);
+            first[i].samples++;
+        }
+    }
+
+    return good;
+}
+
+/**
+ * @brief Reads every sensor, one bus after the other.
+ *
+ * @param sensors
+ *
+ * @return size_t sensors read
+ */
+size_t temp_sensors_poll(struct temp_sensors *sensors)
+{
+    size_t good = 0;
+
+    for (size_t i = 0; i < sensors->bus_count; i++)
+    {
+        good += temp_sensors_read_bus(sensors, &sensors->bus[i]);
+    }
+
+    return good;
+}
+
+/**
+ * @brief Programs T_HIGH, T_LOW and the thermostat mode of every sensor,
+ *        keeping the rest of its configuration.
+ *
+ * @param sensors
+ * @param t_low celsius
+ * @param t_high celsius
+ * @param comparator ALERT follows the limits, no latching
+ *
+ * @return int
+ */
+int temp_sensors_program_alerts(struct temp_sensors *sensors, float t_low,
+                                float t_high, bool comparator)
+{
+    for (size_t b = 0; b < sensors->bus_count; b++)
+    {
+        struct temp_bus *tb = &sensors->bus[b];
+        struct tmp102_bus *bus = &tb->bus;
+
+        for (size_t i = tb->first; i < tb->first + tb->count; i++)
+        {
+            struct temp_sensor *sensor = &sensors->sensor[i];
+            struct tmp102_read cfg = { .addr = sensor->addr,
+                                       .reg = TMP102_REG_CONFIG };
+            bool extended = false;
+            uint16_t value = 0;
+
+            if (FAILURE == tmp102_read_regs(bus, &cfg, 1))
+            {
+                syslog(LOG_ERR, "Error reading config of %s: %s",
+                       sensor->id, strerror(errno));
+                return FAILURE;
+            }
+            extended = cfg.value & TMP102_CFG_EM;
+            /* active low ALERT, open drain outputs can share one line */
+            value = cfg.value & ~(TMP102_CFG_TM | TMP102_CFG_POL | TMP102_CFG_AL);
+            if (!comparator)
+            {
+                value |= TMP102_CFG_TM;
+            }
+            if ((FAILURE == tmp102_write_reg(bus, sensor->addr, TMP102_REG_TLOW,
+                                             tmp102_limit(t_low, extended))) ||
+                (FAILURE == tmp102_write_reg(bus, sensor->addr, TMP102_REG_THIGH,
+                                             tmp102_limit(t_high, extended))) ||
+                (FAILURE == tmp102_write_reg(bus, sensor->addr,
+                                             TMP102_REG_CONFIG, value)))
+            {
+                syslog(LOG_ERR, "Error programming alert of %s: %s",
+                       sensor->id, strerror(errno));
+                return FAILURE;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Formats the message for the readings a span stands for. A span
+ *        of one reading keeps the plain "Temperature:<value>C" payload.
+ *
+ * @param span
+ * @param buf
+ * @param len
+ *
+ * @return int payload length
+ */
+int temp_sensors_format(const struct publish_span *span, char *buf, size_t len)
+{
+    int msg_len = 0;
+
+    if (1 == span->count)
+    {
+        msg_len = snprintf(buf, len, "Temperature:%fC", span->value);
+    }
+    else
+    {
+        msg_len = snprintf(buf, len,
+                           "Temperature:%fC,min:%f,max:%f,mean:%f,n:%u",
+                           span->value, span->min, span->max,
+                           span->sum / span->count, span->count);
+    }
+
+    return ((size_t)msg_len < len) ? msg_len : (int)len - 1;
+}
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file temp_sensors.h
+ * @brief A set of TMP102 sensors on one or more i2c buses.
+ *
+ * Sensors are kept sorted by bus and address, so the ones on one bus
+ * are adjacent and their registers go out in one combined transfer.
+ * Shared by temp_app and the sensord temperature module.
+ *
+ * @version 1.0
+ */
+#ifndef TEMP_SENSORS_H
+#define TEMP_SENSORS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tmp102.h"
+#include "publish_filter.h"
+
+#define TEMP_SENSORS_MAX      32
+#define TEMP_SENSORS_MAX_REGS 3       /* extra registers read with the temperature */
+#define TEMP_SENSOR_ID_LEN    12
+#define TEMP_SENSOR_TOPIC_LEN 64
+#define TEMP_SENSOR_MSG_LEN   96
+
+/* One TMP102 */
+struct temp_sensor
+{
+    uint8_t node;
+    uint8_t addr;
+    char id[TEMP_SENSOR_ID_LEN];    /* "<bus>-<addr>" as in sysfs, e.g. 1-0048 */
+    char topic[TEMP_SENSOR_TOPIC_LEN];
+    struct tmp102_read *reads;      /* temperature, then the extra registers */
+    bool valid;                     /* the last read succeeded */
+    float temperature;
+    uint64_t samples;
+    uint64_t errors;
+    struct publish_filter filter;
+};
+
+/* One open bus, its sensors are adjacent in sensor[] */
+struct temp_bus
+{
+    struct tmp102_bus bus;
+    size_t first;
+    size_t count;
+};
+
+struct temp_sensors
+{
+    struct temp_sensor sensor[TEMP_SENSORS_MAX];
+    size_t count;
+    struct temp_bus bus[TEMP_SENSORS_MAX];
+    size_t bus_count;
+    size_t extra_regs;
+    uint8_t extra_reg[TEMP_SENSORS_MAX_REGS];
+    /* every sensor's registers, the ones on one bus are read in one transaction */
+    struct tmp102_read reads[TEMP_SENSORS_MAX * (1 + TEMP_SENSORS_MAX_REGS)];
+};
+
+int temp_sensors_add(struct temp_sensors *sensors, uint8_t node, uint8_t addr);
+int temp_sensors_parse(struct temp_sensors *sensors, char *list);
+int temp_sensors_parse_alert(char *spec, const char **chip,
+                             unsigned int *offset);
+int temp_sensors_open(struct temp_sensors *sensors, const char *topic);
+void temp_sensors_close(struct temp_sensors *sensors);
+size_t temp_sensors_read_bus(struct temp_sensors *sensors, struct temp_bus *bus);
+size_t temp_sensors_poll(struct temp_sensors *sensors);
+int temp_sensors_program_alerts(struct temp_sensors *sensors, float t_low,
+                                float t_high, bool comparator);
+int temp_sensors_format(const struct publish_span *span, char *buf,
+                        size_t len);
+
+#endif /* TEMP_SENSORS_H */
@@ -0,0 +1,272 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file tmp102.c
+ * @brief TMP102 register access over an i2c-dev bus.
+ *
+ * @version 1.0
+ * @resources https://www.ti.com/product/TMP102
+ *            https://www.kernel.org/doc/Documentation/i2c/dev-interface
+ */
+
+/* Header files */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include "tmp102.h"
+
+/* Macro definitions */
+#define SUCCESS               0
+#define FAILURE              -1
+#define MAX_STR_LEN           16
+
+/* Function definitions */
+/**
+ * @brief Opens /dev/i2c-<node> and checks which transfers the adapter
+ *        can do.
+ *
+ * @param bus
+ * @param node i2c bus number
+ *
+ * @return int
+ */
+int tmp102_bus_open(struct tmp102_bus *bus, uint8_t node)
+{
+    char device_path[MAX_STR_LEN] = {0};
+    unsigned long funcs = 0;
+
+    memset(bus, 0, sizeof(*bus));
+    bus->node = node;
+    bus->slave = -1;
+    snprintf(device_path, sizeof(device_path), "/dev/i2c-%d", node);
+    bus->fd = open(device_path, O_RDWR);
+    if (FAILURE == bus->fd)
+    {
+        return FAILURE;
+    }
+
+    if (FAILURE == ioctl(bus->fd, I2C_FUNCS, &funcs))
+    {
+        tmp102_bus_close(bus);
+        return FAILURE;
+    }
+    bus->combined = (funcs & I2C_FUNC_I2C) != 0;
+    if (!bus->combined && !(funcs & I2C_FUNC_SMBUS_READ_WORD_DATA))
+    {
+        tmp102_bus_close(bus);
+        errno = EOPNOTSUPP;
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Closes the bus.
+ *
+ * @param bus
+ */
+void tmp102_bus_close(struct tmp102_bus *bus)
+{
+    if (bus->fd >= 0)
+    {
+        close(bus->fd);
+    }
+    bus->fd = -1;
+}
+
+/**
+ * @brief Reads registers one SMBus read word transfer at a time, for
+ *        adapters without plain i2c support.
+ *
+ * @param bus
+ * @param reads
+ * @param count
+ *
+ * @return int
+ */
+static int tmp102_read_smbus(struct tmp102_bus *bus, struct tmp102_read *reads,
+                             size_t count)
+{
+    union i2c_smbus_data data;
+    struct i2c_smbus_ioctl_data args = {
+        .read_write = I2C_SMBUS_READ,
+        .size = I2C_SMBUS_WORD_DATA,
+        .data = &data,
+    };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (bus->slave != reads[i].addr)
+        {
+            if (FAILURE == ioctl(bus->fd, I2C_SLAVE, reads[i].addr))
+            {
+                bus->slave = -1;
+                return FAILURE;
+            }
+            bus->slave = reads[i].addr;
+        }
+        args.command = reads[i].reg;
+        bus->transfers++;
+        if (FAILURE == ioctl(bus->fd, I2C_SMBUS, &args))
+        {
+            return FAILURE;
+        }
+        /* SMBus words are LSB first, the TMP102 sends MSB first */
+        reads[i].value = (uint16_t)((data.word << 8) | (data.word >> 8));
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Reads each listed register as a pointer write plus a repeated
+ *        start read, TMP102_MAX_READS of them per ioctl.
+ *
+ * @param bus
+ * @param reads register and address in, value out
+ * @param count
+ *
+ * @return int
+ */
+int tmp102_read_regs(struct tmp102_bus *bus, struct tmp102_read *reads,
+                     size_t count)
+{
+    struct i2c_msg msgs[2 * TMP102_MAX_READS];
+    uint8_t rx[TMP102_MAX_READS][2];
+    struct i2c_rdwr_ioctl_data xfer = { .msgs = msgs };
+    size_t chunk = 0;
+
+    if (!bus->combined)
+    {
+        return tmp102_read_smbus(bus, reads, count);
+    }
+
+    for (; count > 0; reads += chunk, count -= chunk)
+    {
+        chunk = count < TMP102_MAX_READS ? count : TMP102_MAX_READS;
+        for (size_t i = 0; i < chunk; i++)
+        {
+            msgs[2 * i].addr = reads[i].addr;
+            msgs[2 * i].flags = 0;
+            msgs[2 * i].len = 1;
+            msgs[2 * i].buf = &reads[i].reg;
+            msgs[2 * i + 1].addr = reads[i].addr;
+            msgs[2 * i + 1].flags = I2C_M_RD;
+            msgs[2 * i + 1].len = 2;
+            msgs[2 * i + 1].buf = rx[i];
+        }
+        /* one START, a repeated start per message, one STOP */
+        xfer.nmsgs = 2 * chunk;
+        bus->transfers++;
+        if (FAILURE == ioctl(bus->fd, I2C_RDWR, &xfer))
+        {
+            return FAILURE;
+        }
+        for (size_t i = 0; i < chunk; i++)
+        {
+            reads[i].value = (uint16_t)((rx[i][0] << 8) | rx[i][1]);
+        }
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Writes one register: the pointer byte and the value, MSB first,
+ *        in a single message.
+ *
+ * @param bus
+ * @param addr 7-bit device address
+ * @param reg  enum tmp102_reg, not TMP102_REG_TEMP
+ * @param value
+ *
+ * @return int
+ */
+int tmp102_write_reg(struct tmp102_bus *bus, uint8_t addr, uint8_t reg,
+                     uint16_t value)
+{
+    uint8_t tx[3] = { reg, (uint8_t)(value >> 8), (uint8_t)value };
+    struct i2c_msg msg = { .addr = addr, .flags = 0, .len = 3, .buf = tx };
+    struct i2c_rdwr_ioctl_data xfer = { .msgs = &msg, .nmsgs = 1 };
+    union i2c_smbus_data data;
+    struct i2c_smbus_ioctl_data args = {
+        .read_write = I2C_SMBUS_WRITE,
+        .command = reg,
+        .size = I2C_SMBUS_WORD_DATA,
+        .data = &data,
+    };
+
+    bus->transfers++;
+    if (bus->combined)
+    {
+        return ioctl(bus->fd, I2C_RDWR, &xfer);
+    }
+
+    if (bus->slave != addr)
+    {
+        if (FAILURE == ioctl(bus->fd, I2C_SLAVE, addr))
+        {
+            bus->slave = -1;
+            return FAILURE;
+        }
+        bus->slave = addr;
+    }
+    data.word = (uint16_t)((value << 8) | (value >> 8));
+    return ioctl(bus->fd, I2C_SMBUS, &args);
+}
+
+/**
+ * @brief Converts a temperature, T_LOW or T_HIGH register value to
+ *        degrees celsius.
+ *
+ * @param value
+ * @param extended 13-bit mode, TMP102_TEMP_EM of the temperature register
+ *
+ * @return float
+ */
+float tmp102_celsius(uint16_t value, bool extended)
+{
+    int16_t raw = (int16_t)value;
+
+    /* arithmetic shift keeps the sign of temperatures below zero */
+    return (extended ? raw >> 3 : raw >> 4) * 0.0625f;
+}
+
+/**
+ * @brief Converts degrees celsius to a T_LOW or T_HIGH register value,
+ *        clamped to the range the register can hold.
+ *
+ * @param celsius
+ * @param extended 13-bit mode
+ *
+ * @return uint16_t
+ */
+uint16_t tmp102_limit(float celsius, bool extended)
+{
+    float counts = celsius / 0.0625f;
+    float max = extended ? 4095.0f : 2047.0f;
+
+    if (counts > max)
+    {
+        counts = max;
+    }
+    if (counts < -max - 1)
+    {
+        counts = -max - 1;
+    }
+    counts += (counts < 0) ? -0.5f : 0.5f;
+    return (uint16_t)((uint16_t)(int16_t)counts << (extended ? 3 : 4));
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * Copyright (C) 2023 by Chandana Challa
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Chandana Challa and the University of Colorado are not liable for
+ * any misuse of this material.
+ *
+ *****************************************************************************/
+/**
+ * @file tmp102.h
+ * @brief TMP102 register access over an i2c-dev bus.
+ *
+ * Every register read is a pointer write followed by a two byte read with
+ * a repeated start in between, so no other master can move the pointer
+ * in the middle. Up to TMP102_MAX_READS reads, on any mix of registers
+ * and device addresses of one bus, go out as one I2C_RDWR ioctl. Adapters
+ * that only speak SMBus fall back to one read word transfer per register.
+ *
+ * @version 1.0
+ */
+#ifndef TMP102_H
+#define TMP102_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/i2c-dev.h>
+
+#define TMP102_ADDR_DEFAULT   0x48
+#define TMP102_ADDR_MIN       0x48    /* ADD0 to GND */
+#define TMP102_ADDR_MAX       0x4B    /* ADD0 to SCL */
+/* set in the temperature register when it holds a 13-bit value */
+#define TMP102_TEMP_EM        0x0001
+/* Configuration register bits */
+#define TMP102_CFG_EM         0x0010  /* extended 13-bit mode */
+#define TMP102_CFG_AL         0x0020  /* alert status, read only */
+#define TMP102_CFG_TM         0x0200  /* thermostat interrupt mode */
+#define TMP102_CFG_POL        0x0400  /* ALERT active high */
+#define TMP102_CFG_FAULTS     0x1800  /* consecutive faults before ALERT */
+#define TMP102_CFG_FAULTS_SHIFT 11
+/* each read takes a write and a read message */
+#define TMP102_MAX_READS      (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+
+/* Pointer register values */
+enum tmp102_reg
+{
+    TMP102_REG_TEMP = 0,
+    TMP102_REG_CONFIG = 1,
+    TMP102_REG_TLOW = 2,
+    TMP102_REG_THIGH = 3,
+};
+
+/* One open /dev/i2c-N */
+struct tmp102_bus
+{
+    int fd;
+    uint8_t node;               /* N of /dev/i2c-N */
+    bool combined;              /* adapter supports I2C_RDWR */
+    int slave;                  /* address bound for SMBus, -1 none */
+    uint64_t transfers;         /* ioctls issued */
+};
+
+/* One register read, value is filled in by tmp102_read_regs() */
+struct tmp102_read
+{
+    uint8_t addr;               /* 7-bit device address */
+    uint8_t reg;                /* enum tmp102_reg */
+    uint16_t value;             /* register contents, MSB first on the wire */
+};
+
+int tmp102_bus_open(struct tmp102_bus *bus, uint8_t node);
+void tmp102_bus_close(struct tmp102_bus *bus);
+int tmp102_read_regs(struct tmp102_bus *bus, struct tmp102_read *reads,
+                     size_t count);
+int tmp102_write_reg(struct tmp102_bus *bus, uint8_t addr, uint8_t reg,
+                     uint16_t value);
+float tmp102_celsius(uint16_t value, bool extended);
+uint16_t tmp102_limit(float celsius, bool extended);
+
+#endif /* TMP102_H */
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Restart-then-crash check of the rollup recovery: several pulse_app runs
+# into one store within a minute, some stopped cleanly and some killed,
+# the last one clean, then every level must count the samples raw has.
+#
+#   ./crash_check.sh [pulse_app] [store dir]
+
+APP=${1:-../pulse_sensor/pulse_app}
+DIR=${2:-/tmp/ts_crash_check}
+TOOL=$(dirname "$0")/ts_tool
+
+rm -rf "$DIR"
+for sig in INT KILL INT KILL KILL INT; do
+	timeout -s $sig 2 "$APP" -D sim -S "$DIR" >/dev/null 2>&1
+done
+
+raw=
+status=0
+for level in raw 1s 1m 1h; do
+	n=$("$TOOL" -r 86400 -L $level -k sample "$DIR" |
+	    awk -F, '!/^query/ { n += $4 } END { print n + 0 }')
+	raw=${raw:-$n}
+	echo "$level: $n samples"
+	[ "$n" = "$raw" ] || status=1
+done
+
+[ $status = 0 ] && echo "crash check: ok" || echo "crash check: FAILED"
+exit $status
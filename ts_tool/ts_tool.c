@@ -0,0 +1,613 @@
+/***********************************************************************
+ * @file      		ts_tool.c
+ * @version   		0.1
+ * @brief		reads a time-series store written by pulse_app -S
+ *			or temp_app -s
+ *
+ * @date      		Oct 16, 2026
+ *
+ * @institution 	University of Colorado Boulder (UCB)
+ * @course      	ECEN 5713: Advanced Embedded Software Development
+ *
+ * @assignment 	Final Project
+ *
+ * Segments are mapped read-only and the records used where they lie,
+ * so the tool can run next to the writer, it sees everything written up
+ * to the moment it maps a segment.
+ *
+ * A query (-r or -p) is answered from the coarsest level whose buckets
+ * divide the requested resolution: an hour of data at 1 min is 60
+ * rollup records per series instead of 1.8 million samples. Rollup
+ * segments are written in bucket order give or take a bucket, so each
+ * one is skipped or bisected to the range by time and only the records
+ * inside it are read.
+ *
+ ************************************************************************/
+
+/**************************** Header Files ******************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <float.h>
+#include <time.h>
+
+#include "ts_store.h"
+
+/**************************** Defines  **********************************/
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define MAX_GROUPS		(256)	// series x kind pairs in a summary
+#define MAX_POINTS		(100000)	// query buckets per series and kind
+#define PATH_LEN		(256)
+
+/**************************** Data Types ********************************/
+struct group {
+	uint16_t series;
+	uint16_t kind;
+	uint64_t count;
+	uint64_t first_us;
+	uint64_t last_us;
+	float min;
+	float max;
+	double sum;
+};
+
+// one series and kind of a query, a bucket per point
+struct series {
+	uint16_t series;
+	uint16_t kind;
+	struct ts_rollup *b;
+};
+
+/**************************** Global Variables **************************/
+static const struct {
+	const char *name;
+	enum ts_kind kind;
+} kinds[] = {
+	{ "sample", TS_KIND_PULSE_SAMPLE },
+	{ "ibi", TS_KIND_PULSE_IBI },
+	{ "bpm", TS_KIND_PULSE_BPM },
+	{ "lost", TS_KIND_PULSE_LOST },
+	{ "temp", TS_KIND_TEMP },
+};
+
+static int list_only;
+static int summary;
+static int kind_filter = -1;
+static int series_filter = -1;
+static uint64_t from_us;
+static uint64_t to_us = UINT64_MAX;
+static uint64_t res_us;			// query resolution, 0: no query
+static unsigned int points;		// or the number of points wanted
+static int level_forced = -1;
+
+static struct group groups[MAX_GROUPS];
+static unsigned int group_count;
+
+/**************************** Function Definitions **********************/
+
+/*****************************************
+ * @brief	To print usage
+ ****************************************/
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [-ls] [-r res|-p points] [-k kind] [-n series] [-a from] [-b to] dir\n", prog);
+	puts("  -l --list     list the segments of every level\n"
+	     "  -s --summary  count, min, max and mean per series and kind\n"
+	     "  -r --res      query: min, max, mean and count per res seconds\n"
+	     "  -p --points   query: about this many buckets over the range\n"
+	     "  -L --level    answer a query from raw, 1s, 1m or 1h only\n"
+	     "  -k --kind     sample, ibi, bpm, lost, temp or a number\n"
+	     "  -n --series   pulse channel, or bus << 8 | address of a TMP102\n"
+	     "  -a --from     first time, seconds since the epoch, negative:\n"
+	     "                seconds before now\n"
+	     "  -b --to       end time, the same way\n"
+	     "Without -l, -s or a query every raw record is printed as\n"
+	     "time,series,kind,value, a query prints time,series,kind,count,min,max,mean");
+	exit(1);
+}
+
+static const char *kind_name(uint16_t kind)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(kinds); i++)
+		if (kinds[i].kind == kind)
+			return kinds[i].name;
+	return "?";
+}
+
+static int parse_kind(const char *arg)
+{
+	char *end;
+	long v;
+
+	for (size_t i = 0; i < ARRAY_SIZE(kinds); i++)
+		if (strcmp(arg, kinds[i].name) == 0)
+			return kinds[i].kind;
+	v = strtol(arg, &end, 0);
+	return (*end == '\0' && v >= 0 && v <= UINT16_MAX) ? v : -1;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t parse_time(const char *arg, const char *prog)
+{
+	char *end;
+	double v = strtod(arg, &end);
+
+	if (*end != '\0')
+		print_usage(prog);
+	if (v < 0)
+		return now_us() + v * 1e6;
+	return v * 1e6;
+}
+
+/*****************************************
+ * @brief	To parse arguments
+ ****************************************/
+static void parse_opts(int argc, char *argv[])
+{
+	while (1) {
+		static const struct option lopts[] = {
+			{ "list",    0, 0, 'l' },
+			{ "summary", 0, 0, 's' },
+			{ "kind",    1, 0, 'k' },
+			{ "series",  1, 0, 'n' },
+			{ "from",    1, 0, 'a' },
+			{ "to",      1, 0, 'b' },
+			{ "res",     1, 0, 'r' },
+			{ "points",  1, 0, 'p' },
+			{ "level",   1, 0, 'L' },
+			{ NULL, 0, 0, 0 },
+		};
+		int c;
+
+		c = getopt_long(argc, argv, "lsk:n:a:b:r:p:L:", lopts, NULL);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'l':
+			list_only = 1;
+			break;
+		case 's':
+			summary = 1;
+			break;
+		case 'k':
+			kind_filter = parse_kind(optarg);
+			if (kind_filter < 0)
+				print_usage(argv[0]);
+			break;
+		case 'n':
+			series_filter = strtol(optarg, NULL, 0);
+			if (series_filter < 0 || series_filter > UINT16_MAX)
+				print_usage(argv[0]);
+			break;
+		case 'a':
+			from_us = parse_time(optarg, argv[0]);
+			break;
+		case 'b':
+			to_us = parse_time(optarg, argv[0]);
+			break;
+		case 'r':
+			res_us = strtod(optarg, NULL) * 1e6;
+			if (res_us == 0)
+				print_usage(argv[0]);
+			break;
+		case 'p':
+			points = strtoul(optarg, NULL, 0);
+			if (points == 0 || points > MAX_POINTS)
+				print_usage(argv[0]);
+			break;
+		case 'L':
+			for (int l = 0; l < TS_LEVELS; l++)
+				if (strcmp(optarg, l ? ts_level_name[l] : "raw") == 0)
+					level_forced = l;
+			if (level_forced < 0)
+				print_usage(argv[0]);
+			break;
+		default:
+			print_usage(argv[0]);
+			break;
+		}
+	}
+	if (optind != argc - 1)
+		print_usage(argv[0]);
+}
+
+/*****************************************
+ * @brief	Summary slot of a series and
+ *		kind, NULL once they run out
+ ****************************************/
+static struct group *find_group(uint16_t series, uint16_t kind)
+{
+	struct group *g;
+
+	for (unsigned int i = 0; i < group_count; i++)
+		if (groups[i].series == series && groups[i].kind == kind)
+			return &groups[i];
+	if (group_count == MAX_GROUPS)
+		return NULL;
+
+	g = &groups[group_count++];
+	g->series = series;
+	g->kind = kind;
+	g->min = FLT_MAX;
+	g->max = -FLT_MAX;
+	return g;
+}
+
+static void add_record(const struct ts_record *r)
+{
+	struct group *g;
+
+	if (!summary)
+	{
+		printf("%llu.%06llu,%u,%s,%g\n",
+		       (unsigned long long)(r->time_us / 1000000),
+		       (unsigned long long)(r->time_us % 1000000),
+		       r->series, kind_name(r->kind), r->value);
+		return;
+	}
+
+	g = find_group(r->series, r->kind);
+	if (g == NULL)
+		return;
+	if (g->count++ == 0)
+		g->first_us = r->time_us;
+	g->last_us = r->time_us;
+	if (r->value < g->min)
+		g->min = r->value;
+	if (r->value > g->max)
+		g->max = r->value;
+	g->sum += r->value;
+}
+
+/*****************************************
+ * @brief	Time of a segment's record i,
+ *		raw or rollup
+ ****************************************/
+static uint64_t seg_time(const struct ts_segment *seg, uint32_t i)
+{
+	return seg->rec ? seg->rec[i].time_us : seg->roll[i].start_us;
+}
+
+/*****************************************
+ * @brief	One raw segment, listed or
+ *		run through the filters
+ ****************************************/
+static int read_segment(const char *dir, uint64_t seq)
+{
+	struct ts_segment seg;
+	const struct ts_record *r;
+
+	if (ts_segment_open(&seg, dir, seq) < 0)
+	{
+		fprintf(stderr, "%s/%08llx" TS_SUFFIX ": %s\n", dir,
+			(unsigned long long)seq, strerror(errno));
+		return -1;
+	}
+
+	if (list_only)
+	{
+		uint64_t first = seg.count ? seg_time(&seg, 0) : 0;
+		uint64_t last = seg.count ? seg_time(&seg, seg.count - 1) : 0;
+
+		printf("%08llx %10u/%-10u %s %llu.%06llu .. %llu.%06llu\n",
+		       (unsigned long long)seq, seg.count, seg.hdr->capacity,
+		       seg.hdr->sealed ? "sealed" : "open  ",
+		       (unsigned long long)(first / 1000000),
+		       (unsigned long long)(first % 1000000),
+		       (unsigned long long)(last / 1000000),
+		       (unsigned long long)(last % 1000000));
+		ts_segment_close(&seg);
+		return 0;
+	}
+
+	for (r = seg.rec; r && r < seg.rec + seg.count; r++)
+	{
+		if (r->time_us < from_us || r->time_us > to_us)
+			continue;
+		if (kind_filter >= 0 && r->kind != kind_filter)
+			continue;
+		if (series_filter >= 0 && r->series != series_filter)
+			continue;
+		add_record(r);
+	}
+
+	ts_segment_close(&seg);
+	return 0;
+}
+
+static void print_summary(void)
+{
+	for (unsigned int i = 0; i < group_count; i++)
+	{
+		struct group *g = &groups[i];
+
+		printf("series %u %-6s %10llu records  min %g max %g mean %.3f  %.1f s\n",
+		       g->series, kind_name(g->kind), (unsigned long long)g->count,
+		       g->min, g->max, g->sum / g->count,
+		       (g->last_us - g->first_us) / 1e6);
+	}
+	if (group_count == MAX_GROUPS)
+		printf("only the first %d series/kind pairs are shown\n", MAX_GROUPS);
+}
+
+/*****************************************
+ * @brief	Directory of a level
+ ****************************************/
+static void level_dir(char *path, size_t len, const char *dir, int level)
+{
+	if (level == TS_LEVEL_RAW)
+		snprintf(path, len, "%s", dir);
+	else
+		snprintf(path, len, "%s/%s", dir, ts_level_name[level]);
+}
+
+/*****************************************
+ * @brief	First and end time of what
+ *		a level holds
+ ****************************************/
+static int level_span(const char *path, const uint64_t *seqs, size_t count,
+		      uint64_t *first, uint64_t *end)
+{
+	struct ts_segment seg;
+
+	if (count == 0 || ts_segment_open(&seg, path, seqs[0]) < 0)
+		return -1;
+	*first = seg.count ? seg_time(&seg, 0) : 0;
+	ts_segment_close(&seg);
+	if (ts_segment_open(&seg, path, seqs[count - 1]) < 0)
+		return -1;
+	*end = seg.count ? seg_time(&seg, seg.count - 1) + 1 : *first;
+	ts_segment_close(&seg);
+
+	return 0;
+}
+
+/*****************************************
+ * @brief	Query bucket array of a series
+ *		and kind, NULL once they run out
+ ****************************************/
+static struct ts_rollup *find_series(struct series *list, unsigned int *n,
+				     uint16_t series, uint16_t kind, size_t buckets)
+{
+	for (unsigned int i = 0; i < *n; i++)
+		if (list[i].series == series && list[i].kind == kind)
+			return list[i].b;
+	if (*n == MAX_GROUPS)
+		return NULL;
+
+	list[*n].series = series;
+	list[*n].kind = kind;
+	list[*n].b = calloc(buckets, sizeof(struct ts_rollup));
+	if (list[*n].b == NULL)
+		return NULL;
+	return list[(*n)++].b;
+}
+
+/*****************************************
+ * @brief	Rollups of a time range at
+ *		res_us, from the coarsest level
+ *		that divides it
+ ****************************************/
+static int query(const char *dir)
+{
+	static struct series list[MAX_GROUPS];
+	char path[PATH_LEN];
+	struct timespec t0, t1;
+	uint64_t *seqs, first, end, start, slack, read = 0;
+	size_t count, buckets, used = 0;
+	unsigned int n = 0;
+	int level = TS_LEVEL_RAW;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// about points buckets over the range, in whole seconds when it can be
+	if (points)
+	{
+		level_dir(path, sizeof(path), dir, TS_LEVEL_RAW);
+		if (ts_store_list(path, &seqs, &count) < 0 ||
+		    level_span(path, seqs, count, &first, &end) < 0)
+		{
+			fprintf(stderr, "%s: no data\n", dir);
+			free(seqs);
+			return -1;
+		}
+		free(seqs);
+		if (from_us)
+			first = from_us;
+		if (to_us != UINT64_MAX)
+			end = to_us;
+		res_us = end > first ? (end - first + points - 1) / points : 1;
+		for (int l = TS_LEVELS - 1; l > TS_LEVEL_RAW; l--)
+		{
+			if (res_us >= ts_level_us[l])
+			{
+				res_us = (res_us + ts_level_us[l] - 1) / ts_level_us[l] * ts_level_us[l];
+				break;
+			}
+		}
+	}
+
+	if (level_forced >= 0)
+	{
+		level = level_forced;
+		if (level && res_us % ts_level_us[level])
+		{
+			fprintf(stderr, "%s rollups do not divide the resolution\n",
+				ts_level_name[level]);
+			return -1;
+		}
+	}
+	else
+	{
+		for (level = TS_LEVELS - 1; level > TS_LEVEL_RAW; level--)
+			if (res_us % ts_level_us[level] == 0)
+				break;
+	}
+
+	level_dir(path, sizeof(path), dir, level);
+	if (ts_store_list(path, &seqs, &count) < 0 ||
+	    level_span(path, seqs, count, &first, &end) < 0)
+	{
+		fprintf(stderr, "%s: no data\n", path);
+		free(seqs);
+		return -1;
+	}
+	if (from_us)
+		first = from_us;
+	if (to_us != UINT64_MAX)
+		end = to_us;
+	start = first - first % res_us;
+	buckets = end > start ? (end - start + res_us - 1) / res_us : 0;
+	if (buckets > MAX_POINTS)
+	{
+		fprintf(stderr, "%zu points, narrow the range or coarsen the resolution\n",
+			buckets);
+		free(seqs);
+		return -1;
+	}
+	end = start + buckets * res_us;
+	// how far a record can be out of time order
+	slack = ts_level_us[level] + TS_ROLLUP_GRACE_US;
+
+	for (size_t s = 0; s < count && buckets; s++)
+	{
+		struct ts_segment seg;
+		uint32_t lo, hi;
+
+		if (ts_segment_open(&seg, path, seqs[s]) < 0)
+			continue;
+		if (seg.count == 0 || seg_time(&seg, seg.count - 1) + slack < start ||
+		    seg_time(&seg, 0) >= end + slack)
+		{
+			ts_segment_close(&seg);
+			continue;
+		}
+		used++;
+
+		// first record that can be in range
+		lo = 0;
+		hi = seg.count;
+		while (lo < hi)
+		{
+			uint32_t mid = lo + (hi - lo) / 2;
+
+			if (seg_time(&seg, mid) + slack < start)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (uint32_t i = lo; i < seg.count; i++)
+		{
+			struct ts_rollup one, *b;
+			uint64_t t = seg_time(&seg, i);
+
+			if (t >= end + slack)
+				break;
+			read++;
+			if (t < start || t >= end)
+				continue;
+			if (seg.rec)
+			{
+				one.series = seg.rec[i].series;
+				one.kind = seg.rec[i].kind;
+				one.count = 1;
+				one.min = one.max = one.sum = seg.rec[i].value;
+			}
+			else
+			{
+				one = seg.roll[i];
+			}
+			if (kind_filter >= 0 && one.kind != kind_filter)
+				continue;
+			if (series_filter >= 0 && one.series != series_filter)
+				continue;
+			b = find_series(list, &n, one.series, one.kind, buckets);
+			if (b)
+				ts_rollup_merge(&b[(t - start) / res_us], &one);
+		}
+		ts_segment_close(&seg);
+	}
+	free(seqs);
+
+	for (size_t i = 0; i < buckets; i++)
+	{
+		uint64_t t = start + i * res_us;
+
+		for (unsigned int g = 0; g < n; g++)
+		{
+			const struct ts_rollup *b = &list[g].b[i];
+
+			if (b->count == 0)
+				continue;
+			printf("%llu.%06llu,%u,%s,%u,%g,%g,%g\n",
+			       (unsigned long long)(t / 1000000),
+			       (unsigned long long)(t % 1000000),
+			       list[g].series, kind_name(list[g].kind),
+			       b->count, b->min, b->max, b->sum / b->count);
+		}
+	}
+	for (unsigned int g = 0; g < n; g++)
+		free(list[g].b);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	fprintf(stderr, "query: %zu points of %g s from %s, %zu segments, "
+		"%llu records read in %.3f ms\n",
+		buckets, res_us / 1e6, level ? ts_level_name[level] : "raw",
+		used, (unsigned long long)read,
+		(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+	return 0;
+}
+
+/**************************** main function *****************************/
+int main(int argc, char *argv[])
+{
+	char path[PATH_LEN];
+	const char *dir;
+	uint64_t *seqs;
+	size_t count;
+	int ret = 0;
+
+	parse_opts(argc, argv);
+	dir = argv[optind];
+
+	if (res_us || points)
+		return query(dir) < 0;
+
+	for (int l = 0; l < (list_only ? TS_LEVELS : 1); l++)
+	{
+		level_dir(path, sizeof(path), dir, l);
+		if (ts_store_list(path, &seqs, &count) < 0)
+		{
+			if (l == TS_LEVEL_RAW)
+			{
+				perror(dir);
+				return 1;
+			}
+			continue;
+		}
+		if (list_only)
+			printf("%s:\n", l ? ts_level_name[l] : "raw");
+		for (size_t i = 0; i < count; i++)
+			if (read_segment(path, seqs[i]) < 0)
+				ret = 1;
+		free(seqs);
+	}
+
+	if (summary)
+		print_summary();
+
+	return ret;
+}